@@ -0,0 +1,612 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include "protocol.h"
+
+/*
+ * Headless load generator: opens many simulated players over non-blocking sockets, lets them play random or scripted
+ * legal moves against each other through the server at a target move rate and reports the achieved move rate and the
+ * latency from sending a move until the server echoes it back.
+ */
+
+#define SERVER_ADDRESS "localhost"
+#define DEFAULT_ERROR_RETURN -1
+#define DEFAULT_RETURN 0
+#define DEFAULT_CONNECTIONS 1000
+#define DEFAULT_DURATION 10 // seconds
+#define DEFAULT_BOARD_SIZE 3
+#define DEFAULT_WIN_LENGTH 3
+#define MIN_BOARD_SIZE 3
+#define MAX_BOARD_SIZE 19
+#define MAX_EVENTS 256
+#define CONNECTS_PER_ITERATION 64
+#define REPORT_INTERVAL_US 1000000
+#define INITIAL_LATENCY_CAPACITY 65536
+
+#define PLAYER_CONNECTING 0
+#define PLAYER_JOINED 1
+#define PLAYER_CLOSED 2
+
+#define STRATEGY_RANDOM 0
+#define STRATEGY_SCRIPTED 1
+
+struct player {
+    int fileDescriptor;
+    int state;
+    int queued;
+    long long moveSentUs;
+    int stoneCount;
+    uint8_t cells[MAX_BOARD_SIZE * MAX_BOARD_SIZE];
+    struct receiveBuffer input;
+    struct sendBuffer output;
+};
+
+/*
+ * State of a load run. Players whose turn it is wait in the ready ring until the move budget of the target rate lets
+ * them play; a player is in the ring at most once, so the ring never holds more entries than there are players.
+ */
+struct loadGenerator {
+    struct addrinfo *address;
+    int epollFd;
+    int connections;
+    int rate;
+    int duration;
+    int size;
+    int winLength;
+    int strategy;
+    unsigned int seed;
+    int opened;
+    struct player *players;
+    int *ready;
+    int readyHead;
+    int readyCount;
+    double budget;
+    long long lastRefillUs;
+    uint32_t *latencies;
+    long latencyCount;
+    long latencyCapacity;
+    long moves;
+    long games;
+    long failures;
+};
+
+void handleError(int errorCode, int errorType);
+
+int parseOptions(int argc, char *argv[], struct loadGenerator *generator);
+
+int initLoadGenerator(struct loadGenerator *generator);
+
+void runLoad(struct loadGenerator *generator);
+
+void openConnections(struct loadGenerator *generator, int count);
+
+void handlePlayerEvent(struct loadGenerator *generator, int index, uint32_t events);
+
+void handleMessage(struct loadGenerator *generator, int index, struct packet_data *packet, long long nowUs);
+
+void queuePlayer(struct loadGenerator *generator, int index);
+
+void playQueuedMoves(struct loadGenerator *generator, long long nowUs);
+
+int chooseMove(struct loadGenerator *generator, struct player *player);
+
+int sendMessage(struct loadGenerator *generator, int index, int type, struct packet_data *packet);
+
+void closePlayer(struct loadGenerator *generator, int index);
+
+void recordLatency(struct loadGenerator *generator, long long latencyUs);
+
+void printReport(struct loadGenerator *generator, long long elapsedUs);
+
+int compareLatencies(const void *first, const void *second);
+
+long long monotonicUs();
+
+
+int main(int argc, char *argv[]) {
+    struct loadGenerator generator;
+
+    if (parseOptions(argc, argv, &generator) != 0) {
+        handleError(EINVAL, 1);
+        return DEFAULT_ERROR_RETURN;
+    }
+
+    if (initLoadGenerator(&generator) != 0) return DEFAULT_ERROR_RETURN;
+
+    runLoad(&generator);
+    return DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Reads the command line: [-c connections] [-r moves per second, 0 for unlimited] [-d seconds] [-b board size]
+ *       [-k win length] [-m random|scripted] [-s seed] [-a address] port
+ * Params:
+ *    argc - argument count
+ *    argv - argument values
+ *    generator - generator to configure
+ * Returns: 0 if the options are valid, -1 otherwise
+ */
+int parseOptions(int argc, char *argv[], struct loadGenerator *generator) {
+    struct addrinfo hints;
+    const char *host = SERVER_ADDRESS;
+    int option;
+
+    memset(generator, 0, sizeof(struct loadGenerator));
+    generator->connections = DEFAULT_CONNECTIONS;
+    generator->duration = DEFAULT_DURATION;
+    generator->size = DEFAULT_BOARD_SIZE;
+    generator->winLength = DEFAULT_WIN_LENGTH;
+    generator->seed = (unsigned int) time(NULL);
+
+    while ((option = getopt(argc, argv, "c:r:d:b:k:m:s:a:")) != -1) {
+        if (option == 'c') generator->connections = atoi(optarg);
+        else if (option == 'r') generator->rate = atoi(optarg);
+        else if (option == 'd') generator->duration = atoi(optarg);
+        else if (option == 'b') generator->size = atoi(optarg);
+        else if (option == 'k') generator->winLength = atoi(optarg);
+        else if (option == 'm' && strcmp(optarg, "random") == 0) generator->strategy = STRATEGY_RANDOM;
+        else if (option == 'm' && strcmp(optarg, "scripted") == 0) generator->strategy = STRATEGY_SCRIPTED;
+        else if (option == 's') generator->seed = (unsigned int) strtoul(optarg, NULL, 10);
+        else if (option == 'a') host = optarg;
+        else return DEFAULT_ERROR_RETURN;
+    }
+
+    if (optind >= argc || generator->connections < 2 || generator->rate < 0 || generator->duration <= 0) {
+        return DEFAULT_ERROR_RETURN;
+    }
+    if (generator->size < MIN_BOARD_SIZE || generator->size > MAX_BOARD_SIZE) return DEFAULT_ERROR_RETURN;
+    if (generator->winLength < MIN_BOARD_SIZE || generator->winLength > generator->size) return DEFAULT_ERROR_RETURN;
+
+    memset(&hints, 0, sizeof(struct addrinfo));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    if (getaddrinfo(host, argv[optind], &hints, &generator->address) != 0) {
+        handleError(errno, 2);
+        return DEFAULT_ERROR_RETURN;
+    }
+
+    return DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Allocates the players, the ready ring and the latency samples and creates the epoll instance.
+ * Params:
+ *    generator - generator to initialize
+ * Returns: 0 if initialized, -1 if error occurred
+ */
+int initLoadGenerator(struct loadGenerator *generator) {
+    generator->players = calloc(generator->connections, sizeof(struct player));
+    generator->ready = calloc(generator->connections, sizeof(int));
+    generator->latencies = malloc(INITIAL_LATENCY_CAPACITY * sizeof(uint32_t));
+    generator->latencyCapacity = INITIAL_LATENCY_CAPACITY;
+
+    if (generator->players == NULL || generator->ready == NULL || generator->latencies == NULL) {
+        handleError(errno, 3);
+        return DEFAULT_ERROR_RETURN;
+    }
+
+    if ((generator->epollFd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+        handleError(errno, 4);
+        return DEFAULT_ERROR_RETURN;
+    }
+
+    return DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Drives the load for the configured duration: opens the connections a batch per iteration so the listen backlog
+ *       of the server is not flooded, services socket events, plays the moves the rate allows and prints the move
+ *       rate once a second and the full report at the end.
+ * Params:
+ *    generator - generator to run
+ */
+void runLoad(struct loadGenerator *generator) {
+    struct epoll_event events[MAX_EVENTS];
+    long long startUs = monotonicUs(), nextReportUs = startUs + REPORT_INTERVAL_US, nowUs = startUs;
+    long long endUs = startUs + (long long) generator->duration * 1000000;
+    long reportedMoves = 0;
+
+    generator->lastRefillUs = startUs;
+
+    while (nowUs < endUs) {
+        if (generator->opened < generator->connections) openConnections(generator, CONNECTS_PER_ITERATION);
+
+        int timeoutMs = generator->rate > 0 || generator->opened < generator->connections ? 1 : 100;
+        int readyCount = epoll_wait(generator->epollFd, events, MAX_EVENTS, timeoutMs);
+
+        if (readyCount < 0 && errno != EINTR) {
+            handleError(errno, 5);
+            break;
+        }
+
+        nowUs = monotonicUs();
+        for (int i = 0; i < readyCount; i++) handlePlayerEvent(generator, events[i].data.u32, events[i].events);
+        playQueuedMoves(generator, nowUs);
+
+        if (nowUs >= nextReportUs) {
+            printf("%llds: %ld moves/s, %d connections open\n", (nowUs - startUs) / 1000000,
+                   generator->moves - reportedMoves, generator->opened - (int) generator->failures);
+            reportedMoves = generator->moves;
+            nextReportUs += REPORT_INTERVAL_US;
+        }
+    }
+
+    printReport(generator, monotonicUs() - startUs);
+
+    for (int i = 0; i < generator->opened; i++) closePlayer(generator, i);
+    close(generator->epollFd);
+    freeaddrinfo(generator->address);
+    free(generator->players);
+    free(generator->ready);
+    free(generator->latencies);
+}
+
+/*
+ * Desc: Starts non-blocking connects for the next players and queues their join requests, which are sent as soon as
+ *       the connection is established.
+ * Params:
+ *    generator - generator owning the players
+ *    count - maximum number of connections to open
+ */
+void openConnections(struct loadGenerator *generator, int count) {
+    struct addrinfo *address = generator->address;
+    struct packet_data join;
+
+    memset(&join, 0, sizeof(struct packet_data));
+    join.x = generator->size;
+    join.y = generator->winLength;
+
+    for (int i = 0; i < count && generator->opened < generator->connections; i++) {
+        int index = generator->opened++;
+        struct player *player = &generator->players[index];
+        struct epoll_event event;
+
+        initReceiveBuffer(&player->input);
+        initSendBuffer(&player->output);
+        player->state = PLAYER_CONNECTING;
+        player->fileDescriptor = socket(address->ai_family, address->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                                        address->ai_protocol);
+
+        if (player->fileDescriptor < 0 ||
+            (connect(player->fileDescriptor, address->ai_addr, address->ai_addrlen) != 0 && errno != EINPROGRESS)) {
+            handleError(errno, 6);
+            closePlayer(generator, index);
+            continue;
+        }
+
+        memset(&event, 0, sizeof(struct epoll_event));
+        event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        event.data.u32 = (uint32_t) index;
+        if (epoll_ctl(generator->epollFd, EPOLL_CTL_ADD, player->fileDescriptor, &event) != 0) {
+            handleError(errno, 7);
+            closePlayer(generator, index);
+            continue;
+        }
+
+        sendMessage(generator, index, MESSAGE_JOIN, &join);
+    }
+}
+
+/*
+ * Desc: Flushes pending output of a player once its socket is writable and decodes every message it received.
+ * Params:
+ *    generator - generator owning the player
+ *    index - index of the player
+ *    events - ready epoll events
+ */
+void handlePlayerEvent(struct loadGenerator *generator, int index, uint32_t events) {
+    struct player *player = &generator->players[index];
+    struct packet_data packet;
+    long long nowUs = monotonicUs();
+    int type, receivedBytes;
+
+    if (player->state == PLAYER_CLOSED) return;
+    if (events & (EPOLLERR | EPOLLHUP)) {
+        closePlayer(generator, index);
+        return;
+    }
+
+    if (events & EPOLLOUT) {
+        if (player->state == PLAYER_CONNECTING) player->state = PLAYER_JOINED;
+        if (flushSendBuffer(player->fileDescriptor, &player->output) < 0) {
+            closePlayer(generator, index);
+            return;
+        }
+    }
+
+    if (!(events & (EPOLLIN | EPOLLRDHUP))) return;
+
+    while (player->state != PLAYER_CLOSED) {
+        while ((type = receiveMessage(&player->input, &packet)) >= 0) {
+            if (type == MESSAGE_STATE) handleMessage(generator, index, &packet, nowUs);
+        }
+
+        if (type == -1) {
+            closePlayer(generator, index);
+            return;
+        }
+
+        receivedBytes = receiveIntoBuffer(player->fileDescriptor, &player->input);
+        if (receivedBytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        if (receivedBytes <= 0 && !(receivedBytes < 0 && errno == EINTR)) closePlayer(generator, index);
+    }
+}
+
+/*
+ * Desc: Applies a state message to the local board of a player. Echoes of the own move complete a latency sample,
+ *       the opponent's moves and game starts queue the player to move.
+ * Params:
+ *    generator - generator owning the player
+ *    index - index of the player
+ *    packet - decoded state message
+ *    nowUs - time the message was received
+ */
+void handleMessage(struct loadGenerator *generator, int index, struct packet_data *packet, long long nowUs) {
+    struct player *player = &generator->players[index];
+    int size = generator->size;
+    int ownMove = player->moveSentUs > 0 && (packet->gameState == 2 || packet->enemyMove == 1);
+
+    if (packet->gameState == 0) return;
+
+    if (packet->gameState == 1 && packet->x < 0) {
+        memset(player->cells, 0, sizeof(player->cells));
+        player->stoneCount = 0;
+
+    } else if (packet->x >= 0 && packet->x < size && packet->y >= 0 && packet->y < size) {
+        player->cells[packet->x * size + packet->y] = 1;
+        player->stoneCount++;
+    }
+
+    if (ownMove) {
+        recordLatency(generator, nowUs - player->moveSentUs);
+        player->moveSentUs = 0;
+        generator->moves++;
+    }
+
+    if (packet->gameState == 2) {
+        if (ownMove) generator->games++;
+        memset(player->cells, 0, sizeof(player->cells));
+        player->stoneCount = 0;
+
+    } else if (packet->enemyMove == 0) {
+        queuePlayer(generator, index);
+    }
+}
+
+/*
+ * Desc: Puts a player whose turn it is into the ready ring.
+ * Params:
+ *    generator - generator owning the player
+ *    index - index of the player
+ */
+void queuePlayer(struct loadGenerator *generator, int index) {
+    if (generator->players[index].queued) return;
+
+    generator->players[index].queued = 1;
+    generator->ready[(generator->readyHead + generator->readyCount++) % generator->connections] = index;
+}
+
+/*
+ * Desc: Plays the moves of queued players, as many as the target rate allows since the last call. Without a target
+ *       rate every queued player moves right away.
+ * Params:
+ *    generator - generator owning the players
+ *    nowUs - current time
+ */
+void playQueuedMoves(struct loadGenerator *generator, long long nowUs) {
+    struct packet_data move;
+
+    if (generator->rate > 0) {
+        generator->budget += (double) (nowUs - generator->lastRefillUs) * generator->rate / 1000000.0;
+        if (generator->budget > generator->rate) generator->budget = generator->rate;
+    }
+    generator->lastRefillUs = nowUs;
+
+    while (generator->readyCount > 0 && (generator->rate == 0 || generator->budget >= 1.0)) {
+        int index = generator->ready[generator->readyHead];
+        struct player *player = &generator->players[index];
+        int cell;
+
+        generator->readyHead = (generator->readyHead + 1) % generator->connections;
+        generator->readyCount--;
+        player->queued = 0;
+
+        if (player->state == PLAYER_CLOSED || (cell = chooseMove(generator, player)) < 0) continue;
+
+        memset(&move, 0, sizeof(struct packet_data));
+        move.x = cell / generator->size;
+        move.y = cell % generator->size;
+        player->moveSentUs = nowUs;
+
+        if (sendMessage(generator, index, MESSAGE_MOVE, &move) == 0 && generator->rate > 0) generator->budget -= 1.0;
+    }
+}
+
+/*
+ * Desc: Picks a legal move: a random empty cell, or the first empty cell for the scripted strategy.
+ * Params:
+ *    generator - generator owning the player
+ *    player - player to move
+ * Returns: index of the chosen cell or -1 if the board is full
+ */
+int chooseMove(struct loadGenerator *generator, struct player *player) {
+    int cellCount = generator->size * generator->size;
+    int emptyCount = cellCount - player->stoneCount;
+    int skip = generator->strategy == STRATEGY_RANDOM && emptyCount > 0 ? rand_r(&generator->seed) % emptyCount : 0;
+
+    for (int cell = 0; cell < cellCount; cell++) {
+        if (player->cells[cell] == 0 && skip-- == 0) return cell;
+    }
+
+    return -1;
+}
+
+/*
+ * Desc: Queues a message for a player and sends it as far as the socket accepts it without blocking.
+ * Params:
+ *    generator - generator owning the player
+ *    index - index of the player
+ *    type - MESSAGE_JOIN or MESSAGE_MOVE
+ *    packet - content of the message
+ * Returns: 0 if queued, -1 if the player had to be closed
+ */
+int sendMessage(struct loadGenerator *generator, int index, int type, struct packet_data *packet) {
+    struct player *player = &generator->players[index];
+    uint8_t frame[MAX_MESSAGE_SIZE];
+    int frameLength = encodeMessage(frame, sizeof(frame), type, packet);
+
+    if (frameLength < 0 || appendToBuffer(&player->output, frame, frameLength) != 0) {
+        closePlayer(generator, index);
+        return DEFAULT_ERROR_RETURN;
+    }
+
+    if (player->state == PLAYER_CONNECTING) return DEFAULT_RETURN;
+    if (flushSendBuffer(player->fileDescriptor, &player->output) < 0) {
+        closePlayer(generator, index);
+        return DEFAULT_ERROR_RETURN;
+    }
+
+    return DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Closes the connection of a player. Players closed before the end of the run count as failures.
+ * Params:
+ *    generator - generator owning the player
+ *    index - index of the player
+ */
+void closePlayer(struct loadGenerator *generator, int index) {
+    struct player *player = &generator->players[index];
+
+    if (player->state == PLAYER_CLOSED) return;
+    if (player->fileDescriptor >= 0) close(player->fileDescriptor);
+
+    player->state = PLAYER_CLOSED;
+    player->fileDescriptor = -1;
+    generator->failures++;
+}
+
+/*
+ * Desc: Stores a latency sample, growing the sample array when it is full.
+ * Params:
+ *    generator - generator collecting the samples
+ *    latencyUs - latency in microseconds
+ */
+void recordLatency(struct loadGenerator *generator, long long latencyUs) {
+    if (generator->latencyCount == generator->latencyCapacity) {
+        uint32_t *latencies = realloc(generator->latencies, generator->latencyCapacity * 2 * sizeof(uint32_t));
+        if (latencies == NULL) return;
+
+        generator->latencies = latencies;
+        generator->latencyCapacity *= 2;
+    }
+
+    generator->latencies[generator->latencyCount++] = latencyUs < 0 ? 0 : (uint32_t) latencyUs;
+}
+
+/*
+ * Desc: Prints the achieved move rate, the finished games and the latency percentiles of the run.
+ * Params:
+ *    generator - generator of the run
+ *    elapsedUs - duration of the run
+ */
+void printReport(struct loadGenerator *generator, long long elapsedUs) {
+    long count = generator->latencyCount;
+    uint32_t *latencies = generator->latencies;
+
+    qsort(latencies, count, sizeof(uint32_t), compareLatencies);
+
+    printf("connections: %d, failed: %ld\n", generator->opened, generator->failures);
+    printf("moves: %ld, games: %ld, moves/s: %.0f\n", generator->moves, generator->games,
+           generator->moves * 1000000.0 / (double) elapsedUs);
+
+    if (count == 0) return;
+    printf("latency us: p50 %u, p99 %u, p99.9 %u, max %u\n", latencies[count * 50 / 100], latencies[count * 99 / 100],
+           latencies[count * 999 / 1000], latencies[count - 1]);
+}
+
+/*
+ * Desc: Orders latency samples ascending for qsort.
+ * Params:
+ *    first - first sample
+ *    second - second sample
+ * Returns: negative, zero or positive like strcmp
+ */
+int compareLatencies(const void *first, const void *second) {
+    uint32_t a = *(const uint32_t *) first, b = *(const uint32_t *) second;
+    return (a > b) - (a < b);
+}
+
+/*
+ * Desc: Reads the monotonic clock.
+ * Returns: microseconds since an arbitrary fixed point
+ */
+long long monotonicUs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+/*
+ * Desc: Function handles errors.
+ * Params:
+ *   errorCode - code provided by the method that threw the exception
+ *   errorType - type of function that threw the code
+ *
+ * Error type table:
+ *   1. Usage
+ *   2. Get address info
+ *   3. Memory allocation
+ *   4. Event loop setup
+ *   5. Event loop wait
+ *   6. Connect to address & port
+ *   7. Connection registration
+ *
+ */
+void handleError(int errorCode, int errorType) {
+    switch (errorType) {
+        case 1:
+            printf("Usage: LoadGenerator [-c connections] [-r moves per second] [-d seconds] [-b board size] "
+                   "[-k win length] [-m random|scripted] [-s seed] [-a address] port. Error code: %d\n", errorCode);
+            break;
+
+        case 2:
+            printf("Unable to get address info. Error code: %d\n", errorCode);
+            break;
+
+        case 3:
+            printf("Unable to allocate the players. Error code: %d\n", errorCode);
+            break;
+
+        case 4:
+            printf("Unable to set up the event loop. Error code: %d\n", errorCode);
+            break;
+
+        case 5:
+            printf("Unable to wait for events. Error code: %d\n", errorCode);
+            break;
+
+        case 6:
+            printf("Unable to connect to address & port. Error code: %d\n", errorCode);
+            break;
+
+        case 7:
+            printf("Unable to watch a connection. Error code: %d\n", errorCode);
+            break;
+
+        default:
+            printf("Unknown error type %d. Error code: %d\n", errorType, errorCode);
+    }
+
+    printf("Error code explanation: %s\n", strerror(errorCode));
+}
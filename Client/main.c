@@ -1,30 +1,32 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <getopt.h>
 #include <errno.h>
 #include <string.h>
+#include <time.h>
+#include <poll.h>
 #include <netdb.h>
 #include <sys/types.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
 #include <arpa/inet.h>
+#include "protocol.h"
+#include "render.h"
+#include "strategy.h"
+#include "terminal.h"
 
 #define SERVER_ADDRESS "localhost"
-#define BOARD_SIZE 3
 #define DEFAULT_ERROR_RETURN -1
 #define DEFAULT_RETURN 0
 #define MAX_HOSTNAME_LENGTH 200
 #define MAX_RETRY_COUNT 10
-#define ADVERSARY_NBR 2
+#define CONNECTION_LOST -2
+#define INPUT_CLOSED -3
+#define MAX_RECONNECT_ATTEMPTS 30
+#define RECONNECT_DELAY 1 // seconds between two attempts to reach the server again
 #define DEBUG 0
 
-struct packet_data {
-    int gameState;
-    int enemyMove;
-    int x;
-    int y;
-};
-
 void prepareAddrinfoHints(struct addrinfo *info);
 
 void handleError(int errorCode, int errorType);
@@ -33,34 +35,59 @@ int connectToPort(struct addrinfo *ai, int *socketFd);
 
 int getServerAddress(char address[], int address_length);
 
-int sendData(int socketFd, struct packet_data *data, int timeout);
+int sendData(int socketFd, int type, struct packet_data *data, int timeout);
+
+int receiveFrame(int socketFd, struct receiveBuffer *input, struct terminal *terminal, struct gameBoard *gameBoard,
+                 int *typeByte, uint8_t *payload);
+
+int handleTerminalInput(int socketFd, struct terminal *terminal, struct gameBoard *gameBoard);
+
+int readCoordinates(int socketFd, struct terminal *terminal, struct gameBoard *gameBoard, char *line);
+
+int parseBoardOptions(int argc, char *argv[], struct gameBoard *gameBoard);
 
-int receiveData(int socketFd, struct packet_data *data);
+int sendJoinRequest(int socketFd, struct gameBoard *gameBoard);
 
-int playMatch(int socketFd, int gameBoard[BOARD_SIZE][BOARD_SIZE]);
+int playMatch(int socketFd, struct receiveBuffer *input, struct terminal *terminal, struct gameBoard *gameBoard,
+              struct renderer *renderer);
 
-int playMove(int socketFd, int gameBoard[BOARD_SIZE][BOARD_SIZE]);
+int watchMatch(int socketFd, struct receiveBuffer *input, struct gameBoard *gameBoard, struct renderer *renderer);
 
-void displayGameBoard(struct packet_data *gameData, int gameBoard[BOARD_SIZE][BOARD_SIZE]);
+int playMove(int socketFd, struct gameBoard *gameBoard);
 
-void clearGameBoard(int gameBoard[BOARD_SIZE][BOARD_SIZE]);
+int resumeMatch(int socketFd, struct board_snapshot *snapshot, struct gameBoard *gameBoard,
+                struct renderer *renderer);
+
+int reconnectToServer(struct addrinfo *addrInfo, int *socketFd, struct receiveBuffer *input,
+                      struct gameBoard *gameBoard);
+
+void clearGameBoard(struct gameBoard *gameBoard);
 
 
 int main(int argc, char *argv[]) {
 
     char hostPort[5], hostname[MAX_HOSTNAME_LENGTH];
-    int gameBoard[BOARD_SIZE][BOARD_SIZE];
+    struct gameBoard gameBoard;
+    struct renderer renderer;
+    struct terminal terminal;
+    struct receiveBuffer input;
     struct addrinfo hints, *addrInfo;
     int socketFd, gameRunning;
 
     memset(hostPort, 0, sizeof(hostPort));
     prepareAddrinfoHints(&hints);
 
-    if (argc < 2) {
+    if (parseBoardOptions(argc, argv, &gameBoard) != 0) {
+        handleError(EINVAL, 4);
+        return DEFAULT_ERROR_RETURN;
+    }
+    if (gameBoard.strategy != STRATEGY_HUMAN) srand((unsigned int) time(NULL) ^ (unsigned int) getpid());
+
+    if (optind >= argc || strlen(argv[optind]) >= sizeof(hostPort)) {
         handleError(errno, 1);
         return DEFAULT_ERROR_RETURN;
     } else {
-        strcpy(hostPort, *(argv + 1));
+        strcpy(hostPort, argv[optind]);
     }
 
     if (getServerAddress(hostname, MAX_HOSTNAME_LENGTH) < 0) {
@@ -77,69 +104,321 @@ int main(int argc, char *argv[]) {
         return DEFAULT_ERROR_RETURN;
     }
 
-    freeaddrinfo(addrInfo);
     gameRunning = 1;
-    clearGameBoard(gameBoard);
+    gameBoard.resumeToken = 0;
+    clearGameBoard(&gameBoard);
+    gameBoard.awaitingMove = 0;
+    resetRenderer(&renderer);
+    initTerminal(&terminal, STDIN_FILENO);
+    initReceiveBuffer(&input);
+
+    if (sendJoinRequest(socketFd, &gameBoard) != 0) {
+        handleError(errno, 3);
+        return DEFAULT_ERROR_RETURN;
+    }
+
+    while (gameRunning && gameBoard.strategy == STRATEGY_SPECTATOR) {
+        gameRunning = watchMatch(socketFd, &input, &gameBoard, &renderer) != CONNECTION_LOST;
+    }
 
     while (gameRunning) {
-        playMatch(socketFd, gameBoard);
+        int result = playMatch(socketFd, &input, gameBoard.strategy == STRATEGY_HUMAN ? &terminal : NULL, &gameBoard,
+                               &renderer);
+        gameRunning = result != CONNECTION_LOST && result != INPUT_CLOSED;
+        if (result == CONNECTION_LOST && gameBoard.resumeToken != 0) {
+            gameRunning = reconnectToServer(addrInfo, &socketFd, &input, &gameBoard) == 0;
+        }
     }
 
+    freeaddrinfo(addrInfo);
+    close(socketFd);
+    return DEFAULT_RETURN;
+
+}
+
+/*
+ * Desc: Reads the board size (-b), win length (-k), bot strategy (--bot random|heuristic|perfect) and spectator
+ *       (--spectate[=match id]) options. The port stays the first positional argument.
+ * Params:
+ *    argc - argument count
+ *    argv - argument values
+ *    gameBoard - board to configure
+ * Returns: 0 if the options are valid, -1 otherwise
+ */
+int parseBoardOptions(int argc, char *argv[], struct gameBoard *gameBoard) {
+    static const struct option longOptions[] = {{"bot",      required_argument, NULL, 'B'},
+                                                {"spectate", optional_argument, NULL, 'S'},
+                                                {NULL, 0,                       NULL, 0}};
+    int option;
+
+    gameBoard->size = DEFAULT_BOARD_SIZE;
+    gameBoard->winLength = DEFAULT_WIN_LENGTH;
+    gameBoard->strategy = STRATEGY_HUMAN;
+    gameBoard->matchId = 0;
+
+    while ((option = getopt_long(argc, argv, "b:k:", longOptions, NULL)) != -1) {
+        if (option == 'b') gameBoard->size = atoi(optarg);
+        else if (option == 'k') gameBoard->winLength = atoi(optarg);
+        else if (option == 'B' && (gameBoard->strategy = parseStrategy(optarg)) != STRATEGY_HUMAN) continue;
+        else if (option == 'S') gameBoard->strategy = STRATEGY_SPECTATOR;
+        else return DEFAULT_ERROR_RETURN;
+
+        if (option == 'S' && optarg != NULL) gameBoard->matchId = strtoull(optarg, NULL, 0);
+    }
+
+    if (gameBoard->size < MIN_BOARD_SIZE || gameBoard->size > MAX_BOARD_SIZE) return DEFAULT_ERROR_RETURN;
+    if (gameBoard->winLength < MIN_BOARD_SIZE || gameBoard->winLength > gameBoard->size) return DEFAULT_ERROR_RETURN;
+    return DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Tells the server which board size and win length the player wants to play or watch, and for a spectator the
+ *       id of the match to watch.
+ * Params:
+ *    socketFd - connected to the server socket file descriptor
+ *    gameBoard - board with the requested variant
+ * Returns: 0 if sent, -1 if error
+ */
+int sendJoinRequest(int socketFd, struct gameBoard *gameBoard) {
+    struct packet_data data;
+    memset(&data, 0, sizeof(struct packet_data));
+
+    data.x = gameBoard->size;
+    data.y = gameBoard->winLength;
+    data.token = gameBoard->matchId;
+    if (gameBoard->strategy == STRATEGY_SPECTATOR) return sendData(socketFd, MESSAGE_SPECTATE, &data, MAX_RETRY_COUNT);
 
+    data.gameState = JOIN_REQUEST;
+    return sendData(socketFd, MESSAGE_JOIN, &data, MAX_RETRY_COUNT);
 }
 
 /*
- * Desc: Main game loop function that handles the game progress and data manipulation
+ * Desc: Main game loop function that handles the game progress and data manipulation. Bots play without any
+ *       terminal output. Keeps the resume token of the running match, and picks up a resumed match from its snapshot.
  * Params:
  *    socketFd - connected to the server socket file descriptor
+ *    input - bytes received from the server that have not been decoded yet
+ *    terminal - input typed by a human player, NULL for bots
  *    gameBoard - current game board
+ *    renderer - renderer of the terminal
  * Returns:
  *    0 - if all is ok
  *    -1 - if error occured
+ *    -2 - if the connection to the server is lost
+ *    -3 - if the player closed the terminal
  */
-int playMatch(int socketFd, int gameBoard[BOARD_SIZE][BOARD_SIZE]) {
+int playMatch(int socketFd, struct receiveBuffer *input, struct terminal *terminal, struct gameBoard *gameBoard,
+              struct renderer *renderer) {
+    uint8_t payload[MAX_FRAME_PAYLOAD];
+    struct board_snapshot snapshot;
     struct packet_data gameData;
-    memset(&gameData, 0, sizeof(struct packet_data));
+    int human = gameBoard->strategy == STRATEGY_HUMAN;
+    int typeByte, length;
+
+    if ((length = receiveFrame(socketFd, input, terminal, gameBoard, &typeByte, payload)) < 0) return length;
 
-    receiveData(socketFd, &gameData);
+    // Every state ends the turn the player may have been typing a move for; a new turn asks for a move again.
+    if (decodeSnapshot(typeByte, payload, length, &snapshot) == MESSAGE_SNAPSHOT) {
+        gameBoard->awaitingMove = 0;
+        return resumeMatch(socketFd, &snapshot, gameBoard, renderer);
+    }
+
+    switch (decodeMessage(typeByte, payload, length, &gameData)) {
+        case MESSAGE_TOKEN:
+            gameBoard->resumeToken = gameData.token;
+            gameBoard->player = gameData.x;
+            return DEFAULT_RETURN;
+
+        case MESSAGE_STATE:
+            gameBoard->awaitingMove = 0;
+            break;
+
+        default:
+            return DEFAULT_ERROR_RETURN;
+    }
     if (DEBUG) printf("GameState: %d.\n", gameData.gameState);
 
     if (gameData.gameState == 0) {
-        printf("Waiting for a second client to connect.\n");
+        if (human && gameData.x > 0) printf("Waiting for an opponent. Position in queue: %d.\n", gameData.x);
+        else if (human) printf("Waiting for a second client to connect.\n");
         clearGameBoard(gameBoard);
+        resetRenderer(renderer);
         return DEFAULT_RETURN;
 
     } else if (gameData.gameState == 1) {
-        if (gameData.enemyMove == 0) {
-            system("clear\n");
+        if (gameData.x < 0) clearGameBoard(gameBoard);
 
-            if (gameData.x >= 0 && gameData.y >= 0) gameBoard[gameData.x][gameData.y] = ADVERSARY_NBR;
-            displayGameBoard(&gameData, gameBoard);
+        if (gameData.enemyMove == 0) {
+            if (gameData.x >= 0 && gameData.y >= 0) gameBoard->cells[gameData.x][gameData.y] = ADVERSARY_NBR;
+            if (!human) return playMove(socketFd, gameBoard);
 
-            printf("Your move. \n");
-            playMove(socketFd, gameBoard);
+            renderBoard(renderer, gameBoard, "Your move.\n");
+            return playMove(socketFd, gameBoard);
 
         } else if (gameData.enemyMove == 1) {
-            gameBoard[gameData.x][gameData.y] = ADVERSARY_NBR + 1;
-            displayGameBoard(&gameData, gameBoard);
+            if (gameData.x >= 0 && gameData.y >= 0) gameBoard->cells[gameData.x][gameData.y] = OWN_NBR;
+            if (!human) return DEFAULT_RETURN;
 
-            printf("Wait for your turn.\n");
+            renderBoard(renderer, gameBoard, "Wait for your turn.\n");
             return DEFAULT_RETURN;
         }
     } else if (gameData.gameState == 2) {
+        clearGameBoard(gameBoard);
+        resetRenderer(renderer);
+        gameBoard->resumeToken = 0;
+        if (!human) return DEFAULT_RETURN;
+
         //TODO: Separate UI from logic.
         printf("Match concluded.\n");
         if (gameData.enemyMove == 0) printf("Congratulations, you won!\n");
         if (gameData.enemyMove == 1) printf("Bummer, you lost :(\n");
         if (gameData.enemyMove == 2) printf("Whoa, it's a draw :O\n");
+    }
+    return DEFAULT_ERROR_RETURN;
+}
 
-        clearGameBoard(gameBoard);
+/*
+ * Desc: Takes over the board of a resumed match from its snapshot and plays the next move if it is the player's turn.
+ * Params:
+ *    socketFd - connected to the server socket file descriptor
+ *    snapshot - board of the match as the server kept it
+ *    gameBoard - board to replace
+ *    renderer - renderer of the terminal, redrawing the board in full
+ * Returns: 0 if resumed, -1 if the snapshot is not a board of this client or the move could not be sent
+ */
+int resumeMatch(int socketFd, struct board_snapshot *snapshot, struct gameBoard *gameBoard,
+                struct renderer *renderer) {
+    int stones = 0;
+
+    if (snapshot->size < MIN_BOARD_SIZE || snapshot->size > MAX_BOARD_SIZE) return DEFAULT_ERROR_RETURN;
+
+    gameBoard->size = snapshot->size;
+    gameBoard->winLength = snapshot->winLength;
+    for (int i = 0; i < snapshot->size * snapshot->size; i++) {
+        int cell = snapshot->cells[i] - 1 == gameBoard->player ? OWN_NBR : ADVERSARY_NBR;
+        gameBoard->cells[i / snapshot->size][i % snapshot->size] = snapshot->cells[i] == 0 ? EMPTY_CELL : cell;
+        stones += snapshot->cells[i] != 0;
+    }
+
+    // Players take turns starting with player 0, so the number of stones tells whose move it is.
+    if (gameBoard->strategy != STRATEGY_HUMAN && stones % 2 != gameBoard->player) return DEFAULT_RETURN;
+    if (gameBoard->strategy != STRATEGY_HUMAN) return playMove(socketFd, gameBoard);
+
+    resetRenderer(renderer);
+    if (stones % 2 != gameBoard->player) {
+        renderBoard(renderer, gameBoard, "Match resumed.\nWait for your turn.\n");
+        return DEFAULT_RETURN;
+    }
+
+    renderBoard(renderer, gameBoard, "Match resumed.\nYour move.\n");
+    return playMove(socketFd, gameBoard);
+}
+
+/*
+ * Desc: Connects to the server again after the connection was lost in the middle of a match and asks to resume the
+ *       match with its token. The server may be restarting, so the client keeps trying for a while.
+ * Params:
+ *    addrInfo - address info of the server
+ *    socketFd - socket of the lost connection, replaced by the new one
+ *    input - receive buffer, emptied for the new connection
+ *    gameBoard - board of the match, its token is used up
+ * Returns: 0 if the server answered the resume request, -1 if it could not be reached or does not know the match
+ */
+int reconnectToServer(struct addrinfo *addrInfo, int *socketFd, struct receiveBuffer *input,
+                      struct gameBoard *gameBoard) {
+    struct packet_data data;
+    int receivedBytes;
+
+    close(*socketFd);
+    memset(&data, 0, sizeof(struct packet_data));
+    data.token = gameBoard->resumeToken;
+    gameBoard->resumeToken = 0;
+    if (gameBoard->strategy == STRATEGY_HUMAN) printf("Connection lost, trying to resume the match.\n");
+
+    for (int attempt = 0; attempt < MAX_RECONNECT_ATTEMPTS; attempt++) {
+        if (connectToPort(addrInfo, socketFd) != 0) {
+            sleep(RECONNECT_DELAY);
+            continue;
+        }
+
+        // The listener of a server being killed may still accept, so only an answer proves the server is back. A
+        // server that does not know the token closes the connection without one.
+        initReceiveBuffer(input);
+        receivedBytes = sendData(*socketFd, MESSAGE_RESUME, &data, MAX_RETRY_COUNT) == 0
+                        ? receiveIntoBuffer(*socketFd, input) : -1;
+        if (receivedBytes > 0) return DEFAULT_RETURN;
+        if (receivedBytes == 0) break;
+
+        close(*socketFd);
+        sleep(RECONNECT_DELAY);
     }
     return DEFAULT_ERROR_RETURN;
 }
 
 /*
- * Desc: Function handles collecting the move from the player and sending it to server.
+ * Desc: Spectator loop function: applies the next snapshot or move of the watched match to the board and shows it.
+ * Params:
+ *    socketFd - connected to the server socket file descriptor
+ *    input - bytes received from the server that have not been decoded yet
+ *    gameBoard - board of the watched match
+ *    renderer - renderer of the terminal
+ * Returns:
+ *    0 - if all is ok
+ *    -1 - if a message was not understood
+ *    -2 - if the connection to the server is lost
+ */
+int watchMatch(int socketFd, struct receiveBuffer *input, struct gameBoard *gameBoard, struct renderer *renderer) {
+    uint8_t payload[MAX_FRAME_PAYLOAD];
+    char status[RENDER_STATUS_SIZE];
+    struct board_snapshot snapshot;
+    struct packet_data gameData;
+    int typeByte, length;
+
+    if ((length = receiveFrame(socketFd, input, NULL, gameBoard, &typeByte, payload)) < 0) return length;
+
+    if (decodeSnapshot(typeByte, payload, length, &snapshot) == MESSAGE_SNAPSHOT) {
+        if (snapshot.size < MIN_BOARD_SIZE || snapshot.size > MAX_BOARD_SIZE) return DEFAULT_ERROR_RETURN;
+
+        gameBoard->size = snapshot.size;
+        gameBoard->winLength = snapshot.winLength;
+        for (int i = 0; i < snapshot.size * snapshot.size; i++) {
+            int cell = snapshot.cells[i] == 0 ? EMPTY_CELL : ADVERSARY_NBR + snapshot.cells[i] - 1;
+            gameBoard->cells[i / snapshot.size][i % snapshot.size] = cell;
+        }
+
+        snprintf(status, sizeof(status), "Watching a match on a %dx%d board, %d in a row.\n", snapshot.size,
+                 snapshot.size, snapshot.winLength);
+        resetRenderer(renderer);
+        renderBoard(renderer, gameBoard, status);
+        return DEFAULT_RETURN;
+    }
+
+    if (decodeMessage(typeByte, payload, length, &gameData) != MESSAGE_STATE) return DEFAULT_ERROR_RETURN;
+
+    if (gameData.gameState == 0) {
+        printf("Waiting for a match to watch.\n");
+        resetRenderer(renderer);
+        return DEFAULT_RETURN;
+    }
+
+    if (gameData.x >= 0 && gameData.x < gameBoard->size && gameData.y >= 0 && gameData.y < gameBoard->size &&
+        gameData.enemyMove < 2) {
+        gameBoard->cells[gameData.x][gameData.y] = ADVERSARY_NBR + gameData.enemyMove;
+    }
+
+    status[0] = 0;
+    if (gameData.gameState == 2 && gameData.enemyMove == 2) {
+        snprintf(status, sizeof(status), "The match ended in a draw.\n");
+    } else if (gameData.gameState == 2) {
+        snprintf(status, sizeof(status), "%c won the match.\n", gameData.enemyMove == 0 ? 'X' : 'O');
+    }
+    renderBoard(renderer, gameBoard, status);
+    return DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Function handles the move of the player: a bot picks and sends its move right away, a human player is asked
+ *       for one, which is sent once its coordinates have been typed (see readCoordinates).
  * Params:
  *    socketFd - file descriptor of the socket that is connected to the server
  *    gameBoard - current state of the game board
@@ -147,52 +426,85 @@ int playMatch(int socketFd, int gameBoard[BOARD_SIZE][BOARD_SIZE]) {
  *    0 - if all is ok
  *    -1 - if error has occurred
  */
-int playMove(int socketFd, int gameBoard[BOARD_SIZE][BOARD_SIZE]) {
-    int x, y;
-    char temp[200];
+int playMove(int socketFd, struct gameBoard *gameBoard) {
     struct packet_data data;
     memset(&data, 0, sizeof(struct packet_data));
 
+    if (gameBoard->strategy != STRATEGY_HUMAN) {
+        if (chooseMove(gameBoard, &data.x, &data.y) != 0) return DEFAULT_ERROR_RETURN;
+        return sendData(socketFd, MESSAGE_MOVE, &data, MAX_RETRY_COUNT);
+    }
+
     printf("Enter the vertical (Y) and then the horizontal (X) coordinates you'd like to play.\n");
-    scanf("%s", temp);
-    x = atoi(temp);
-    scanf("%s", temp);
-    y = atoi(temp);
+    fflush(stdout);
+    gameBoard->awaitingMove = 1;
+    return DEFAULT_RETURN;
+}
 
-    if (x >= 0 && x <= BOARD_SIZE - 1 && y >= 0 && y <= BOARD_SIZE - 1 && gameBoard[x][y] == 0) {
-        data.x = x;
-        data.y = y;
-        return sendData(socketFd, &data, MAX_RETRY_COUNT);
+/*
+ * Desc: Handles the lines the player typed. Lines typed while it is not the player's turn are answered and dropped.
+ * Params:
+ *    socketFd - file descriptor of the socket that is connected to the server
+ *    terminal - terminal that has input ready
+ *    gameBoard - current state of the game board
+ * Returns: 0 if handled, -1 if a move could not be sent, INPUT_CLOSED if the terminal was closed
+ */
+int handleTerminalInput(int socketFd, struct terminal *terminal, struct gameBoard *gameBoard) {
+    char line[TERMINAL_LINE_SIZE];
+    int readBytes = readTerminal(terminal);
 
-    } else {
-        printf("Please enter valid coordinates!\n");
-        return playMove(socketFd, gameBoard);
+    if (readBytes == 0) return INPUT_CLOSED;
+    if (readBytes < 0) return errno == EINTR || errno == EAGAIN ? DEFAULT_RETURN : INPUT_CLOSED;
+
+    while (takeLine(terminal, line, sizeof(line)) >= 0) {
+        if (!gameBoard->awaitingMove) {
+            printf("Wait for your turn.\n");
+            fflush(stdout);
+            continue;
+        }
+        if (readCoordinates(socketFd, terminal, gameBoard, line) != 0) return DEFAULT_ERROR_RETURN;
     }
+    return DEFAULT_RETURN;
 }
 
 /*
- * Desc: Function that prints the state of the game board after the last move
+ * Desc: Takes the coordinates of a move from a typed line and sends the move once both are known and name an empty
+ *       cell. Invalid input asks for the move again.
  * Params:
- *    gameData - struct containing the last move data
+ *    socketFd - file descriptor of the socket that is connected to the server
+ *    terminal - terminal keeping a coordinate typed on an earlier line
  *    gameBoard - current state of the game board
+ *    line - typed line, modified while it is split into words
+ * Returns: 0 if handled, -1 if the move could not be sent
  */
-void displayGameBoard(struct packet_data *gameData, int gameBoard[BOARD_SIZE][BOARD_SIZE]) {
-    printf("  ");
-    for (int i = 0; i < BOARD_SIZE; i++) printf(" %d", i);
-    printf("\n  ");
-    for (int i = 0; i < BOARD_SIZE; i++) printf("__");
-    printf("\n");
-
-    for (int i = 0; i < BOARD_SIZE; i++) {
-        printf("%d|", i);
-        for (int j = 0; j < BOARD_SIZE; j++) {
-
-            if (gameBoard[i][j] == 0) printf("  ");
-            else if (gameBoard[i][j] == ADVERSARY_NBR) printf(" X");
-            else if (gameBoard[i][j] == ADVERSARY_NBR + 1) printf(" O");
-        }
-        printf("\n");
+int readCoordinates(int socketFd, struct terminal *terminal, struct gameBoard *gameBoard, char *line) {
+    struct packet_data data;
+    char *word, *end, *position;
+    long value;
+
+    for (word = strtok_r(line, " \t\r", &position); word != NULL; word = strtok_r(NULL, " \t\r", &position)) {
+        value = strtol(word, &end, 10);
+        if (*end != 0 || value < 0 || value >= gameBoard->size) break;
+        terminal->coordinates[terminal->coordinateCount++] = (int) value;
+        if (terminal->coordinateCount == 2) break;
+    }
+
+    if (word == NULL) return DEFAULT_RETURN;
+    terminal->coordinateCount = 0;
+
+    if (*end != 0 || value < 0 || value >= gameBoard->size ||
+        gameBoard->cells[terminal->coordinates[0]][terminal->coordinates[1]] != EMPTY_CELL) {
+        printf("Please enter valid coordinates!\n");
+        printf("Enter the vertical (Y) and then the horizontal (X) coordinates you'd like to play.\n");
+        fflush(stdout);
+        return DEFAULT_RETURN;
     }
+
+    memset(&data, 0, sizeof(struct packet_data));
+    data.x = terminal->coordinates[0];
+    data.y = terminal->coordinates[1];
+    gameBoard->awaitingMove = 0;
+    return sendData(socketFd, MESSAGE_MOVE, &data, MAX_RETRY_COUNT);
 }
 
 /*
@@ -200,39 +512,75 @@ void displayGameBoard(struct packet_data *gameData, int gameBoard[BOARD_SIZE][BO
  * Params:
  *    gameBoard - board to reset
  */
-void clearGameBoard(int gameBoard[BOARD_SIZE][BOARD_SIZE]) {
-    for (int i = 0; i < BOARD_SIZE; i++) {
-        memset(gameBoard[i], 0, sizeof(gameBoard[i]));
-    }
+void clearGameBoard(struct gameBoard *gameBoard) {
+    memset(gameBoard->cells, 0, sizeof(gameBoard->cells));
 }
 
 /*
- * Desc: Function repeatedly tries to send all data until it's all sent or a timeout is reached.
+ * Desc: Function packs the packet into a message and repeatedly tries to send the whole frame until it's all sent or
+ *       a timeout is reached.
  * Params:
  *   socketFd - socket file descriptor to be used for sending data
+ *   type - MESSAGE_JOIN or MESSAGE_MOVE
  *   data - packet_data to send
  *   timeout - number of retries to send data in case it's not sent
  * Returns: 0 if sent, -1 if error
  */
-int sendData(int socketFd, struct packet_data *data, int timeout) {
-    int sentBits = send(socketFd, data, sizeof(struct packet_data), 0);
-
-    if (sentBits < sizeof(struct packet_data) && timeout > 0) {
-        return (sendData(socketFd, data, timeout) == sizeof(struct packet_data)) - 1;
+int sendData(int socketFd, int type, struct packet_data *data, int timeout) {
+    uint8_t frame[MAX_MESSAGE_SIZE];
+    int frameLength = encodeMessage(frame, sizeof(frame), type, data);
+    int sentBytes = 0;
+
+    while (sentBytes < frameLength && timeout-- >= 0) {
+        int sent = send(socketFd, frame + sentBytes, frameLength - sentBytes, 0);
+        if (sent > 0) sentBytes += sent;
+        else if (sent < 0 && errno != EINTR) break;
     }
-    return (sentBits == sizeof(struct packet_data)) - 1;
+    return frameLength > 0 && sentBytes == frameLength ? 0 : -1;
 }
 
 /*
- * Desc:
+ * Desc: Event loop of the client: returns the next frame sent by the server, polling the socket and the terminal of a
+ *       human player together until a whole frame has arrived. Lines typed meanwhile are handled right away, so the
+ *       player sees what the server sends while typing a move. Frames received together with an earlier one are kept
+ *       in the input buffer for the following calls.
  * Params:
  *   socketFd - socket file descriptor to listen for
- *   data - packet_data buffer to fill with received data
- * Returns: 0 if sent, -1 if error
+ *   input - bytes received from the server that have not been decoded yet
+ *   terminal - input typed by a human player, NULL if nothing is typed
+ *   gameBoard - current state of the game board
+ *   typeByte - filled with the type byte of the frame
+ *   payload - MAX_FRAME_PAYLOAD bytes to fill with the payload
+ * Returns: payload length, -1 if the frame is malformed, CONNECTION_LOST if the connection is lost, INPUT_CLOSED if
+ *          the player closed the terminal
  */
-int receiveData(int socketFd, struct packet_data *data) {
-    int receivedBits = recv(socketFd, data, sizeof(struct packet_data), 0);
-    return (receivedBits == sizeof(struct packet_data)) - 1;
+int receiveFrame(int socketFd, struct receiveBuffer *input, struct terminal *terminal, struct gameBoard *gameBoard,
+                 int *typeByte, uint8_t *payload) {
+    struct pollfd descriptors[2];
+    int length, receivedBytes;
+
+    while ((length = takeFrame(input, typeByte, payload, MAX_FRAME_PAYLOAD)) == -2) {
+        descriptors[0].fd = socketFd;
+        descriptors[0].events = POLLIN;
+        descriptors[1].fd = terminal != NULL && !terminal->closed ? terminal->fileDescriptor : -1;
+        descriptors[1].events = POLLIN;
+        descriptors[0].revents = descriptors[1].revents = 0;
+
+        if (poll(descriptors, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            return CONNECTION_LOST;
+        }
+
+        // What the server sent is applied before typed input, so a move is never checked against an outdated board.
+        if (descriptors[0].revents != 0) {
+            receivedBytes = receiveIntoBuffer(socketFd, input);
+            if (receivedBytes == 0 || (receivedBytes < 0 && errno != EINTR)) return CONNECTION_LOST;
+
+        } else if (descriptors[1].revents != 0 && handleTerminalInput(socketFd, terminal, gameBoard) == INPUT_CLOSED) {
+            return INPUT_CLOSED;
+        }
+    }
+    return length < 0 ? DEFAULT_ERROR_RETURN : length;
 }
 
 
@@ -243,10 +591,9 @@ int receiveData(int socketFd, struct packet_data *data) {
  * Returns: 0 if okay, -1 if error occurred
  */
 int getServerAddress(char address[], int address_length) {
-    for (int i = 0; i < address_length; i++) {
-        if (address[i] == 0) break;
-        address[i] = SERVER_ADDRESS[i];
-    }
+    if (strlen(SERVER_ADDRESS) >= (size_t) address_length) return DEFAULT_ERROR_RETURN;
+
+    strcpy(address, SERVER_ADDRESS);
     return 0;
 }
 
@@ -316,6 +663,7 @@ int connectToPort(struct addrinfo *ai, int *socketFd) {
  *   1. Port number
  *   2. Get address info
  *   3. Connect to address & port
+ *   4. Board options
  *
  */
 void handleError(int errorCode, int errorType) {
@@ -332,6 +680,11 @@ void handleError(int errorCode, int errorType) {
             printf("Unable to connect to address & port. Error code: %d\n", errorCode);
             break;
 
+        case 4:
+            printf("Usage: Client [-b board size] [-k win length] [--bot random|heuristic|perfect] "
+                   "[--spectate[=match id]] port. Error code: %d\n", errorCode);
+            break;
+
         default:
             printf("Unknown error type %d. Error code: %d\n", errorType, errorCode);
     }
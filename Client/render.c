@@ -0,0 +1,145 @@
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <unistd.h>
+#include "render.h"
+
+#define DEFAULT_ERROR_RETURN -1
+#define DEFAULT_RETURN 0
+#define BOARD_FIRST_ROW 3 // terminal row of the first board row, below the column numbers and the top border
+
+void drawFullBoard(struct renderer *renderer, struct gameBoard *gameBoard);
+
+void drawChangedCells(struct renderer *renderer, struct gameBoard *gameBoard);
+
+char cellMark(int cell);
+
+void appendText(struct renderer *renderer, const char *format, ...);
+
+int writeFrame(struct renderer *renderer);
+
+/*
+ * Desc: Forgets what the screen shows, so the next frame redraws the board in full, e.g. for a new match or after
+ *       text was printed over the board.
+ * Params:
+ *    renderer - renderer to reset
+ */
+void resetRenderer(struct renderer *renderer) {
+    renderer->drawnSize = 0;
+    renderer->length = 0;
+}
+
+/*
+ * Desc: Brings the board on the screen up to date and replaces the status lines below it, writing the whole frame at
+ *       once. Only the cells that changed since the last frame are redrawn, unless the board is not on the screen yet
+ *       or changed its size.
+ * Params:
+ *    renderer - renderer of the terminal
+ *    gameBoard - board to show
+ *    status - text shown below the board, ending with a newline
+ * Returns: 0 if written, -1 if error occurred with errno set
+ */
+int renderBoard(struct renderer *renderer, struct gameBoard *gameBoard, const char *status) {
+    renderer->length = 0;
+
+    if (renderer->drawnSize != gameBoard->size) drawFullBoard(renderer, gameBoard);
+    else drawChangedCells(renderer, gameBoard);
+
+    appendText(renderer, "\x1b[%d;1H\x1b[J%.*s", BOARD_FIRST_ROW + gameBoard->size, RENDER_STATUS_SIZE, status);
+    return writeFrame(renderer);
+}
+
+/*
+ * Desc: Clears the screen and draws the column numbers, the top border and every row of the board.
+ * Params:
+ *    renderer - renderer of the terminal
+ *    gameBoard - board to draw
+ */
+void drawFullBoard(struct renderer *renderer, struct gameBoard *gameBoard) {
+    appendText(renderer, "\x1b[H\x1b[2J   ");
+    for (int i = 0; i < gameBoard->size; i++) appendText(renderer, "%3d", i);
+    appendText(renderer, "\n   ");
+    for (int i = 0; i < gameBoard->size; i++) appendText(renderer, "___");
+    appendText(renderer, "\n");
+
+    for (int i = 0; i < gameBoard->size; i++) {
+        appendText(renderer, "%2d|", i);
+        for (int j = 0; j < gameBoard->size; j++) {
+            appendText(renderer, "  %c", cellMark(gameBoard->cells[i][j]));
+            renderer->drawn[i][j] = gameBoard->cells[i][j];
+        }
+        appendText(renderer, "\n");
+    }
+
+    renderer->drawnSize = gameBoard->size;
+}
+
+/*
+ * Desc: Moves the cursor to every cell that differs from the screen and redraws it.
+ * Params:
+ *    renderer - renderer of the terminal
+ *    gameBoard - board to draw
+ */
+void drawChangedCells(struct renderer *renderer, struct gameBoard *gameBoard) {
+    for (int i = 0; i < gameBoard->size; i++) {
+        for (int j = 0; j < gameBoard->size; j++) {
+            if (renderer->drawn[i][j] == gameBoard->cells[i][j]) continue;
+
+            // Rows start with the two digit row number and a border, every cell takes three columns.
+            appendText(renderer, "\x1b[%d;%dH%c", BOARD_FIRST_ROW + i, 3 * j + 6, cellMark(gameBoard->cells[i][j]));
+            renderer->drawn[i][j] = gameBoard->cells[i][j];
+        }
+    }
+}
+
+/*
+ * Desc: Returns the character showing a cell.
+ * Params:
+ *    cell - EMPTY_CELL, ADVERSARY_NBR or OWN_NBR
+ * Returns: ' ', 'X' or 'O'
+ */
+char cellMark(int cell) {
+    if (cell == ADVERSARY_NBR) return 'X';
+    if (cell == OWN_NBR) return 'O';
+    return ' ';
+}
+
+/*
+ * Desc: Appends formatted text to the frame. Text that does not fit is cut off; the buffer holds a full redraw of the
+ *       largest board, so that only happens to an overlong status.
+ * Params:
+ *    renderer - renderer assembling the frame
+ *    format - printf format of the text
+ */
+void appendText(struct renderer *renderer, const char *format, ...) {
+    int space = RENDER_BUFFER_SIZE - renderer->length;
+    va_list arguments;
+    int length;
+
+    va_start(arguments, format);
+    length = vsnprintf(renderer->buffer + renderer->length, space, format, arguments);
+    va_end(arguments);
+
+    if (length > 0) renderer->length += length < space ? length : space - 1;
+}
+
+/*
+ * Desc: Writes the frame to the terminal. Text printed before is flushed first, so the frame lands behind it.
+ * Params:
+ *    renderer - renderer holding the frame
+ * Returns: 0 if written, -1 if error occurred with errno set
+ */
+int writeFrame(struct renderer *renderer) {
+    int written = 0;
+
+    fflush(stdout);
+    while (written < renderer->length) {
+        ssize_t result = write(STDOUT_FILENO, renderer->buffer + written, renderer->length - written);
+        if (result < 0 && errno == EINTR) continue;
+        if (result < 0) return DEFAULT_ERROR_RETURN;
+        written += (int) result;
+    }
+
+    renderer->length = 0;
+    return DEFAULT_RETURN;
+}
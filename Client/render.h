@@ -0,0 +1,26 @@
+#ifndef CLIENT_RENDER_H
+#define CLIENT_RENDER_H
+
+#include "strategy.h"
+
+#define RENDER_BUFFER_SIZE 4096 // bytes of one frame, enough for a full redraw of the largest board and its status
+#define RENDER_STATUS_SIZE 256 // bytes of the status lines below the board
+
+/*
+ * Terminal output of the board. The renderer remembers the cells it has drawn, so a frame after a move only moves the
+ * cursor to the changed cells with ANSI escape sequences and rewrites them, then replaces the status lines below the
+ * board. Every frame is assembled in the buffer and written with a single write. A drawn size of 0 means the screen
+ * does not show the board, so the next frame clears it and draws the board in full.
+ */
+struct renderer {
+    int drawnSize;
+    int drawn[MAX_BOARD_SIZE][MAX_BOARD_SIZE];
+    int length;
+    char buffer[RENDER_BUFFER_SIZE];
+};
+
+void resetRenderer(struct renderer *renderer);
+
+int renderBoard(struct renderer *renderer, struct gameBoard *gameBoard, const char *status);
+
+#endif
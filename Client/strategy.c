@@ -0,0 +1,266 @@
+#include <stdlib.h>
+#include <string.h>
+#include "strategy.h"
+
+#define DEFAULT_ERROR_RETURN -1
+#define DEFAULT_RETURN 0
+#define MAX_PERFECT_EMPTY_CELLS 10
+#define WIN_SCORE 1000000
+#define BLOCK_SCORE 100000
+
+/*
+ * Directions of the four lines through a cell: row, column, diagonal and anti-diagonal.
+ */
+static const int lineDirections[4][2] = {{0, 1}, {1, 0}, {1, 1}, {1, -1}};
+
+int chooseRandomMove(struct gameBoard *gameBoard, int *x, int *y);
+
+int chooseHeuristicMove(struct gameBoard *gameBoard, int *x, int *y);
+
+int choosePerfectMove(struct gameBoard *gameBoard, int *x, int *y);
+
+int scoreCell(struct gameBoard *gameBoard, int x, int y);
+
+int searchBestScore(struct gameBoard *gameBoard, int player, int emptyCells, int alpha, int beta);
+
+int lineLength(struct gameBoard *gameBoard, int x, int y, int dx, int dy, int player);
+
+int longestLine(struct gameBoard *gameBoard, int x, int y, int player);
+
+int countEmptyCells(struct gameBoard *gameBoard);
+
+/*
+ * Desc: Maps a strategy name from the command line to its strategy.
+ * Params:
+ *    name - random, heuristic or perfect
+ * Returns: the strategy or -1 if the name is unknown
+ */
+int parseStrategy(const char *name) {
+    if (strcmp(name, "random") == 0) return STRATEGY_RANDOM;
+    if (strcmp(name, "heuristic") == 0) return STRATEGY_HEURISTIC;
+    if (strcmp(name, "perfect") == 0) return STRATEGY_PERFECT;
+    return DEFAULT_ERROR_RETURN;
+}
+
+/*
+ * Desc: Picks the next move of a bot with the strategy of the board.
+ * Params:
+ *    gameBoard - current state of the game board
+ *    x - filled with the row of the move
+ *    y - filled with the column of the move
+ * Returns: 0 if a move was picked, -1 if the board is full
+ */
+int chooseMove(struct gameBoard *gameBoard, int *x, int *y) {
+    if (gameBoard->strategy == STRATEGY_RANDOM) return chooseRandomMove(gameBoard, x, y);
+    if (gameBoard->strategy == STRATEGY_PERFECT) return choosePerfectMove(gameBoard, x, y);
+    return chooseHeuristicMove(gameBoard, x, y);
+}
+
+/*
+ * Desc: Picks a uniformly random empty cell.
+ * Params:
+ *    gameBoard - current state of the game board
+ *    x - filled with the row of the move
+ *    y - filled with the column of the move
+ * Returns: 0 if a move was picked, -1 if the board is full
+ */
+int chooseRandomMove(struct gameBoard *gameBoard, int *x, int *y) {
+    int emptyCells = countEmptyCells(gameBoard);
+    if (emptyCells == 0) return DEFAULT_ERROR_RETURN;
+
+    int skip = rand() % emptyCells;
+    for (int i = 0; i < gameBoard->size; i++) {
+        for (int j = 0; j < gameBoard->size; j++) {
+            if (gameBoard->cells[i][j] != EMPTY_CELL || skip-- > 0) continue;
+
+            *x = i;
+            *y = j;
+            return DEFAULT_RETURN;
+        }
+    }
+    return DEFAULT_ERROR_RETURN;
+}
+
+/*
+ * Desc: Picks the empty cell with the best score: winning moves first, then moves blocking a win of the opponent, then
+ *       cells extending the longest lines of either player, preferring cells close to the centre on ties.
+ * Params:
+ *    gameBoard - current state of the game board
+ *    x - filled with the row of the move
+ *    y - filled with the column of the move
+ * Returns: 0 if a move was picked, -1 if the board is full
+ */
+int chooseHeuristicMove(struct gameBoard *gameBoard, int *x, int *y) {
+    int found = 0, bestScore = 0, centre = gameBoard->size / 2;
+
+    for (int i = 0; i < gameBoard->size; i++) {
+        for (int j = 0; j < gameBoard->size; j++) {
+            if (gameBoard->cells[i][j] != EMPTY_CELL) continue;
+
+            int score = scoreCell(gameBoard, i, j) * 2 * MAX_BOARD_SIZE - abs(i - centre) - abs(j - centre);
+            if (found && score <= bestScore) continue;
+
+            found = 1;
+            bestScore = score;
+            *x = i;
+            *y = j;
+        }
+    }
+    return found ? DEFAULT_RETURN : DEFAULT_ERROR_RETURN;
+}
+
+/*
+ * Desc: Picks a move by searching the game tree to the end. A full search is only affordable once few cells are left,
+ *       so earlier in the game on large boards the heuristic move is played instead.
+ * Params:
+ *    gameBoard - current state of the game board
+ *    x - filled with the row of the move
+ *    y - filled with the column of the move
+ * Returns: 0 if a move was picked, -1 if the board is full
+ */
+int choosePerfectMove(struct gameBoard *gameBoard, int *x, int *y) {
+    int emptyCells = countEmptyCells(gameBoard), bestScore = -WIN_SCORE - 1;
+
+    if (emptyCells == 0) return DEFAULT_ERROR_RETURN;
+    if (emptyCells > MAX_PERFECT_EMPTY_CELLS) return chooseHeuristicMove(gameBoard, x, y);
+
+    for (int i = 0; i < gameBoard->size; i++) {
+        for (int j = 0; j < gameBoard->size; j++) {
+            if (gameBoard->cells[i][j] != EMPTY_CELL) continue;
+
+            int score;
+            if (longestLine(gameBoard, i, j, OWN_NBR) + 1 >= gameBoard->winLength) {
+                score = emptyCells;
+            } else {
+                gameBoard->cells[i][j] = OWN_NBR;
+                score = -searchBestScore(gameBoard, ADVERSARY_NBR, emptyCells - 1, -WIN_SCORE, -bestScore);
+                gameBoard->cells[i][j] = EMPTY_CELL;
+            }
+
+            if (score <= bestScore) continue;
+            bestScore = score;
+            *x = i;
+            *y = j;
+        }
+    }
+    return DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Negamax search with alpha-beta pruning. Wins score the number of cells left, so faster wins score higher.
+ * Params:
+ *    gameBoard - board with the moves played so far
+ *    player - player to move, OWN_NBR or ADVERSARY_NBR
+ *    emptyCells - number of empty cells on the board
+ *    alpha - lower bound of the score the player to move is guaranteed
+ *    beta - upper bound of the score the opponent allows
+ * Returns: best score the player to move can reach, 0 for a draw
+ */
+int searchBestScore(struct gameBoard *gameBoard, int player, int emptyCells, int alpha, int beta) {
+    int opponent = player == OWN_NBR ? ADVERSARY_NBR : OWN_NBR;
+
+    if (emptyCells == 0) return 0;
+
+    for (int i = 0; i < gameBoard->size; i++) {
+        for (int j = 0; j < gameBoard->size; j++) {
+            if (gameBoard->cells[i][j] == EMPTY_CELL &&
+                longestLine(gameBoard, i, j, player) + 1 >= gameBoard->winLength) {
+                return emptyCells;
+            }
+        }
+    }
+
+    for (int i = 0; i < gameBoard->size && alpha < beta; i++) {
+        for (int j = 0; j < gameBoard->size && alpha < beta; j++) {
+            if (gameBoard->cells[i][j] != EMPTY_CELL) continue;
+
+            gameBoard->cells[i][j] = player;
+            int score = -searchBestScore(gameBoard, opponent, emptyCells - 1, -beta, -alpha);
+            gameBoard->cells[i][j] = EMPTY_CELL;
+
+            if (score > alpha) alpha = score;
+        }
+    }
+    return alpha;
+}
+
+/*
+ * Desc: Scores an empty cell by the lines of both players it would extend or cut.
+ * Params:
+ *    gameBoard - current state of the game board
+ *    x - row of the cell
+ *    y - column of the cell
+ * Returns: score of the cell, higher is better
+ */
+int scoreCell(struct gameBoard *gameBoard, int x, int y) {
+    int score = 0;
+
+    for (int d = 0; d < 4; d++) {
+        int own = lineLength(gameBoard, x, y, lineDirections[d][0], lineDirections[d][1], OWN_NBR);
+        int adversary = lineLength(gameBoard, x, y, lineDirections[d][0], lineDirections[d][1], ADVERSARY_NBR);
+
+        if (own + 1 >= gameBoard->winLength) return WIN_SCORE;
+        if (adversary + 1 >= gameBoard->winLength) score += BLOCK_SCORE;
+        score += own * own * 2 + adversary * adversary;
+    }
+    return score;
+}
+
+/*
+ * Desc: Counts the stones of a player next to a cell along one line, on both sides of the cell.
+ * Params:
+ *    gameBoard - current state of the game board
+ *    x - row of the cell
+ *    y - column of the cell
+ *    dx - row step of the line
+ *    dy - column step of the line
+ *    player - OWN_NBR or ADVERSARY_NBR
+ * Returns: number of consecutive stones, the cell itself not included
+ */
+int lineLength(struct gameBoard *gameBoard, int x, int y, int dx, int dy, int player) {
+    int length = 0, size = gameBoard->size;
+
+    for (int i = x + dx, j = y + dy; i >= 0 && i < size && j >= 0 && j < size; i += dx, j += dy) {
+        if (gameBoard->cells[i][j] != player) break;
+        length++;
+    }
+    for (int i = x - dx, j = y - dy; i >= 0 && i < size && j >= 0 && j < size; i -= dx, j -= dy) {
+        if (gameBoard->cells[i][j] != player) break;
+        length++;
+    }
+    return length;
+}
+
+/*
+ * Desc: Finds the longest line of a player a stone on a cell would join.
+ * Params:
+ *    gameBoard - current state of the game board
+ *    x - row of the cell
+ *    y - column of the cell
+ *    player - OWN_NBR or ADVERSARY_NBR
+ * Returns: number of consecutive stones in the longest line, the cell itself not included
+ */
+int longestLine(struct gameBoard *gameBoard, int x, int y, int player) {
+    int longest = 0;
+
+    for (int d = 0; d < 4; d++) {
+        int length = lineLength(gameBoard, x, y, lineDirections[d][0], lineDirections[d][1], player);
+        if (length > longest) longest = length;
+    }
+    return longest;
+}
+
+/*
+ * Desc: Counts the empty cells of the board.
+ * Params:
+ *    gameBoard - current state of the game board
+ * Returns: number of empty cells
+ */
+int countEmptyCells(struct gameBoard *gameBoard) {
+    int emptyCells = 0;
+
+    for (int i = 0; i < gameBoard->size; i++) {
+        for (int j = 0; j < gameBoard->size; j++) emptyCells += gameBoard->cells[i][j] == EMPTY_CELL;
+    }
+    return emptyCells;
+}
@@ -0,0 +1,44 @@
+#ifndef CLIENT_STRATEGY_H
+#define CLIENT_STRATEGY_H
+
+#include <stdint.h>
+
+#define DEFAULT_BOARD_SIZE 3
+#define DEFAULT_WIN_LENGTH 3
+#define MIN_BOARD_SIZE 3
+#define MAX_BOARD_SIZE 19
+
+#define EMPTY_CELL 0
+#define ADVERSARY_NBR 2
+#define OWN_NBR (ADVERSARY_NBR + 1)
+
+#define STRATEGY_SPECTATOR -2
+#define STRATEGY_HUMAN -1
+#define STRATEGY_RANDOM 0
+#define STRATEGY_HEURISTIC 1
+#define STRATEGY_PERFECT 2
+
+/*
+ * Local copy of the board the client plays on. Cells hold EMPTY_CELL, ADVERSARY_NBR or OWN_NBR. The strategy decides
+ * who picks the moves: STRATEGY_HUMAN reads them from the terminal, STRATEGY_SPECTATOR only watches matches of others
+ * (the first player shown as ADVERSARY_NBR): the match with matchId, or any match of the variant if it is 0. Every
+ * other strategy is a bot. While a match runs, the resume token and seat the server gave the player let the client
+ * rejoin the match after losing its connection; the token is 0 if there is none. A human player may type a move while
+ * awaitingMove is set.
+ */
+struct gameBoard {
+    int size;
+    int winLength;
+    int strategy;
+    uint64_t matchId;
+    int cells[MAX_BOARD_SIZE][MAX_BOARD_SIZE];
+    uint64_t resumeToken;
+    int player;
+    int awaitingMove;
+};
+
+int parseStrategy(const char *name);
+
+int chooseMove(struct gameBoard *gameBoard, int *x, int *y);
+
+#endif
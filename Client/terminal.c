@@ -0,0 +1,58 @@
+#include <string.h>
+#include <unistd.h>
+#include "terminal.h"
+
+/*
+ * Desc: Prepares a terminal with no typed input.
+ * Params:
+ *    terminal - terminal to initialize
+ *    fileDescriptor - descriptor the player types into, usually standard input
+ */
+void initTerminal(struct terminal *terminal, int fileDescriptor) {
+    memset(terminal, 0, sizeof(struct terminal));
+    terminal->fileDescriptor = fileDescriptor;
+}
+
+/*
+ * Desc: Reads the input the terminal has ready with a single system call. Call it once poll reported the terminal as
+ *       readable, so it never blocks.
+ * Params:
+ *    terminal - terminal to read from
+ * Returns: number of bytes read, 0 if the terminal was closed, -1 on error with errno set
+ */
+int readTerminal(struct terminal *terminal) {
+    int space = TERMINAL_LINE_SIZE - terminal->length;
+    ssize_t readBytes;
+
+    // A full buffer without a line break is handed out as a line by takeLine, so there is always room left here.
+    readBytes = read(terminal->fileDescriptor, terminal->data + terminal->length, space);
+    if (readBytes == 0) terminal->closed = 1;
+    if (readBytes > 0) terminal->length += (int) readBytes;
+    return (int) readBytes;
+}
+
+/*
+ * Desc: Takes the oldest complete line typed. A line filling the whole buffer is cut there and handed out as well,
+ *       so an overlong line can never stall the input.
+ * Params:
+ *    terminal - terminal to take the line from
+ *    line - filled with the line without its line break, terminated with a null byte
+ *    capacity - size of the line output
+ * Returns: length of the line, -2 if no complete line has been typed yet
+ */
+int takeLine(struct terminal *terminal, char *line, int capacity) {
+    char *lineBreak = memchr(terminal->data, '\n', terminal->length);
+    int consumed, length;
+
+    if (lineBreak == NULL && terminal->length < TERMINAL_LINE_SIZE) return -2;
+
+    consumed = lineBreak != NULL ? (int) (lineBreak - terminal->data) + 1 : terminal->length;
+    length = lineBreak != NULL ? consumed - 1 : consumed;
+    if (length >= capacity) length = capacity - 1;
+
+    memcpy(line, terminal->data, length);
+    line[length] = 0;
+    memmove(terminal->data, terminal->data + consumed, terminal->length - consumed);
+    terminal->length -= consumed;
+    return length;
+}
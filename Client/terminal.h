@@ -0,0 +1,26 @@
+#ifndef CLIENT_TERMINAL_H
+#define CLIENT_TERMINAL_H
+
+#define TERMINAL_LINE_SIZE 256 // bytes of typed input kept until a line is complete
+
+/*
+ * Input typed by a human player. Bytes are read whenever the terminal has some, without blocking, and handed out as
+ * complete lines. The coordinates of a move may be typed on one line or on two, so the first coordinate is kept until
+ * the second one arrives. Once the terminal is closed (end of file) it is not read anymore.
+ */
+struct terminal {
+    int fileDescriptor;
+    int closed;
+    int length;
+    char data[TERMINAL_LINE_SIZE];
+    int coordinates[2];
+    int coordinateCount;
+};
+
+void initTerminal(struct terminal *terminal, int fileDescriptor);
+
+int readTerminal(struct terminal *terminal);
+
+int takeLine(struct terminal *terminal, char *line, int capacity);
+
+#endif
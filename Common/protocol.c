@@ -0,0 +1,364 @@
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include "protocol.h"
+
+void copyFromBuffer(struct receiveBuffer *buffer, uint32_t position, void *out, int length);
+
+int decodeCoordinate(uint8_t value);
+
+/*
+ * Desc: Empties a receive buffer.
+ * Params:
+ *    buffer - buffer to initialize
+ */
+void initReceiveBuffer(struct receiveBuffer *buffer) {
+    buffer->head = 0;
+    buffer->tail = 0;
+}
+
+/*
+ * Desc: Reads as many bytes as fit into the free space of the buffer with a single system call. The free space may
+ *       wrap around the end of the ring, so it is passed to the kernel as up to two segments.
+ * Params:
+ *    fileDescriptor - socket to read from
+ *    buffer - buffer to fill
+ * Returns: number of bytes read, 0 if the peer closed the connection, -1 on error with errno set. A full buffer is
+ *          reported as ENOBUFS.
+ */
+int receiveIntoBuffer(int fileDescriptor, struct receiveBuffer *buffer) {
+    uint32_t used = buffer->tail - buffer->head;
+    uint32_t space = RECEIVE_BUFFER_SIZE - used;
+    uint32_t offset = buffer->tail & (RECEIVE_BUFFER_SIZE - 1);
+    uint32_t firstLength = RECEIVE_BUFFER_SIZE - offset < space ? RECEIVE_BUFFER_SIZE - offset : space;
+    struct iovec segments[2];
+    ssize_t receivedBytes;
+
+    if (space == 0) {
+        errno = ENOBUFS;
+        return -1;
+    }
+
+    segments[0].iov_base = buffer->data + offset;
+    segments[0].iov_len = firstLength;
+    segments[1].iov_base = buffer->data;
+    segments[1].iov_len = space - firstLength;
+
+    receivedBytes = readv(fileDescriptor, segments, segments[1].iov_len > 0 ? 2 : 1);
+    if (receivedBytes > 0) buffer->tail += receivedBytes;
+    return (int) receivedBytes;
+}
+
+/*
+ * Desc: Decodes the oldest complete frame of the buffer. Frames whose payload does not fit into the output are
+ *       consumed and reported as malformed, so a bad frame can never stall the stream.
+ * Params:
+ *    buffer - buffer to decode from
+ *    type - set to the message type of the frame
+ *    payload - filled with the payload of the frame
+ *    capacity - size of the payload output
+ * Returns: payload length, -1 if the frame is malformed, -2 if no complete frame is buffered yet
+ */
+int takeFrame(struct receiveBuffer *buffer, int *type, void *payload, int capacity) {
+    uint8_t header[FRAME_HEADER_SIZE];
+    uint32_t used = buffer->tail - buffer->head;
+    int length;
+
+    if (used < FRAME_HEADER_SIZE) return -2;
+    copyFromBuffer(buffer, buffer->head, header, FRAME_HEADER_SIZE);
+
+    length = header[0];
+    if (used < FRAME_HEADER_SIZE + (uint32_t) length) return -2;
+
+    *type = header[1];
+    if (length <= capacity) copyFromBuffer(buffer, buffer->head + FRAME_HEADER_SIZE, payload, length);
+    buffer->head += FRAME_HEADER_SIZE + length;
+    return length <= capacity ? length : -1;
+}
+
+/*
+ * Desc: Empties a send buffer.
+ * Params:
+ *    buffer - buffer to initialize
+ */
+void initSendBuffer(struct sendBuffer *buffer) {
+    buffer->head = 0;
+    buffer->tail = 0;
+}
+
+/*
+ * Desc: Queues bytes behind the ones waiting to be sent. Nothing is queued if the bytes do not fit as a whole.
+ * Params:
+ *    buffer - buffer to append to
+ *    bytes - bytes to queue
+ *    length - number of bytes
+ * Returns: 0 if queued, -1 if the buffer has no room for them
+ */
+int appendToBuffer(struct sendBuffer *buffer, const uint8_t *bytes, int length) {
+    uint32_t offset = buffer->tail & (SEND_BUFFER_SIZE - 1);
+    uint32_t space = SEND_BUFFER_SIZE - offset;
+    uint32_t firstLength = space < (uint32_t) length ? space : (uint32_t) length;
+
+    if (length < 0 || SEND_BUFFER_SIZE - (buffer->tail - buffer->head) < (uint32_t) length) return -1;
+
+    memcpy(buffer->data + offset, bytes, firstLength);
+    memcpy(buffer->data, bytes + firstLength, length - firstLength);
+    buffer->tail += length;
+    return 0;
+}
+
+/*
+ * Desc: Sends as much of the queued bytes as the socket accepts without blocking. The queued bytes may wrap around
+ *       the end of the ring, so they are passed to the kernel as up to two segments.
+ * Params:
+ *    fileDescriptor - socket to send to
+ *    buffer - buffer to flush
+ * Returns: number of bytes still queued, -1 on error with errno set
+ */
+int flushSendBuffer(int fileDescriptor, struct sendBuffer *buffer) {
+    while (buffer->tail != buffer->head) {
+        uint32_t used = buffer->tail - buffer->head;
+        uint32_t offset = buffer->head & (SEND_BUFFER_SIZE - 1);
+        uint32_t firstLength = SEND_BUFFER_SIZE - offset < used ? SEND_BUFFER_SIZE - offset : used;
+        struct iovec segments[2];
+        struct msghdr message;
+        ssize_t sentBytes;
+
+        segments[0].iov_base = buffer->data + offset;
+        segments[0].iov_len = firstLength;
+        segments[1].iov_base = buffer->data;
+        segments[1].iov_len = used - firstLength;
+        memset(&message, 0, sizeof(struct msghdr));
+        message.msg_iov = segments;
+        message.msg_iovlen = segments[1].iov_len > 0 ? 2 : 1;
+
+        sentBytes = sendmsg(fileDescriptor, &message, MSG_NOSIGNAL);
+        if (sentBytes < 0 && errno == EINTR) continue;
+        if (sentBytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (sentBytes < 0) return -1;
+        buffer->head += sentBytes;
+    }
+
+    return (int) (buffer->tail - buffer->head);
+}
+
+/*
+ * Desc: Writes a frame with the given payload.
+ * Params:
+ *    frame - output the frame is written to
+ *    capacity - size of the output
+ *    type - message type
+ *    payload - payload of the message
+ *    length - payload length
+ * Returns: size of the frame, -1 if the payload is too long or the frame does not fit into the output
+ */
+int encodeFrame(uint8_t *frame, int capacity, int type, const void *payload, int length) {
+    if (length < 0 || length > MAX_FRAME_PAYLOAD || FRAME_HEADER_SIZE + length > capacity) return -1;
+
+    frame[0] = (uint8_t) length;
+    frame[1] = (uint8_t) type;
+    memcpy(frame + FRAME_HEADER_SIZE, payload, length);
+    return FRAME_HEADER_SIZE + length;
+}
+
+/*
+ * Desc: Packs a message into a frame.
+ * Params:
+ *    frame - output the frame is written to, MAX_MESSAGE_SIZE bytes are always enough
+ *    capacity - size of the output
+ *    type - MESSAGE_JOIN, MESSAGE_MOVE, MESSAGE_STATE, MESSAGE_SPECTATE, MESSAGE_TOKEN or MESSAGE_RESUME
+ *    packet - content of the message
+ * Returns: size of the frame, -1 if the type is unknown or the frame does not fit into the output
+ */
+int encodeMessage(uint8_t *frame, int capacity, int type, const struct packet_data *packet) {
+    uint8_t payload[SPECTATE_PAYLOAD_SIZE];
+    uint32_t position;
+    int length;
+
+    if (type == MESSAGE_JOIN || type == MESSAGE_MOVE || type == MESSAGE_SPECTATE) {
+        payload[0] = (uint8_t) packet->x;
+        payload[1] = (uint8_t) packet->y;
+        length = type == MESSAGE_MOVE ? MOVE_PAYLOAD_SIZE : JOIN_PAYLOAD_SIZE;
+
+        if (type == MESSAGE_SPECTATE) {
+            for (int i = 0; i < 8; i++) payload[2 + i] = (uint8_t) (packet->token >> (56 - 8 * i));
+            length = SPECTATE_PAYLOAD_SIZE;
+        }
+
+    } else if (type == MESSAGE_STATE && packet->gameState == 0) {
+        position = packet->x < 0 ? 0 : packet->x > MAX_QUEUE_POSITION ? MAX_QUEUE_POSITION : packet->x;
+        payload[0] = (uint8_t) (packet->enemyMove & 0x0f);
+        payload[1] = (uint8_t) (position >> 16);
+        payload[2] = (uint8_t) (position >> 8);
+        payload[3] = (uint8_t) position;
+        length = STATE_PAYLOAD_SIZE;
+
+    } else if (type == MESSAGE_STATE) {
+        payload[0] = (uint8_t) ((packet->gameState << 4) | (packet->enemyMove & 0x0f));
+        payload[1] = (uint8_t) packet->x;
+        payload[2] = (uint8_t) packet->y;
+        payload[3] = 0;
+        length = STATE_PAYLOAD_SIZE;
+
+    } else if (type == MESSAGE_TOKEN || type == MESSAGE_RESUME) {
+        for (int i = 0; i < 8; i++) payload[i] = (uint8_t) (packet->token >> (56 - 8 * i));
+        payload[8] = (uint8_t) packet->x;
+        length = type == MESSAGE_TOKEN ? TOKEN_PAYLOAD_SIZE : RESUME_PAYLOAD_SIZE;
+
+    } else {
+        return -1;
+    }
+
+    return encodeFrame(frame, capacity, (PROTOCOL_VERSION << 4) | type, payload, length);
+}
+
+/*
+ * Desc: Unpacks the payload of a frame.
+ * Params:
+ *    typeByte - type byte of the frame, including the protocol version
+ *    payload - payload of the frame
+ *    length - payload length
+ *    packet - filled with the content of the message
+ * Returns: message type, -1 if the version, type or length is not understood
+ */
+int decodeMessage(int typeByte, const uint8_t *payload, int length, struct packet_data *packet) {
+    int type = typeByte & 0x0f;
+
+    if (typeByte >> 4 != PROTOCOL_VERSION) return -1;
+    memset(packet, 0, sizeof(struct packet_data));
+
+    if ((type == MESSAGE_JOIN || type == MESSAGE_SPECTATE) && length == JOIN_PAYLOAD_SIZE) {
+        packet->gameState = type == MESSAGE_JOIN ? JOIN_REQUEST : SPECTATE_REQUEST;
+        packet->x = payload[0];
+        packet->y = payload[1];
+
+    } else if (type == MESSAGE_SPECTATE && length == SPECTATE_PAYLOAD_SIZE) {
+        packet->gameState = SPECTATE_REQUEST;
+        packet->x = payload[0];
+        packet->y = payload[1];
+        for (int i = 0; i < 8; i++) packet->token = packet->token << 8 | payload[2 + i];
+
+    } else if (type == MESSAGE_MOVE && length == MOVE_PAYLOAD_SIZE) {
+        packet->gameState = 1;
+        packet->x = payload[0];
+        packet->y = payload[1];
+
+    } else if (type == MESSAGE_STATE && length == STATE_PAYLOAD_SIZE) {
+        packet->gameState = payload[0] >> 4;
+        packet->enemyMove = payload[0] & 0x0f;
+
+        if (packet->gameState == 0) {
+            packet->x = (payload[1] << 16) | (payload[2] << 8) | payload[3];
+        } else {
+            packet->x = decodeCoordinate(payload[1]);
+            packet->y = decodeCoordinate(payload[2]);
+        }
+
+    } else if ((type == MESSAGE_TOKEN && length == TOKEN_PAYLOAD_SIZE) ||
+               (type == MESSAGE_RESUME && length == RESUME_PAYLOAD_SIZE)) {
+        for (int i = 0; i < 8; i++) packet->token = packet->token << 8 | payload[i];
+        if (type == MESSAGE_TOKEN) packet->x = payload[8];
+        else packet->gameState = RESUME_REQUEST;
+
+    } else {
+        return -1;
+    }
+
+    return type;
+}
+
+/*
+ * Desc: Decodes the oldest complete message of the buffer.
+ * Params:
+ *    buffer - buffer to decode from
+ *    packet - filled with the content of the message
+ * Returns: message type, -1 if the message is malformed, -2 if no complete message is buffered yet
+ */
+int receiveMessage(struct receiveBuffer *buffer, struct packet_data *packet) {
+    uint8_t payload[MAX_FRAME_PAYLOAD];
+    int typeByte;
+    int length = takeFrame(buffer, &typeByte, payload, sizeof(payload));
+
+    if (length < 0) return length;
+    return decodeMessage(typeByte, payload, length, packet);
+}
+
+/*
+ * Desc: Packs a board snapshot into a frame, four cells per byte.
+ * Params:
+ *    frame - output the frame is written to, MAX_SNAPSHOT_SIZE bytes are always enough
+ *    capacity - size of the output
+ *    snapshot - board to pack
+ * Returns: size of the frame, -1 if the board is too large or the frame does not fit into the output
+ */
+int encodeSnapshot(uint8_t *frame, int capacity, const struct board_snapshot *snapshot) {
+    uint8_t payload[MAX_SNAPSHOT_SIZE - FRAME_HEADER_SIZE];
+    int cellCount = snapshot->size * snapshot->size;
+
+    if (snapshot->size < 0 || cellCount > MAX_SNAPSHOT_CELLS) return -1;
+
+    memset(payload, 0, sizeof(payload));
+    payload[0] = (uint8_t) snapshot->size;
+    payload[1] = (uint8_t) snapshot->winLength;
+    payload[2] = (uint8_t) snapshot->gameState;
+    for (int i = 0; i < cellCount; i++) {
+        payload[SNAPSHOT_HEADER_SIZE + i / 4] |= (uint8_t) ((snapshot->cells[i] & 3) << (6 - 2 * (i % 4)));
+    }
+
+    return encodeFrame(frame, capacity, (PROTOCOL_VERSION << 4) | MESSAGE_SNAPSHOT, payload,
+                       SNAPSHOT_HEADER_SIZE + (cellCount + 3) / 4);
+}
+
+/*
+ * Desc: Unpacks the payload of a snapshot frame.
+ * Params:
+ *    typeByte - type byte of the frame, including the protocol version
+ *    payload - payload of the frame
+ *    length - payload length
+ *    snapshot - filled with the board
+ * Returns: MESSAGE_SNAPSHOT, -1 if the version, type or length is not understood
+ */
+int decodeSnapshot(int typeByte, const uint8_t *payload, int length, struct board_snapshot *snapshot) {
+    if (typeByte != ((PROTOCOL_VERSION << 4) | MESSAGE_SNAPSHOT) || length < SNAPSHOT_HEADER_SIZE) return -1;
+
+    int cellCount = payload[0] * payload[0];
+    if (cellCount > MAX_SNAPSHOT_CELLS || length != SNAPSHOT_HEADER_SIZE + (cellCount + 3) / 4) return -1;
+
+    memset(snapshot, 0, sizeof(struct board_snapshot));
+    snapshot->size = payload[0];
+    snapshot->winLength = payload[1];
+    snapshot->gameState = payload[2];
+    for (int i = 0; i < cellCount; i++) {
+        snapshot->cells[i] = (payload[SNAPSHOT_HEADER_SIZE + i / 4] >> (6 - 2 * (i % 4))) & 3;
+    }
+
+    return MESSAGE_SNAPSHOT;
+}
+
+/*
+ * Desc: Turns an encoded coordinate back into a board index, 0xff stands for no coordinate.
+ * Params:
+ *    value - encoded coordinate
+ * Returns: the coordinate or -1
+ */
+int decodeCoordinate(uint8_t value) {
+    return value == 0xff ? -1 : value;
+}
+
+/*
+ * Desc: Copies bytes out of the ring, following the wrap around its end.
+ * Params:
+ *    buffer - buffer to copy from
+ *    position - position of the first byte
+ *    out - output of the bytes
+ *    length - number of bytes to copy
+ */
+void copyFromBuffer(struct receiveBuffer *buffer, uint32_t position, void *out, int length) {
+    uint32_t offset = position & (RECEIVE_BUFFER_SIZE - 1);
+    uint32_t space = RECEIVE_BUFFER_SIZE - offset;
+    uint32_t firstLength = space < (uint32_t) length ? space : (uint32_t) length;
+
+    memcpy(out, buffer->data + offset, firstLength);
+    memcpy((uint8_t *) out + firstLength, buffer->data, length - firstLength);
+}
@@ -0,0 +1,129 @@
+#ifndef COMMON_PROTOCOL_H
+#define COMMON_PROTOCOL_H
+
+#include <stdint.h>
+
+/*
+ * Wire protocol shared by the server and the client. Every message travels in a frame made of a one byte payload
+ * length, a one byte message type and the payload itself, so the receiver can cut frames out of a byte stream no
+ * matter how the kernel split or coalesced the reads.
+ */
+
+#define FRAME_HEADER_SIZE 2
+#define MAX_FRAME_PAYLOAD 255
+#define MAX_FRAME_SIZE (FRAME_HEADER_SIZE + MAX_FRAME_PAYLOAD)
+#define RECEIVE_BUFFER_SIZE 512 // power of two holding at least one frame of maximum size
+#define SEND_BUFFER_SIZE 1024 // power of two, bytes a peer may fall behind before it counts as a slow consumer
+
+/*
+ * Messages are versioned: the high nibble of the type byte carries the protocol version and the low nibble the
+ * message type. Payloads are packed bytes in network byte order:
+ *    join     (client) - board size, win length
+ *    move     (client) - x, y
+ *    state    (server) - game state << 4 | enemy move, then x and y of the last move (0xff if none) and a zero byte,
+ *                        or a 24-bit queue position while waiting in the lobby (game state 0)
+ *    spectate (client) - board size, win length, then the 64-bit id of the match to watch, 0 for any match of that
+ *                        variant; the two byte form without an id asks for any match as well
+ *    snapshot (server) - board size, win length, game state, then the cells in row-major order, 2 bits each (0 empty,
+ *                        1 first player, 2 second player), the first cell in the high bits of the first byte
+ *    token    (server) - 64-bit resume token, then the player the token belongs to (0 moves first, 1 second)
+ *    resume   (client) - 64-bit resume token of a match the client played before it lost its connection
+ * Spectators get a snapshot when they subscribe and whenever a match starts, then a state message per move in which
+ * the enemy move field names the player that moved (0 or 1) or, once the match is over, the winner (2 for a draw).
+ * Players get a token message right after the state message starting a match. A client sending a resume request
+ * instead of a join gets the token message and a snapshot of its match if the server kept the match, e.g. across a
+ * restart; otherwise the server closes the connection.
+ */
+#define PROTOCOL_VERSION 1
+#define MESSAGE_JOIN 1
+#define MESSAGE_MOVE 2
+#define MESSAGE_STATE 3
+#define MESSAGE_SPECTATE 4
+#define MESSAGE_SNAPSHOT 5
+#define MESSAGE_TOKEN 6
+#define MESSAGE_RESUME 7
+#define JOIN_PAYLOAD_SIZE 2
+#define MOVE_PAYLOAD_SIZE 2
+#define STATE_PAYLOAD_SIZE 4
+#define TOKEN_PAYLOAD_SIZE 9
+#define RESUME_PAYLOAD_SIZE 8
+#define SPECTATE_PAYLOAD_SIZE 10
+#define MAX_MESSAGE_SIZE (FRAME_HEADER_SIZE + SPECTATE_PAYLOAD_SIZE)
+#define MAX_QUEUE_POSITION 0xffffff
+#define SNAPSHOT_HEADER_SIZE 3
+#define MAX_SNAPSHOT_CELLS 361 // 19x19, the largest board
+#define MAX_SNAPSHOT_SIZE (FRAME_HEADER_SIZE + SNAPSHOT_HEADER_SIZE + (MAX_SNAPSHOT_CELLS + 3) / 4)
+
+#define JOIN_REQUEST 3
+#define SPECTATE_REQUEST 4
+#define RESUME_REQUEST 5
+
+/*
+ * Decoded form of every message but the snapshot. Joins decode to game state JOIN_REQUEST with the board size in x and
+ * the win length in y, spectate requests likewise to SPECTATE_REQUEST with the match id in the token, moves to game
+ * state 1 with the coordinates.
+ * Token messages carry the token and the player in x, resume requests decode to RESUME_REQUEST with the token.
+ */
+struct packet_data {
+    int gameState;
+    int enemyMove;
+    int x;
+    int y;
+    uint64_t token;
+};
+
+/*
+ * Decoded snapshot: the whole board of a match, cells in row-major order holding 0 for empty, 1 for the first player
+ * and 2 for the second player.
+ */
+struct board_snapshot {
+    int size;
+    int winLength;
+    int gameState;
+    uint8_t cells[MAX_SNAPSHOT_CELLS];
+};
+
+/*
+ * Ring buffer of received bytes that have not been decoded into frames yet. Head and tail only ever grow, their
+ * difference is the number of buffered bytes.
+ */
+struct receiveBuffer {
+    uint32_t head;
+    uint32_t tail;
+    uint8_t data[RECEIVE_BUFFER_SIZE];
+};
+
+/*
+ * Ring buffer of encoded frames that the socket did not accept yet.
+ */
+struct sendBuffer {
+    uint32_t head;
+    uint32_t tail;
+    uint8_t data[SEND_BUFFER_SIZE];
+};
+
+void initReceiveBuffer(struct receiveBuffer *buffer);
+
+int receiveIntoBuffer(int fileDescriptor, struct receiveBuffer *buffer);
+
+int takeFrame(struct receiveBuffer *buffer, int *type, void *payload, int capacity);
+
+void initSendBuffer(struct sendBuffer *buffer);
+
+int appendToBuffer(struct sendBuffer *buffer, const uint8_t *bytes, int length);
+
+int flushSendBuffer(int fileDescriptor, struct sendBuffer *buffer);
+
+int encodeFrame(uint8_t *frame, int capacity, int type, const void *payload, int length);
+
+int encodeMessage(uint8_t *frame, int capacity, int type, const struct packet_data *packet);
+
+int decodeMessage(int typeByte, const uint8_t *payload, int length, struct packet_data *packet);
+
+int receiveMessage(struct receiveBuffer *buffer, struct packet_data *packet);
+
+int encodeSnapshot(uint8_t *frame, int capacity, const struct board_snapshot *snapshot);
+
+int decodeSnapshot(int typeByte, const uint8_t *payload, int length, struct board_snapshot *snapshot);
+
+#endif
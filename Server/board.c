@@ -0,0 +1,248 @@
+#include <stdlib.h>
+#include <string.h>
+#include "common.h"
+#include "board.h"
+
+#define SMALL_BOARD_SIZE 3
+#define MAX_LINES_PER_CELL 4
+
+/*
+ * Winning lines through every cell of the 3x3 board: its row, its column and the diagonals it lies on.
+ */
+static const uint16_t winMasks[SMALL_BOARD_SIZE * SMALL_BOARD_SIZE][MAX_LINES_PER_CELL + 1] = {
+        {0007, 0111, 0421, 0},
+        {0007, 0222, 0},
+        {0007, 0444, 0124, 0},
+        {0070, 0111, 0},
+        {0070, 0222, 0421, 0124, 0},
+        {0070, 0444, 0},
+        {0700, 0111, 0124, 0},
+        {0700, 0222, 0},
+        {0700, 0444, 0421, 0}
+};
+
+int checkSmallBoard(const struct board *board, int player, int x, int y);
+
+int checkGomoku15(const struct board *board, int player, int x, int y);
+
+int checkGo19(const struct board *board, int player, int x, int y);
+
+int checkAnyBoard(const struct board *board, int player, int x, int y);
+
+/*
+ * Desc: Maps a board size and win length to a dense variant number.
+ * Params:
+ *    size - number of rows and columns
+ *    winLength - stones in a row needed to win
+ * Returns: variant number or -1 if the combination is not supported
+ */
+int variantIndex(int size, int winLength) {
+    if (size < MIN_BOARD_SIZE || size > MAX_BOARD_SIZE) return -1;
+    if (winLength < MIN_WIN_LENGTH || winLength > size) return -1;
+
+    return (size - MIN_BOARD_SIZE) * VARIANT_SIDE + winLength - MIN_BOARD_SIZE;
+}
+
+/*
+ * Desc: Recovers the board size of a variant.
+ * Params:
+ *    variant - variant number from variantIndex
+ * Returns: number of rows and columns
+ */
+int variantSize(int variant) {
+    return variant / VARIANT_SIDE + MIN_BOARD_SIZE;
+}
+
+/*
+ * Desc: Recovers the win length of a variant.
+ * Params:
+ *    variant - variant number from variantIndex
+ * Returns: stones in a row needed to win
+ */
+int variantWinLength(int variant) {
+    return variant % VARIANT_SIDE + MIN_BOARD_SIZE;
+}
+
+/*
+ * Desc: Prepares an empty board of the given variant and picks its win kernel.
+ * Params:
+ *    board - board to initialize
+ *    size - number of rows and columns
+ *    winLength - stones in a row needed to win
+ * Returns: 0 if initialized, 1 if the variant is not supported or memory could not be allocated
+ */
+int initBoard(struct board *board, int size, int winLength) {
+    memset(board, 0, sizeof(struct board));
+    if (variantIndex(size, winLength) < 0) return DEFAULT_ERROR_RETURN;
+
+    board->size = size;
+    board->winLength = winLength;
+
+    if (size == SMALL_BOARD_SIZE) {
+        board->checkWin = checkSmallBoard;
+        return DEFAULT_RETURN;
+    }
+
+    if ((board->rows = calloc(2 * size, sizeof(uint32_t))) == NULL) return DEFAULT_ERROR_RETURN;
+
+    if (size == 15 && winLength == 5) board->checkWin = checkGomoku15;
+    else if (size == 19 && winLength == 5) board->checkWin = checkGo19;
+    else board->checkWin = checkAnyBoard;
+    return DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Releases the row masks of a board.
+ * Params:
+ *    board - board to free
+ */
+void freeBoard(struct board *board) {
+    free(board->rows);
+    board->rows = NULL;
+}
+
+/*
+ * Desc: Sets board to initial state
+ * Params:
+ *    board - board to reset
+ */
+void clearBoard(struct board *board) {
+    board->stoneCount = 0;
+    board->cells[0] = 0;
+    board->cells[1] = 0;
+    if (board->rows != NULL) memset(board->rows, 0, 2 * board->size * sizeof(uint32_t));
+}
+
+/*
+ * Desc: Places a move of a player and checks only the lines through the placed cell for a win.
+ * Params:
+ *    board - board to play on
+ *    player - 0 for the player that opened the match, 1 for the other
+ *    x - row of the move
+ *    y - column of the move
+ * Returns:
+ *    MOVE_INVALID - if the cell is outside of the board, already taken or it is not the player's turn
+ *    MOVE_PLAYED - if the match continues
+ *    MOVE_WON - if the move won the match
+ *    MOVE_DRAW - if the move filled the board without a winner
+ */
+int playMove(struct board *board, int player, int x, int y) {
+    if (x < 0 || x >= board->size || y < 0 || y >= board->size) return MOVE_INVALID;
+    if (player != playerToMove(board)) return MOVE_INVALID;
+
+    if (board->rows == NULL) {
+        uint16_t bit = 1u << (x * SMALL_BOARD_SIZE + y);
+        if ((board->cells[0] | board->cells[1]) & bit) return MOVE_INVALID;
+        board->cells[player] |= bit;
+
+    } else {
+        uint32_t *rows = board->rows + player * board->size;
+        uint32_t *opponentRows = board->rows + (1 - player) * board->size;
+        uint32_t bit = 1u << y;
+        if ((rows[x] | opponentRows[x]) & bit) return MOVE_INVALID;
+        rows[x] |= bit;
+    }
+
+    board->stoneCount++;
+    if (board->checkWin(board, player, x, y)) return MOVE_WON;
+    return board->stoneCount == board->size * board->size ? MOVE_DRAW : MOVE_PLAYED;
+}
+
+/*
+ * Desc: Derives whose turn it is from the number of stones on the board; the opening player always moves first.
+ * Params:
+ *    board - current board
+ * Returns: 0 or 1, the player that has to move next
+ */
+int playerToMove(const struct board *board) {
+    return board->stoneCount & 1;
+}
+
+/*
+ * Desc: Tells which player has a stone on a cell.
+ * Params:
+ *    board - board to read
+ *    x - row of the cell
+ *    y - column of the cell
+ * Returns: 0 or 1 for the player owning the cell, -1 if the cell is empty
+ */
+int boardCell(const struct board *board, int x, int y) {
+    for (int player = 0; player < 2; player++) {
+        if (board->rows == NULL && (board->cells[player] >> (x * SMALL_BOARD_SIZE + y) & 1)) return player;
+        if (board->rows != NULL && (board->rows[player * board->size + x] >> y & 1)) return player;
+    }
+    return -1;
+}
+
+/*
+ * Desc: Win kernel of the 3x3 board: tests the precomputed lines through the placed cell against the player mask.
+ * Params:
+ *    board - board with the move already placed
+ *    player - player that moved
+ *    x - row of the move
+ *    y - column of the move
+ * Returns: 1 if the move won, 0 otherwise
+ */
+int checkSmallBoard(const struct board *board, int player, int x, int y) {
+    uint16_t stones = board->cells[player];
+
+    for (const uint16_t *mask = winMasks[x * SMALL_BOARD_SIZE + y]; *mask != 0; mask++) {
+        if ((stones & *mask) == *mask) return 1;
+    }
+    return 0;
+}
+
+/*
+ * Desc: Checks the four lines through a move of a row mask board. For each direction the cells within winLength - 1
+ *       of the move are gathered into a bit window, which holds a winning run if winLength - 1 shifted ANDs of it
+ *       leave a bit set. Inlined into kernels with constant dimensions, the loops are fully unrolled.
+ * Params:
+ *    rows - row masks of the player that moved
+ *    size - number of rows and columns
+ *    winLength - stones in a row needed to win
+ *    x - row of the move
+ *    y - column of the move
+ * Returns: 1 if the move won, 0 otherwise
+ */
+static inline __attribute__((always_inline)) int checkWindows(const uint32_t *rows, int size, int winLength,
+                                                              int x, int y) {
+    static const int directions[4][2] = {{0, 1}, {1, 0}, {1, 1}, {1, -1}};
+
+    for (int direction = 0; direction < 4; direction++) {
+        int dx = directions[direction][0];
+        int dy = directions[direction][1];
+        uint64_t window = 0;
+
+        for (int offset = 1 - winLength; offset < winLength; offset++) {
+            int row = x + offset * dx;
+            int column = y + offset * dy;
+            int taken = row >= 0 && row < size && column >= 0 && column < size && (rows[row] >> column) & 1;
+            window = window << 1 | taken;
+        }
+
+        for (int shift = 1; shift < winLength; shift++) window &= window >> 1;
+        if (window != 0) return 1;
+    }
+    return 0;
+}
+
+/*
+ * Desc: Win kernel of the 15x15 five in a row board.
+ */
+int checkGomoku15(const struct board *board, int player, int x, int y) {
+    return checkWindows(board->rows + player * 15, 15, 5, x, y);
+}
+
+/*
+ * Desc: Win kernel of the 19x19 five in a row board.
+ */
+int checkGo19(const struct board *board, int player, int x, int y) {
+    return checkWindows(board->rows + player * 19, 19, 5, x, y);
+}
+
+/*
+ * Desc: Win kernel of any other board size and win length.
+ */
+int checkAnyBoard(const struct board *board, int player, int x, int y) {
+    return checkWindows(board->rows + player * board->size, board->size, board->winLength, x, y);
+}
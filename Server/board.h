@@ -0,0 +1,56 @@
+#ifndef SERVER_BOARD_H
+#define SERVER_BOARD_H
+
+#include <stdint.h>
+
+#define MIN_BOARD_SIZE 3
+#define MAX_BOARD_SIZE 19
+#define MIN_WIN_LENGTH 3
+#define VARIANT_SIDE (MAX_BOARD_SIZE - MIN_BOARD_SIZE + 1)
+#define VARIANT_COUNT (VARIANT_SIDE * VARIANT_SIDE)
+
+#define DEFAULT_BOARD_SIZE 3
+#define DEFAULT_WIN_LENGTH 3
+
+#define MOVE_INVALID -1
+#define MOVE_PLAYED 0
+#define MOVE_WON 1
+#define MOVE_DRAW 2
+
+struct board;
+
+typedef int (*winKernel)(const struct board *board, int player, int x, int y);
+
+/*
+ * Board of size x size cells won by winLength stones in a row. The classic 3x3 board is kept as one 9-bit mask per
+ * player; larger boards use one row mask per player and row, bit y marking column y. The win check is picked once per
+ * board, so common sizes run a kernel with the board dimensions known at compile time.
+ */
+struct board {
+    uint8_t size;
+    uint8_t winLength;
+    uint16_t stoneCount;
+    uint16_t cells[2];
+    uint32_t *rows;
+    winKernel checkWin;
+};
+
+int variantIndex(int size, int winLength);
+
+int variantSize(int variant);
+
+int variantWinLength(int variant);
+
+int initBoard(struct board *board, int size, int winLength);
+
+void freeBoard(struct board *board);
+
+void clearBoard(struct board *board);
+
+int playMove(struct board *board, int player, int x, int y);
+
+int playerToMove(const struct board *board);
+
+int boardCell(const struct board *board, int x, int y);
+
+#endif
@@ -0,0 +1,150 @@
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include "common.h"
+#include "broadcast.h"
+
+/*
+ * Desc: Takes an empty broadcast without references from the pool.
+ * Params:
+ *    pool - pool of broadcasts
+ * Returns: the broadcast or NULL if memory could not be allocated
+ */
+struct broadcast *createBroadcast(struct pool *pool) {
+    struct broadcast *broadcast = poolAlloc(pool);
+    if (broadcast == NULL) return NULL;
+
+    broadcast->refCount = 0;
+    broadcast->length = 0;
+    return broadcast;
+}
+
+/*
+ * Desc: Adds a reference to a broadcast.
+ * Params:
+ *    broadcast - broadcast to keep
+ */
+void retainBroadcast(struct broadcast *broadcast) {
+    broadcast->refCount++;
+}
+
+/*
+ * Desc: Drops a reference to a broadcast and gives it back to the pool once nobody holds it anymore.
+ * Params:
+ *    pool - pool the broadcast came from
+ *    broadcast - broadcast to let go
+ */
+void releaseBroadcast(struct pool *pool, struct broadcast *broadcast) {
+    if (--broadcast->refCount <= 0) poolFree(pool, broadcast);
+}
+
+/*
+ * Desc: Appends encoded frames to a broadcast. Every feed holding it sends them, so frames may only be appended
+ *       before the feeds are flushed.
+ * Params:
+ *    broadcast - broadcast to extend
+ *    bytes - frames to append
+ *    length - number of bytes
+ * Returns: 0 if appended, -1 if the broadcast is full
+ */
+int appendToBroadcast(struct broadcast *broadcast, const uint8_t *bytes, int length) {
+    if (broadcast->length + length > BROADCAST_CAPACITY) return -1;
+
+    memcpy(broadcast->bytes + broadcast->length, bytes, length);
+    broadcast->length += length;
+    return 0;
+}
+
+/*
+ * Desc: Prepares an empty feed.
+ * Params:
+ *    feed - feed to initialize
+ */
+void initFeed(struct feed *feed) {
+    memset(feed, 0, sizeof(struct feed));
+}
+
+/*
+ * Desc: Queues a broadcast for a spectator, taking a reference to it.
+ * Params:
+ *    feed - feed of the spectator
+ *    broadcast - broadcast to queue
+ * Returns: 0 if queued, -1 if the feed is full
+ */
+int pushToFeed(struct feed *feed, struct broadcast *broadcast) {
+    if (feed->tail - feed->head == FEED_CAPACITY) return -1;
+
+    retainBroadcast(broadcast);
+    feed->broadcasts[feed->tail++ & (FEED_CAPACITY - 1)] = broadcast;
+    return 0;
+}
+
+/*
+ * Desc: Sends the queued broadcasts straight from the shared buffers, gathered into a single call, as far as the
+ *       socket accepts them without blocking. Completely sent broadcasts are released.
+ * Params:
+ *    fileDescriptor - socket of the spectator
+ *    feed - feed to flush
+ *    pool - pool the broadcasts came from
+ * Returns: number of bytes sent, -1 on error with errno set
+ */
+long flushFeed(int fileDescriptor, struct feed *feed, struct pool *pool) {
+    long totalBytes = 0;
+
+    while (feed->tail != feed->head) {
+        struct iovec segments[FEED_CAPACITY];
+        struct msghdr message;
+        int segmentCount = 0;
+        ssize_t sentBytes;
+
+        for (uint32_t position = feed->head; position != feed->tail; position++) {
+            struct broadcast *broadcast = feed->broadcasts[position & (FEED_CAPACITY - 1)];
+            int offset = position == feed->head ? feed->offset : 0;
+
+            segments[segmentCount].iov_base = broadcast->bytes + offset;
+            segments[segmentCount].iov_len = broadcast->length - offset;
+            segmentCount++;
+        }
+
+        memset(&message, 0, sizeof(struct msghdr));
+        message.msg_iov = segments;
+        message.msg_iovlen = segmentCount;
+
+        sentBytes = sendmsg(fileDescriptor, &message, MSG_NOSIGNAL);
+        if (sentBytes < 0 && errno == EINTR) continue;
+        if (sentBytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (sentBytes < 0) return -1;
+        totalBytes += sentBytes;
+
+        while (feed->tail != feed->head) {
+            struct broadcast *broadcast = feed->broadcasts[feed->head & (FEED_CAPACITY - 1)];
+            int remaining = broadcast->length - feed->offset;
+
+            if (sentBytes < remaining) {
+                feed->offset += (int) sentBytes;
+                break;
+            }
+
+            sentBytes -= remaining;
+            feed->offset = 0;
+            feed->head++;
+            releaseBroadcast(pool, broadcast);
+        }
+    }
+
+    return totalBytes;
+}
+
+/*
+ * Desc: Drops every broadcast still queued in a feed.
+ * Params:
+ *    feed - feed to empty
+ *    pool - pool the broadcasts came from
+ */
+void clearFeed(struct feed *feed, struct pool *pool) {
+    while (feed->tail != feed->head) {
+        releaseBroadcast(pool, feed->broadcasts[feed->head++ & (FEED_CAPACITY - 1)]);
+    }
+    feed->offset = 0;
+}
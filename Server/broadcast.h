@@ -0,0 +1,47 @@
+#ifndef SERVER_BROADCAST_H
+#define SERVER_BROADCAST_H
+
+#include <stdint.h>
+#include "pool.h"
+
+#define BROADCAST_CAPACITY 1024 // bytes of frames one broadcast collects
+#define FEED_CAPACITY 64 // power of two, broadcasts a spectator may fall behind before it counts as a slow consumer
+
+/*
+ * Frames encoded once and shared by every spectator they are fanned out to. Each feed holding the broadcast owns one
+ * reference; the last reference released gives it back to its pool.
+ */
+struct broadcast {
+    int refCount;
+    int length;
+    uint8_t bytes[BROADCAST_CAPACITY];
+};
+
+/*
+ * Queue of the broadcasts a spectator has not received completely yet. Offset is the number of bytes of the oldest
+ * broadcast already sent.
+ */
+struct feed {
+    uint32_t head;
+    uint32_t tail;
+    int offset;
+    struct broadcast *broadcasts[FEED_CAPACITY];
+};
+
+struct broadcast *createBroadcast(struct pool *pool);
+
+void retainBroadcast(struct broadcast *broadcast);
+
+void releaseBroadcast(struct pool *pool, struct broadcast *broadcast);
+
+int appendToBroadcast(struct broadcast *broadcast, const uint8_t *bytes, int length);
+
+void initFeed(struct feed *feed);
+
+int pushToFeed(struct feed *feed, struct broadcast *broadcast);
+
+long flushFeed(int fileDescriptor, struct feed *feed, struct pool *pool);
+
+void clearFeed(struct feed *feed, struct pool *pool);
+
+#endif
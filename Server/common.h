@@ -0,0 +1,22 @@
+#ifndef SERVER_COMMON_H
+#define SERVER_COMMON_H
+
+#include <stdint.h>
+
+#define DEFAULT_ERROR_RETURN 1
+#define DEFAULT_RETURN 0
+
+/*
+ * Byte order of the files the server writes, which unlike the wire protocol are little-endian.
+ */
+static inline void storeLittleEndian(uint8_t *bytes, uint64_t value, int length) {
+    for (int i = 0; i < length; i++) bytes[i] = (uint8_t) (value >> (8 * i));
+}
+
+static inline uint64_t loadLittleEndian(const uint8_t *bytes, int length) {
+    uint64_t value = 0;
+    for (int i = length - 1; i >= 0; i--) value = value << 8 | bytes[i];
+    return value;
+}
+
+#endif
@@ -0,0 +1,243 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "common.h"
+#include "eventLoop.h"
+#include "uring.h"
+
+int addWatch(struct eventLoop *loop, int fileDescriptor, uint32_t events);
+
+/*
+ * Desc: Creates the epoll instance or io_uring ring backing the loop.
+ * Params:
+ *    loop - loop to initialize
+ *    engine - ENGINE_EPOLL or ENGINE_URING
+ * Returns: 0 if created, 1 if error occurred
+ */
+int initEventLoop(struct eventLoop *loop, int engine) {
+    memset(loop, 0, sizeof(struct eventLoop));
+    if (engine == ENGINE_URING) return initUring(loop);
+
+    loop->epollFd = epoll_create1(EPOLL_CLOEXEC);
+    return loop->epollFd < 0 ? DEFAULT_ERROR_RETURN : DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Closes the epoll instance or io_uring ring backing the loop.
+ * Params:
+ *    loop - loop to close
+ */
+void closeEventLoop(struct eventLoop *loop) {
+    if (loop->uring != NULL) closeUring(loop);
+    if (loop->epollFd >= 0) close(loop->epollFd);
+    loop->epollFd = -1;
+}
+
+/*
+ * Desc: Registers a non-blocking listener for incoming connections.
+ * Params:
+ *    loop - loop to register with
+ *    fileDescriptor - listener to watch
+ * Returns: 0 if registered, 1 if error occurred
+ */
+int watchListener(struct eventLoop *loop, int fileDescriptor) {
+    if (loop->uring != NULL) return uringWatchListener(loop, fileDescriptor);
+    return watchDescriptor(loop, fileDescriptor);
+}
+
+/*
+ * Desc: Registers a non-blocking descriptor for edge-triggered read notifications.
+ * Params:
+ *    loop - loop to register with
+ *    fileDescriptor - descriptor to watch
+ * Returns: 0 if registered, 1 if error occurred
+ */
+int watchDescriptor(struct eventLoop *loop, int fileDescriptor) {
+    if (loop->uring != NULL) return uringWatchDescriptor(loop, fileDescriptor);
+    return addWatch(loop, fileDescriptor, EPOLLIN | EPOLLRDHUP | EPOLLET);
+}
+
+/*
+ * Desc: Registers a non-blocking client socket for edge-triggered read and write notifications. A write notification
+ *       only arrives after a send has filled the socket buffer and the peer has acknowledged some of it.
+ * Params:
+ *    loop - loop to register with
+ *    fileDescriptor - socket to watch
+ * Returns: 0 if registered, 1 if error occurred
+ */
+int watchConnection(struct eventLoop *loop, int fileDescriptor) {
+    if (loop->uring != NULL) return uringWatchConnection(loop, fileDescriptor);
+    return addWatch(loop, fileDescriptor, EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET);
+}
+
+/*
+ * Desc: Adds a descriptor to the epoll instance of the loop.
+ * Params:
+ *    loop - loop to register with
+ *    fileDescriptor - descriptor to watch
+ *    events - epoll events to watch for
+ * Returns: 0 if registered, 1 if error occurred
+ */
+int addWatch(struct eventLoop *loop, int fileDescriptor, uint32_t events) {
+    struct epoll_event event;
+    memset(&event, 0, sizeof(struct epoll_event));
+    event.events = events;
+    event.data.fd = fileDescriptor;
+
+    if (epoll_ctl(loop->epollFd, EPOLL_CTL_ADD, fileDescriptor, &event) != 0) return DEFAULT_ERROR_RETURN;
+    return DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Stops watching a descriptor. Must be called before the descriptor is closed.
+ * Params:
+ *    loop - loop the descriptor is registered with
+ *    fileDescriptor - descriptor to forget
+ */
+void unwatchDescriptor(struct eventLoop *loop, int fileDescriptor) {
+    if (loop->uring != NULL) {
+        uringUnwatch(loop, fileDescriptor);
+        return;
+    }
+    epoll_ctl(loop->epollFd, EPOLL_CTL_DEL, fileDescriptor, NULL);
+}
+
+/*
+ * Desc: Switches a descriptor to non-blocking mode, which edge-triggered notifications require.
+ * Params:
+ *    fileDescriptor - descriptor to update
+ * Returns: 0 if updated, 1 if error occurred
+ */
+int setNonBlocking(int fileDescriptor) {
+    int flags = fcntl(fileDescriptor, F_GETFL, 0);
+    if (flags < 0 || fcntl(fileDescriptor, F_SETFL, flags | O_NONBLOCK) < 0) return DEFAULT_ERROR_RETURN;
+    return DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Waits for new events unless descriptors from the previous wakeup are still waiting to be drained.
+ * Params:
+ *    loop - loop to poll
+ *    timeoutMs - maximum time to wait in milliseconds, -1 to wait until an event arrives
+ * Returns: number of ready descriptors or -1 if waiting failed
+ */
+int waitForEvents(struct eventLoop *loop, int timeoutMs) {
+    if (loop->uring != NULL) return uringWait(loop, timeoutMs);
+    if (loop->nextReady < loop->readyCount) return loop->readyCount - loop->nextReady;
+
+    int readyCount = epoll_wait(loop->epollFd, loop->events, MAX_EVENTS, timeoutMs);
+    if (readyCount < 0 && errno != EINTR) return -1;
+
+    loop->readyCount = readyCount < 0 ? 0 : readyCount;
+    loop->nextReady = 0;
+    return loop->readyCount;
+}
+
+/*
+ * Desc: Returns the descriptor that should be serviced next without waiting.
+ * Params:
+ *    loop - loop to poll
+ * Returns: ready file descriptor or -1 if every descriptor of the last wakeup has been drained
+ */
+int nextReadyDescriptor(struct eventLoop *loop) {
+    if (loop->uring != NULL) return uringNextReady(loop);
+    if (loop->nextReady >= loop->readyCount) return -1;
+    return loop->events[loop->nextReady].data.fd;
+}
+
+/*
+ * Desc: Reports which of the given events are ready on the current descriptor and clears them, so an event is seen
+ *       only once even though the descriptor stays current until it has been drained.
+ * Params:
+ *    loop - loop to query
+ *    mask - epoll events of interest
+ * Returns: the ready events of the mask
+ */
+uint32_t takeReadyEvents(struct eventLoop *loop, uint32_t mask) {
+    if (loop->nextReady >= loop->readyCount) return 0;
+
+    uint32_t ready = loop->events[loop->nextReady].events & mask;
+    loop->events[loop->nextReady].events &= ~mask;
+    return ready;
+}
+
+/*
+ * Desc: Marks the current descriptor as drained so the next call moves on to the following ready descriptor.
+ * Params:
+ *    loop - loop to update
+ */
+void markDrained(struct eventLoop *loop) {
+    if (loop->uring != NULL) {
+        uringMarkDrained(loop);
+        return;
+    }
+    loop->nextReady++;
+}
+
+/*
+ * Desc: Accepts a pending connection of the current descriptor, a listener. The accepted socket is non-blocking.
+ * Params:
+ *    loop - loop the listener is registered with
+ *    listener - listener to accept from
+ * Returns: the accepted socket or -1 with errno set, EAGAIN once no connection is pending
+ */
+int acceptConnection(struct eventLoop *loop, int listener) {
+    if (loop->uring != NULL) return uringAccept(loop);
+    return accept4(listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+}
+
+/*
+ * Desc: Reads data of the current descriptor into its receive buffer.
+ * Params:
+ *    loop - loop the connection is registered with
+ *    fileDescriptor - connection to read from
+ *    buffer - receive buffer of the connection
+ * Returns: number of bytes read, 0 if the peer closed the connection, -1 on error with errno set, EAGAIN once the
+ *          descriptor has been drained
+ */
+int receiveReady(struct eventLoop *loop, int fileDescriptor, struct receiveBuffer *buffer) {
+    if (loop->uring != NULL) return uringReceive(loop, buffer);
+    return receiveIntoBuffer(fileDescriptor, buffer);
+}
+
+/*
+ * Desc: Sends the queued bytes of a connection. The epoll engine sends right away as far as the socket accepts them;
+ *       the io_uring engine only prepares the send, which completes with a write event taken by takeSentBytes.
+ * Params:
+ *    loop - loop the connection is registered with
+ *    fileDescriptor - socket to send to
+ *    buffer - output buffer of the connection
+ * Returns: number of bytes still queued, -1 on error with errno set
+ */
+int sendQueued(struct eventLoop *loop, int fileDescriptor, struct sendBuffer *buffer) {
+    if (loop->uring != NULL) return uringSend(loop, fileDescriptor, buffer);
+    return flushSendBuffer(fileDescriptor, buffer);
+}
+
+/*
+ * Desc: Takes the result of the send completed by the write event of the current descriptor. The epoll engine sends
+ *       synchronously, so its write events only tell that the socket has space again.
+ * Params:
+ *    loop - loop to query
+ * Returns: number of bytes sent, to be removed from the output buffer, or -1 with errno set, EAGAIN if the socket
+ *          was full
+ */
+int takeSentBytes(struct eventLoop *loop) {
+    if (loop->uring != NULL) return uringTakeSent(loop);
+    return DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Asks for a write event once a socket that did not take everything has space again. Edge-triggered epoll
+ *       reports that for every connection anyway.
+ * Params:
+ *    loop - loop the socket is registered with
+ *    fileDescriptor - full socket
+ * Returns: 0 if asked, 1 if error occurred
+ */
+int waitWritable(struct eventLoop *loop, int fileDescriptor) {
+    if (loop->uring != NULL) return uringWaitWritable(loop, fileDescriptor);
+    return DEFAULT_RETURN;
+}
@@ -0,0 +1,61 @@
+#ifndef SERVER_EVENT_LOOP_H
+#define SERVER_EVENT_LOOP_H
+
+#include <sys/epoll.h>
+#include "protocol.h"
+
+#define MAX_EVENTS 256
+
+#define ENGINE_EPOLL 0
+#define ENGINE_URING 1
+
+struct uring;
+
+/*
+ * Edge-triggered epoll loop. A descriptor is reported once per readiness change, so it stays in the ready list until
+ * it has been drained (accept/recv returned EAGAIN) or closed.
+ * With the io_uring engine the ready list is filled from completions instead (see struct uring): a descriptor is
+ * reported once per completion and accepting, receiving and sending go through the loop, so both engines look the same
+ * to the workers.
+ */
+struct eventLoop {
+    int epollFd;
+    struct uring *uring;
+    int readyCount;
+    int nextReady;
+    struct epoll_event events[MAX_EVENTS];
+};
+
+int initEventLoop(struct eventLoop *loop, int engine);
+
+void closeEventLoop(struct eventLoop *loop);
+
+int watchListener(struct eventLoop *loop, int fileDescriptor);
+
+int watchDescriptor(struct eventLoop *loop, int fileDescriptor);
+
+int watchConnection(struct eventLoop *loop, int fileDescriptor);
+
+void unwatchDescriptor(struct eventLoop *loop, int fileDescriptor);
+
+int setNonBlocking(int fileDescriptor);
+
+int waitForEvents(struct eventLoop *loop, int timeoutMs);
+
+int nextReadyDescriptor(struct eventLoop *loop);
+
+uint32_t takeReadyEvents(struct eventLoop *loop, uint32_t mask);
+
+void markDrained(struct eventLoop *loop);
+
+int acceptConnection(struct eventLoop *loop, int listener);
+
+int receiveReady(struct eventLoop *loop, int fileDescriptor, struct receiveBuffer *buffer);
+
+int sendQueued(struct eventLoop *loop, int fileDescriptor, struct sendBuffer *buffer);
+
+int takeSentBytes(struct eventLoop *loop);
+
+int waitWritable(struct eventLoop *loop, int fileDescriptor);
+
+#endif
@@ -0,0 +1,151 @@
+#include <stdlib.h>
+#include <string.h>
+#include "common.h"
+#include "lobby.h"
+
+int growLobby(struct lobby *lobby);
+
+void skipLeftPlayers(struct lobby *lobby, struct roomTable *table);
+
+/*
+ * Desc: Prepares an empty lobby. Tickets start at 1, so a ticket of 0 marks a connection that is not waiting.
+ * Params:
+ *    lobby - lobby to initialize
+ *    variant - board variant the players of the lobby want to play
+ */
+void initLobby(struct lobby *lobby, int variant) {
+    memset(lobby, 0, sizeof(struct lobby));
+    lobby->variant = variant;
+    lobby->head = 1;
+    lobby->tail = 1;
+    lobby->reportedHead = 1;
+}
+
+/*
+ * Desc: Releases the ring buffer of a lobby.
+ * Params:
+ *    lobby - lobby to free
+ */
+void freeLobby(struct lobby *lobby) {
+    cancelTimer(&lobby->updateTimer);
+    cancelTimer(&lobby->opponentTimer);
+    free(lobby->entries);
+    lobby->entries = NULL;
+}
+
+/*
+ * Desc: Appends a player to the end of the queue.
+ * Params:
+ *    lobby - lobby to join
+ *    connection - connection of the waiting player
+ * Returns: ticket of the player or 0 if memory could not be allocated
+ */
+unsigned long enqueuePlayer(struct lobby *lobby, struct connection *connection) {
+    if (lobby->tail - lobby->head == lobby->capacity && growLobby(lobby) != 0) return 0;
+
+    struct lobbyEntry *entry = &lobby->entries[lobby->tail & (lobby->capacity - 1)];
+    entry->fileDescriptor = connection->fileDescriptor;
+    entry->ticket = lobby->tail;
+
+    connection->ticket = lobby->tail++;
+    lobby->waitingCount++;
+    return connection->ticket;
+}
+
+/*
+ * Desc: Removes a waiting player from the queue. The ring entry stays behind until it reaches the head, where it is
+ *       skipped right away.
+ * Params:
+ *    lobby - lobby the player waits in
+ *    connection - connection of the leaving player
+ *    table - table of registered connections
+ */
+void leaveLobby(struct lobby *lobby, struct connection *connection, struct roomTable *table) {
+    if (connection->ticket == 0) return;
+
+    connection->ticket = 0;
+    lobby->waitingCount--;
+    skipLeftPlayers(lobby, table);
+}
+
+/*
+ * Desc: Takes the player that has waited the longest out of the queue, skipping entries of players that have left.
+ * Params:
+ *    lobby - lobby to take the player from
+ *    table - table of registered connections
+ * Returns: connection of the player or NULL if nobody is waiting
+ */
+struct connection *dequeuePlayer(struct lobby *lobby, struct roomTable *table) {
+    while (lobby->head != lobby->tail) {
+        struct lobbyEntry *entry = &lobby->entries[lobby->head & (lobby->capacity - 1)];
+        struct connection *connection = findConnection(table, entry->fileDescriptor);
+        lobby->head++;
+
+        if (connection != NULL && connection->ticket == entry->ticket) {
+            connection->ticket = 0;
+            lobby->waitingCount--;
+            skipLeftPlayers(lobby, table);
+            return connection;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Desc: Advances the head of the queue past the entries of players that have left, so it always points at a waiting
+ *       player. An empty queue starts over at its tail, with nothing left to report.
+ * Params:
+ *    lobby - lobby to trim
+ *    table - table of registered connections
+ */
+void skipLeftPlayers(struct lobby *lobby, struct roomTable *table) {
+    if (lobby->waitingCount == 0) {
+        lobby->head = lobby->tail;
+        lobby->reportedHead = lobby->tail;
+        return;
+    }
+
+    while (lobby->head != lobby->tail) {
+        struct lobbyEntry *entry = &lobby->entries[lobby->head & (lobby->capacity - 1)];
+        struct connection *connection = findConnection(table, entry->fileDescriptor);
+
+        if (connection != NULL && connection->ticket == entry->ticket) return;
+        lobby->head++;
+    }
+}
+
+/*
+ * Desc: Estimates the position of a waiting player from the distance of its ticket to the head of the queue, which
+ *       always holds a waiting player. Players that left between the head and the player are still counted until
+ *       their entries reach the head.
+ * Params:
+ *    lobby - lobby the player waits in
+ *    connection - connection of the waiting player
+ * Returns: 1-based position in the queue or 0 if the player is not waiting
+ */
+int queuePosition(struct lobby *lobby, struct connection *connection) {
+    if (connection->ticket == 0) return 0;
+    return (int) (connection->ticket - lobby->head) + 1;
+}
+
+/*
+ * Desc: Doubles the ring buffer, keeping every entry at the index derived from its ticket.
+ * Params:
+ *    lobby - lobby to grow
+ * Returns: 0 if grown, 1 if memory could not be allocated
+ */
+int growLobby(struct lobby *lobby) {
+    unsigned long capacity = lobby->capacity == 0 ? INITIAL_LOBBY_CAPACITY : lobby->capacity * 2;
+    struct lobbyEntry *entries = malloc(capacity * sizeof(struct lobbyEntry));
+    if (entries == NULL) return DEFAULT_ERROR_RETURN;
+
+    for (unsigned long ticket = lobby->head; ticket != lobby->tail; ticket++) {
+        entries[ticket & (capacity - 1)] = lobby->entries[ticket & (lobby->capacity - 1)];
+    }
+
+    free(lobby->entries);
+    lobby->entries = entries;
+    lobby->capacity = capacity;
+    return DEFAULT_RETURN;
+}
@@ -0,0 +1,46 @@
+#ifndef SERVER_LOBBY_H
+#define SERVER_LOBBY_H
+
+#include "room.h"
+#include "timer.h"
+
+#define INITIAL_LOBBY_CAPACITY 64
+#define LOBBY_UPDATE_INTERVAL 1000 // milliseconds
+
+struct lobbyEntry {
+    int fileDescriptor;
+    unsigned long ticket;
+};
+
+/*
+ * FIFO of players waiting for an opponent, kept in a ring buffer indexed by ticket number. Players that leave are not
+ * removed from the ring; their entry is skipped as soon as it reaches the head because its ticket no longer matches
+ * the connection, and an empty queue starts over at its tail. Joining, leaving and pairing are amortized O(1). Every
+ * board variant has its own lobby, whose ring is allocated once the first player joins. The opponent timer pairs a
+ * player left waiting alone with the AI opponent.
+ */
+struct lobby {
+    int variant;
+    struct lobbyEntry *entries;
+    unsigned long capacity;
+    unsigned long head;
+    unsigned long tail;
+    unsigned long reportedHead;
+    int waitingCount;
+    struct timer updateTimer;
+    struct timer opponentTimer;
+};
+
+void initLobby(struct lobby *lobby, int variant);
+
+void freeLobby(struct lobby *lobby);
+
+unsigned long enqueuePlayer(struct lobby *lobby, struct connection *connection);
+
+void leaveLobby(struct lobby *lobby, struct connection *connection, struct roomTable *table);
+
+struct connection *dequeuePlayer(struct lobby *lobby, struct roomTable *table);
+
+int queuePosition(struct lobby *lobby, struct connection *connection);
+
+#endif
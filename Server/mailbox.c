@@ -0,0 +1,106 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include "common.h"
+#include "mailbox.h"
+
+/*
+ * Desc: Prepares an empty mailbox and its wakeup descriptor.
+ * Params:
+ *    mailbox - mailbox to initialize
+ * Returns: 0 if initialized, 1 if error occurred
+ */
+int initMailbox(struct mailbox *mailbox) {
+    memset(mailbox, 0, sizeof(struct mailbox));
+    pthread_mutex_init(&mailbox->lock, NULL);
+
+    mailbox->handoffs = malloc(INITIAL_MAILBOX_CAPACITY * sizeof(struct handoff));
+    mailbox->eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (mailbox->handoffs == NULL || mailbox->eventFd < 0) return DEFAULT_ERROR_RETURN;
+
+    mailbox->capacity = INITIAL_MAILBOX_CAPACITY;
+    return DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Closes a mailbox together with every connection still waiting in it.
+ * Params:
+ *    mailbox - mailbox to close
+ */
+void closeMailbox(struct mailbox *mailbox) {
+    for (int i = 0; i < mailbox->count; i++) close(mailbox->handoffs[i].fileDescriptor);
+    if (mailbox->eventFd >= 0) close(mailbox->eventFd);
+
+    free(mailbox->handoffs);
+    pthread_mutex_destroy(&mailbox->lock);
+}
+
+/*
+ * Desc: Queues a connection for the worker owning the mailbox and wakes it up.
+ * Params:
+ *    mailbox - mailbox of the receiving worker
+ *    handoff - connection to hand over
+ * Returns: 0 if queued, 1 if memory could not be allocated
+ */
+int postHandoff(struct mailbox *mailbox, struct handoff *handoff) {
+    pthread_mutex_lock(&mailbox->lock);
+
+    if (mailbox->count == mailbox->capacity) {
+        struct handoff *handoffs = realloc(mailbox->handoffs, 2 * mailbox->capacity * sizeof(struct handoff));
+        if (handoffs == NULL) {
+            pthread_mutex_unlock(&mailbox->lock);
+            return DEFAULT_ERROR_RETURN;
+        }
+
+        mailbox->handoffs = handoffs;
+        mailbox->capacity *= 2;
+    }
+
+    mailbox->handoffs[mailbox->count++] = *handoff;
+    pthread_mutex_unlock(&mailbox->lock);
+
+    wakeMailbox(mailbox);
+    return DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Takes queued connections out of the mailbox. Connections that do not fit stay queued, so the caller has to
+ *       keep taking until less than maxCount are returned.
+ * Params:
+ *    mailbox - mailbox to empty
+ *    handoffs - array to fill with the queued connections
+ *    maxCount - size of the array
+ * Returns: number of connections taken
+ */
+int takeHandoffs(struct mailbox *mailbox, struct handoff *handoffs, int maxCount) {
+    uint64_t wakeups;
+    read(mailbox->eventFd, &wakeups, sizeof(wakeups));
+
+    pthread_mutex_lock(&mailbox->lock);
+    int count = mailbox->count < maxCount ? mailbox->count : maxCount;
+
+    memcpy(handoffs, mailbox->handoffs, count * sizeof(struct handoff));
+    memmove(mailbox->handoffs, mailbox->handoffs + count, (mailbox->count - count) * sizeof(struct handoff));
+    mailbox->count -= count;
+    int remaining = mailbox->count;
+    pthread_mutex_unlock(&mailbox->lock);
+
+    // Anything left over must be signalled again, the edge-triggered loop would not report it otherwise.
+    if (remaining > 0) {
+        wakeups = 1;
+        write(mailbox->eventFd, &wakeups, sizeof(wakeups));
+    }
+    return count;
+}
+
+/*
+ * Desc: Wakes the worker owning the mailbox, e.g. to let it see that it has been stopped.
+ * Params:
+ *    mailbox - mailbox of the worker to wake
+ */
+void wakeMailbox(struct mailbox *mailbox) {
+    uint64_t wakeup = 1;
+    write(mailbox->eventFd, &wakeup, sizeof(wakeup));
+}
@@ -0,0 +1,44 @@
+#ifndef SERVER_MAILBOX_H
+#define SERVER_MAILBOX_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+#define INITIAL_MAILBOX_CAPACITY 16
+
+/*
+ * Connection handed over from one worker to another with the request it made (JOIN_REQUEST, SPECTATE_REQUEST or
+ * RESUME_REQUEST): a player joining the lobby of a variant, a spectator of a match of the receiving worker with the
+ * match id in the token, or a player resuming a recovered match of the receiving worker with its resume token.
+ */
+struct handoff {
+    int fileDescriptor;
+    int request;
+    int variant;
+    long long acceptedUs;
+    uint64_t token;
+};
+
+/*
+ * Queue of connections handed to a worker by other workers. Posting wakes the owning worker through an eventfd
+ * registered with its event loop. Only the handoff path takes the lock, never the move path.
+ */
+struct mailbox {
+    pthread_mutex_t lock;
+    int eventFd;
+    int count;
+    int capacity;
+    struct handoff *handoffs;
+};
+
+int initMailbox(struct mailbox *mailbox);
+
+void closeMailbox(struct mailbox *mailbox);
+
+int postHandoff(struct mailbox *mailbox, struct handoff *handoff);
+
+int takeHandoffs(struct mailbox *mailbox, struct handoff *handoffs, int maxCount);
+
+void wakeMailbox(struct mailbox *mailbox);
+
+#endif
@@ -4,10 +4,31 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/random.h>
+#include <sys/resource.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <errno.h>
+#include <getopt.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <time.h>
+#include "common.h"
+#include "eventLoop.h"
+#include "lobby.h"
+#include "mailbox.h"
+#include "matchLog.h"
+#include "metrics.h"
+#include "protocol.h"
+#include "recovery.h"
+#include "room.h"
+#include "solver.h"
+#include "timer.h"
+#include "trace.h"
+#include "uring.h"
 /*
  * Game states:
  *  1. Server is waiting for a client
@@ -24,190 +45,1629 @@
  *   b) If one of the clients quits, then return client to state 3
  */
 
-#define DEFAULT_ERROR_RETURN 1
-#define DEFAULT_RETURN 0
-
 #define MAX_CONNECTION_QUEUE 20
-#define MAX_SEND_RETRY_COUNT 10
-#define BOARD_SIZE 3
-#define TIME_BETWEEN_GAMES 1000
+#define TIME_BETWEEN_GAMES 1000 // milliseconds
+#define TURN_TIMEOUT 30000 // milliseconds a player may take for a move by default before forfeiting the match
+#define JOIN_TIMEOUT 10000 // milliseconds a new connection may take to send its first request before it is evicted
 
 #define NEW_CONNECTION 10
 #define NEW_DATA 20
 #define DISCONNECTED 21
 
-#define DEBUG 1
-
-struct packet_data {
-    int gameState;
-    int enemyMove;
-    int x;
-    int y;
-};
+#define MAX_BATCH_SIZE 1024
+#define MAX_WORKERS 256
+#define MAX_HANDOFFS_PER_WAKEUP 64
+#define INITIAL_DIRTY_CAPACITY 64
 
 struct received {
+    int connectionType;
     int fileDescriptor;
     int dataLength;
     struct packet_data *data;
 };
 
-struct gameState {
-    int gameState;
-    int client1;
-    int client2;
+/*
+ * Events collected from one wakeup of the event loop, processed by the game in the order they were received.
+ */
+struct eventBatch {
+    int count;
+    struct received events[MAX_BATCH_SIZE];
+    struct packet_data packets[MAX_BATCH_SIZE];
 };
 
-void prepareAddrinfoHints(struct addrinfo *info);
+struct server;
+
+/*
+ * Worker thread with its own listener, event loop and rooms. The kernel spreads incoming connections across the
+ * SO_REUSEPORT listeners of the workers and every game lives entirely on one worker, so moves never take a lock.
+ * Connections with queued output are listed as dirty and flushed once at the end of every loop iteration. The time of
+ * the last wakeup stamps everything received with it, so timing the hot path costs one clock read per wakeup. Match
+ * ids carry the worker index in their top 8 bits and count up from the start time of the server in microseconds, so
+ * they stay unique across restarts appending to the same match log. Spectators of a match id watch it through the
+ * channel of its room on the worker named by the id; every board variant has a channel as well, showing one of the
+ * worker's matches to spectators who asked for any match. With a match log, matches are recorded through the worker's
+ * log ring. With a snapshot file, the worker publishes an image of its running matches every SNAPSHOT_INTERVAL in
+ * which they changed and hands out resume tokens, which carry the worker index in their top 8 bits as well; recovered
+ * matches wait for their players in the resume table.
+ */
+struct worker {
+    int index;
+    int listener;
+    atomic_int running;
+    pthread_t thread;
+    struct server *server;
+    struct mailbox mailbox;
+    struct eventLoop loop;
+    struct roomTable rooms;
+    struct lobby lobbies[VARIANT_COUNT];
+    struct channel channels[VARIANT_COUNT];
+    struct timerWheel timers;
+    struct eventBatch *batch;
+    uint64_t *dirty;
+    int dirtyCount;
+    int dirtyCapacity;
+    long long wakeupUs;
+    unsigned long iteration;
+    int movesSinceWakeup;
+    struct logRing *logRing;
+    struct traceRing *traceRing;
+    uint64_t nextMatchId;
+    struct resumeTable resumes;
+    struct timer snapshotTimer;
+    int roomsChanged;
+    uint64_t randomState;
+    struct metrics metrics;
+};
+
+/*
+ * State shared by all workers. The only shared game state is the index of a worker with a player waiting for an
+ * opponent per board variant, so that two lone players accepted by different workers still end up in the same room.
+ * Lone players of the 3x3 board get the AI opponent after waiting aiDelayMs, unless it is -1. Running matches are
+ * saved by the recovery writer, unless it is NULL. The event loops of the workers use the engine, ENGINE_EPOLL or
+ * ENGINE_URING. Every worker traces into a ring of the tracer, the main thread into traceRing. A player who does not
+ * move within turnTimeoutMs forfeits the match, unless it is 0.
+ */
+struct server {
+    int workerCount;
+    int maxRooms;
+    int aiDelayMs;
+    int turnTimeoutMs;
+    int engine;
+    struct worker *workers;
+    struct recoveryWriter *recovery;
+    struct tracer *tracer;
+    struct traceRing *traceRing;
+    atomic_int waitingWorker[VARIANT_COUNT];
+};
+
+void prepareAddrinfoHints(struct addrinfo *info);
+
+void handleError(int errorCode, int errorType);
+
+int bindToPort(struct addrinfo *ai, int *listener, int reusePort);
+
+int parseWorkerCount(const char *text);
+
+int parseRoomLimit(const char *text);
+
+int parseAiDelay(const char *text);
+
+int parseTurnTimeout(const char *text);
+
+int parseTraceLevel(const char *text);
+
+void logMatchEvent(struct worker *worker, struct room *room, int type, int a, int b, int c);
+
+int recoverRooms(struct worker *workers, int workerCount, const char *path);
+
+int restoreRoom(struct worker *worker, struct recoveredRoom *recovered);
+
+void takeRoomSnapshot(struct timer *timer, void *context);
+
+void publishRoomSnapshot(struct worker *worker);
+
+uint64_t newResumeToken(struct worker *worker);
+
+int sendResumeToken(struct worker *worker, int fileDescriptor, uint64_t token, int player);
+
+int handleResumeRequest(struct worker *worker, struct connection *connection, uint64_t token);
+
+int handOverRequest(struct worker *worker, struct connection *connection, int owner, int request, uint64_t token);
+
+void expireResume(struct timer *timer, void *context);
+
+void closeRecoveredRoom(struct worker *worker, struct room *room);
+
+int initWorker(struct worker *worker, struct server *server, int index, int listener);
+
+void *runWorker(void *argument);
+
+void serveSignals(struct server *server);
+
+void stopWorkers(struct server *server);
+
+void dumpMetrics(struct server *server);
+
+int handOverToWaitingWorker(struct worker *worker, struct connection *connection);
+
+void publishWaitingPlayer(struct worker *worker, struct lobby *lobby);
+
+int handleHandoffs(struct worker *worker);
+
+void raiseDescriptorLimit();
+
+int handleConnections(struct worker *worker, int timeoutMs);
+
+struct received *nextBatchEvent(struct eventBatch *batch);
+
+int handleNewConnection(struct worker *worker);
+
+int handleExistingConnection(struct worker *worker, int incomingFd, struct received *data);
+
+int sendData(struct worker *worker, int fileDescriptor, struct packet_data *data);
+
+int queueFrame(struct worker *worker, struct connection *connection, const uint8_t *frame, int frameLength);
+
+int flushConnection(struct worker *worker, struct connection *connection);
+
+void completeSend(struct worker *worker, struct connection *connection);
+
+void markDirty(struct worker *worker, struct connection *connection);
+
+void flushDirtyConnections(struct worker *worker);
+
+void dropConnection(struct connection *connection);
+
+int executeGame(int connection_type, struct received *receivedData, struct worker *worker);
+
+int joinLobby(struct worker *worker, struct connection *connection);
+
+int handleJoinRequest(struct worker *worker, struct connection *connection, struct received *receivedData);
+
+int handleSpectateRequest(struct worker *worker, struct connection *connection, int variant, uint64_t matchId);
+
+struct room *findMatch(struct worker *worker, uint64_t matchId);
+
+struct channel *variantChannel(struct worker *worker, struct room *room);
+
+int isWatched(struct worker *worker, struct room *room);
+
+int encodeRoomSnapshot(struct room *room, uint8_t *frame, int capacity);
+
+void showMatchStart(struct worker *worker, struct room *room);
+
+void broadcastToSpectators(struct worker *worker, struct room *room, const uint8_t *frame, int frameLength);
+
+void broadcastToChannel(struct worker *worker, struct channel *channel, const uint8_t *frame, int frameLength);
+
+void broadcastState(struct worker *worker, struct room *room, int gameState, int player, int x, int y);
+
+void closeChannels(struct worker *worker, struct room *room);
+
+int matchPlayers(struct worker *worker, struct lobby *lobby);
+
+int matchWithAi(struct worker *worker, struct lobby *lobby);
+
+void offerAiOpponent(struct timer *timer, void *context);
+
+int playAiMove(struct worker *worker, struct room *room);
+
+void matchWaitingLobbies(struct worker *worker);
+
+int sendQueuePosition(struct worker *worker, int fileDescriptor, int position);
+
+void updateQueuePositions(struct timer *timer, void *context);
+
+int addPlayer(struct received *receivedData, struct room *room);
+
+int handlePlayerDisconnect(struct worker *worker, struct room *room, struct received *receivedData);
+
+int handleGameSequence(struct worker *worker, struct room *room, struct received *receivedData);
+
+int handleNewPlayer(struct worker *worker, struct room *room, struct received *receivedData);
+
+void resetGame(struct timer *timer, void *context);
+
+void startTurn(struct worker *worker, struct room *room);
+
+void forfeitTurn(struct timer *timer, void *context);
+
+void evictIdleConnection(struct timer *timer, void *context);
+
+int main(int argc, char *argv[]) {
+
+    int option, workerCount, maxRooms, aiDelayMs, turnTimeoutMs, engine, traceLevel;
+    char *hostPort, *logPath, *snapshotPath;
+    struct matchLog matchLog;
+    struct recoveryWriter recovery;
+    struct tracer tracer;
+    struct addrinfo hints, *addrInfo;
+    struct worker *workers;
+    struct server server;
+    sigset_t signals;
+
+    workerCount = 1;
+    maxRooms = INT_MAX;
+    aiDelayMs = -1;
+    turnTimeoutMs = TURN_TIMEOUT;
+    logPath = NULL;
+    snapshotPath = NULL;
+    engine = ENGINE_EPOLL;
+    traceLevel = TRACE_INFO;
+    raiseDescriptorLimit();
+    prepareAddrinfoHints(&hints);
+
+    while ((option = getopt(argc, argv, "w:r:a:t:l:s:uv:")) != -1) {
+        if (option == 'w' && (workerCount = parseWorkerCount(optarg)) > 0) continue;
+        if (option == 'r' && (maxRooms = parseRoomLimit(optarg)) > 0) continue;
+        if (option == 'a' && (aiDelayMs = parseAiDelay(optarg)) >= 0) continue;
+        if (option == 't' && (turnTimeoutMs = parseTurnTimeout(optarg)) >= 0) continue;
+        if (option == 'l' && *(logPath = optarg) != 0) continue;
+        if (option == 's' && *(snapshotPath = optarg) != 0) continue;
+        if (option == 'v' && (traceLevel = parseTraceLevel(optarg)) >= 0) continue;
+        if (option == 'u') {
+            engine = ENGINE_URING;
+            continue;
+        }
+
+        handleError(EINVAL, 10);
+        return DEFAULT_ERROR_RETURN;
+    }
+
+    if (optind >= argc) {
+        handleError(errno, 1);
+        return DEFAULT_ERROR_RETURN;
+    } else {
+        hostPort = argv[optind];
+    }
+
+    if (getaddrinfo(NULL, hostPort, &hints, &addrInfo) != 0) {
+        handleError(errno, 2);
+        return DEFAULT_ERROR_RETURN;
+    }
+
+    if ((workers = calloc(workerCount, sizeof(struct worker))) == NULL ||
+        openTracer(&tracer, workerCount + 1, traceLevel, stdout) != 0) {
+        handleError(errno, 8);
+        return DEFAULT_ERROR_RETURN;
+    }
+
+    server.workerCount = workerCount;
+    server.maxRooms = maxRooms;
+    server.aiDelayMs = aiDelayMs;
+    server.turnTimeoutMs = turnTimeoutMs;
+    server.tracer = &tracer;
+    server.traceRing = &tracer.rings[workerCount];
+    server.engine = engine;
+    if (engine == ENGINE_URING && probeUring() != 0) {
+        printf("io_uring is not available, falling back to epoll.\n");
+        server.engine = ENGINE_EPOLL;
+    }
+    if (aiDelayMs >= 0) initSolver();
+    server.workers = workers;
+    server.recovery = snapshotPath != NULL ? &recovery : NULL;
+    for (int i = 0; i < VARIANT_COUNT; i++) atomic_init(&server.waitingWorker[i], -1);
+
+    if (snapshotPath != NULL && openRecoveryWriter(&recovery, snapshotPath, workerCount) != 0) {
+        handleError(errno, 8);
+        return DEFAULT_ERROR_RETURN;
+    }
+
+    if (logPath != NULL && openMatchLog(&matchLog, logPath, workerCount) != 0) {
+        handleError(errno, 14);
+        return DEFAULT_ERROR_RETURN;
+    }
+
+    for (int i = 0; i < workerCount; i++) {
+        int listener;
+
+        if ((bindToPort(addrInfo, &listener, workerCount > 1)) != 0) {
+            handleError(errno, 3);
+            return DEFAULT_ERROR_RETURN;
+        }
+
+        if (listen(listener, MAX_CONNECTION_QUEUE) != 0) {
+            handleError(errno, 4);
+            return DEFAULT_ERROR_RETURN;
+        }
+
+        if (initWorker(&workers[i], &server, i, listener) != 0) return DEFAULT_ERROR_RETURN;
+        if (logPath != NULL) workers[i].logRing = &matchLog.rings[i];
+        workers[i].traceRing = &tracer.rings[i];
+    }
+
+    freeaddrinfo(addrInfo);
+
+    if (snapshotPath != NULL && recoverRooms(workers, workerCount, snapshotPath) != 0) {
+        handleError(errno, 15);
+        return DEFAULT_ERROR_RETURN;
+    }
+
+    // Workers inherit the blocked signal mask, so SIGUSR1, SIGUSR2, SIGINT and SIGTERM are only ever taken by the
+    // sigwait of the main thread.
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGUSR1);
+    sigaddset(&signals, SIGUSR2);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+    int error = startTracer(&tracer);
+    if (error == 0 && logPath != NULL) error = startMatchLog(&matchLog);
+    if (error == 0 && snapshotPath != NULL) error = startRecoveryWriter(&recovery);
+    if (error != 0) {
+        handleError(error, 11);
+        return DEFAULT_ERROR_RETURN;
+    }
+
+    for (int i = 0; i < workerCount; i++) {
+        int error = pthread_create(&workers[i].thread, NULL, runWorker, &workers[i]);
+        if (error != 0) {
+            handleError(error, 11);
+            return DEFAULT_ERROR_RETURN;
+        }
+    }
+
+    serveSignals(&server);
+    for (int i = 0; i < workerCount; i++) pthread_join(workers[i].thread, NULL);
+    for (int i = 0; i < workerCount; i++) closeMailbox(&workers[i].mailbox);
+
+    if (logPath != NULL) closeMatchLog(&matchLog);
+    if (snapshotPath != NULL) closeRecoveryWriter(&recovery);
+    closeTracer(&tracer);
+    free(workers);
+    return DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Parses the number of worker threads given on the command line.
+ * Params:
+ *    text - number of workers, 0 to start one worker per online CPU
+ * Returns: number of workers to start or -1 if the number is invalid
+ */
+int parseWorkerCount(const char *text) {
+    char *end;
+    long count = strtol(text, &end, 10);
+
+    if (*text == 0 || *end != 0 || count < 0 || count > MAX_WORKERS) return -1;
+    if (count == 0) count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 && count <= MAX_WORKERS ? (int) count : -1;
+}
+
+/*
+ * Desc: Parses the maximum number of rooms per worker given on the command line.
+ * Params:
+ *    text - maximum number of rooms, 0 for no limit
+ * Returns: maximum number of rooms or -1 if the number is invalid
+ */
+int parseRoomLimit(const char *text) {
+    char *end;
+    long limit = strtol(text, &end, 10);
+
+    if (*text == 0 || *end != 0 || limit < 0 || limit > INT_MAX) return -1;
+    return limit == 0 ? INT_MAX : (int) limit;
+}
+
+/*
+ * Desc: Parses how long a lone 3x3 player waits before playing against the AI opponent.
+ * Params:
+ *    text - delay in milliseconds, 0 to start the game against the AI right away
+ * Returns: delay in milliseconds or -1 if the number is invalid
+ */
+int parseAiDelay(const char *text) {
+    char *end;
+    long delay = strtol(text, &end, 10);
+
+    if (*text == 0 || *end != 0 || delay < 0 || delay > INT_MAX) return -1;
+    return (int) delay;
+}
+
+/*
+ * Desc: Parses how long a player may take for a move before forfeiting the match.
+ * Params:
+ *    text - timeout in milliseconds, 0 to let players take as long as they want
+ * Returns: timeout in milliseconds or -1 if the number is invalid
+ */
+int parseTurnTimeout(const char *text) {
+    char *end;
+    long timeout = strtol(text, &end, 10);
+
+    if (*text == 0 || *end != 0 || timeout < 0 || timeout > INT_MAX) return -1;
+    return (int) timeout;
+}
+
+/*
+ * Desc: Parses the trace level given on the command line.
+ * Params:
+ *    text - TRACE_OFF (0), TRACE_INFO (1) or TRACE_DEBUG (2)
+ * Returns: trace level or -1 if the level is invalid
+ */
+int parseTraceLevel(const char *text) {
+    char *end;
+    long level = strtol(text, &end, 10);
+
+    if (*text == 0 || *end != 0 || level < TRACE_OFF || level > TRACE_DEBUG) return -1;
+    return (int) level;
+}
+
+/*
+ * Desc: Queues a record of a match for the match log, if the server keeps one. A record that does not fit into the
+ *       ring of the worker is dropped and counted rather than waiting for the writer.
+ * Params:
+ *    worker - worker owning the room
+ *    room - room of the match
+ *    type - MATCH_LOG_START, MATCH_LOG_MOVE or MATCH_LOG_RESULT
+ *    a, b, c - fields of the record, see struct logRecord
+ */
+void logMatchEvent(struct worker *worker, struct room *room, int type, int a, int b, int c) {
+    if (worker->logRing == NULL) return;
+
+    if (appendLogRecord(worker->logRing, room->matchId, worker->wakeupUs, type, a, b, c) != 0) {
+        countMetric(&worker->metrics, METRIC_LOG_RECORDS_DROPPED, 1);
+    }
+}
+
+/*
+ * Desc: Reopens the matches saved in the snapshot file before the workers start. A match goes to the worker its id
+ *       names, or to the worker with that index modulo the number of workers if the server runs fewer workers now,
+ *       and waits there RESUME_TIMEOUT for its players to reconnect with their resume tokens.
+ * Params:
+ *    workers - all workers, not running yet
+ *    workerCount - number of workers
+ *    path - path of the snapshot file
+ * Returns: 0 if recovered, 1 if the snapshot can not be read
+ */
+int recoverRooms(struct worker *workers, int workerCount, const char *path) {
+    struct recoveredRoom *recovered;
+    int roomCount, restored = 0, solverReady = workers[0].server->aiDelayMs >= 0;
+    int *counts = calloc(workerCount, sizeof(int));
+
+    if (counts == NULL || readRecoveryFile(path, &recovered, &roomCount) != 0) {
+        free(counts);
+        return DEFAULT_ERROR_RETURN;
+    }
+
+    for (int i = 0; i < roomCount; i++) counts[(recovered[i].matchId >> 56) % workerCount]++;
+    for (int i = 0; i < workerCount; i++) {
+        freeResumeTable(&workers[i].resumes);
+        if (initResumeTable(&workers[i].resumes, 2 * counts[i]) != 0) {
+            free(counts);
+            free(recovered);
+            return DEFAULT_ERROR_RETURN;
+        }
+    }
+
+    for (int i = 0; i < roomCount; i++) {
+        // Recovered matches against the AI need the solver even if lone players do not get the AI anymore.
+        if (recovered[i].aiOpponent && !solverReady) {
+            initSolver();
+            solverReady = 1;
+        }
+        restored += restoreRoom(&workers[(recovered[i].matchId >> 56) % workerCount], &recovered[i]) == 0;
+    }
+
+    traceEvent(workers->server->traceRing, TRACE_INFO, "Recovered %d of %d matches from the snapshot.\n", restored,
+               roomCount, 0);
+    free(counts);
+    free(recovered);
+    return DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Opens a room for a recovered match with its board, match id and resume tokens. Both seats wait for their
+ *       players, except the seat of the AI opponent.
+ * Params:
+ *    worker - worker the match goes to
+ *    recovered - match read from the snapshot
+ * Returns: 0 if restored, 1 if the room can not be created or the board is not a running match
+ */
+int restoreRoom(struct worker *worker, struct recoveredRoom *recovered) {
+    struct room *room = createRoom(&worker->rooms, variantIndex(recovered->size, recovered->winLength));
+    if (room == NULL) return DEFAULT_ERROR_RETURN;
+
+    if (restoreBoard(&room->board, recovered) != 0 || recovered->tokens[0] == 0) {
+        destroyRoom(&worker->rooms, room);
+        return DEFAULT_ERROR_RETURN;
+    }
+
+    room->gameState = 1;
+    room->client1 = RESUME_PENDING;
+    room->client2 = recovered->aiOpponent ? AI_OPPONENT : RESUME_PENDING;
+    room->startedUs = monotonicUs();
+    room->matchId = recovered->matchId;
+    room->tokens[0] = recovered->tokens[0];
+    room->tokens[1] = recovered->aiOpponent ? 0 : recovered->tokens[1];
+
+    for (int player = 0; player < 2; player++) {
+        if (room->tokens[player] != 0) addResumeToken(&worker->resumes, room->tokens[player], poolHandle(room));
+    }
+
+    scheduleTimer(&worker->timers, &room->cooldownTimer, RESUME_TIMEOUT, expireResume);
+    worker->roomsChanged = 1;
+    return DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Publishes an image of the running matches of the worker every SNAPSHOT_INTERVAL. Called by the snapshot timer
+ *       of the worker.
+ * Params:
+ *    timer - snapshot timer of the worker
+ *    context - the worker
+ */
+void takeRoomSnapshot(struct timer *timer, void *context) {
+    struct worker *worker = context;
+
+    scheduleTimer(&worker->timers, timer, SNAPSHOT_INTERVAL, takeRoomSnapshot);
+    publishRoomSnapshot(worker);
+}
+
+/*
+ * Desc: Publishes an image of the running matches of the worker to the recovery writer, if any match started,
+ *       changed or ended since the previous image. Copying the rooms between two batches keeps the image consistent
+ *       without ever stopping the worker for disk I/O.
+ * Params:
+ *    worker - worker whose matches are saved
+ */
+void publishRoomSnapshot(struct worker *worker) {
+    struct recoveryImage *image;
+
+    if (!worker->roomsChanged || (image = createRecoveryImage()) == NULL) return;
+
+    for (struct room *room = worker->rooms.roomList; room != NULL; room = room->nextRoom) {
+        if (room->gameState != 1) continue;
+
+        if (appendRoomImage(image, room, room->client2 == AI_OPPONENT) != 0) {
+            destroyRecoveryImage(image);
+            return;
+        }
+    }
+
+    publishRecoveryImage(worker->server->recovery, worker->index, image);
+    worker->roomsChanged = 0;
+}
+
+/*
+ * Desc: Draws a resume token: the index of the worker in the top 8 bits and 56 random bits, never 0.
+ * Params:
+ *    worker - worker owning the match
+ * Returns: the token
+ */
+uint64_t newResumeToken(struct worker *worker) {
+    uint64_t random = worker->randomState += 0x9e3779b97f4a7c15ULL;
+
+    random = (random ^ (random >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    random = (random ^ (random >> 27)) * 0x94d049bb133111ebULL;
+    random = (random ^ (random >> 31)) & (((uint64_t) 1 << 56) - 1);
+    return (uint64_t) worker->index << 56 | (random == 0 ? 1 : random);
+}
+
+/*
+ * Desc: Tells a player the resume token of its seat.
+ * Params:
+ *    worker - worker owning the connection
+ *    fileDescriptor - file descriptor of the player, nothing is sent to the AI opponent
+ *    token - resume token of the seat
+ *    player - seat of the player, 0 or 1
+ * Returns: 0 if queued, -1 if error
+ */
+int sendResumeToken(struct worker *worker, int fileDescriptor, uint64_t token, int player) {
+    struct connection *connection = findConnection(&worker->rooms, fileDescriptor);
+    uint8_t frame[MAX_MESSAGE_SIZE];
+    struct packet_data data;
+
+    if (fileDescriptor < 0) return DEFAULT_RETURN;
+    if (connection == NULL) return -1;
+
+    memset(&data, 0, sizeof(struct packet_data));
+    data.token = token;
+    data.x = player;
+    return queueFrame(worker, connection, frame, encodeMessage(frame, sizeof(frame), MESSAGE_TOKEN, &data));
+}
+
+/*
+ * Desc: Seats a reconnecting player in the recovered match its resume token belongs to and sends it the token and a
+ *       snapshot of the board. Tokens of another worker's matches are handed over to that worker. A player with an
+ *       unknown or already used token is disconnected.
+ * Params:
+ *    worker - worker owning the connection
+ *    connection - connection that has not joined yet
+ *    token - resume token sent by the player
+ * Returns: -1 on error, 0 otherwise
+ */
+int handleResumeRequest(struct worker *worker, struct connection *connection, uint64_t token) {
+    int owner = (int) ((token >> 56) % (uint64_t) worker->server->workerCount);
+    int fileDescriptor = connection->fileDescriptor, player = -1;
+    uint8_t frame[MAX_SNAPSHOT_SIZE];
+    struct room *room;
+
+    if (owner != worker->index) return handOverRequest(worker, connection, owner, RESUME_REQUEST, token);
+
+    room = poolResolve(&worker->rooms.roomPool, claimResumeToken(&worker->resumes, token));
+    if (room != NULL && room->gameState == 1 && room->tokens[0] == token && room->client1 == RESUME_PENDING) {
+        player = 0;
+    } else if (room != NULL && room->gameState == 1 && room->tokens[1] == token && room->client2 == RESUME_PENDING) {
+        player = 1;
+    }
+
+    if (player < 0) {
+        traceEvent(worker->traceRing, TRACE_INFO, "Rejected an unknown resume token.\n", 0, 0, 0);
+        dropConnection(connection);
+        return DEFAULT_ERROR_RETURN;
+    }
+
+    if (player == 0) room->client1 = fileDescriptor;
+    else room->client2 = fileDescriptor;
+    connection->variant = variantIndex(room->board.size, room->board.winLength);
+    attachToRoom(&worker->rooms, fileDescriptor, room);
+    if (room->client1 != RESUME_PENDING && room->client2 != RESUME_PENDING) {
+        cancelTimer(&room->cooldownTimer);
+        startTurn(worker, room);
+    }
+    traceEvent(worker->traceRing, TRACE_INFO, "Player #%d resumed a recovered match.\n", player + 1, 0, 0);
+
+    if (sendResumeToken(worker, fileDescriptor, token, player) != 0) return DEFAULT_ERROR_RETURN;
+    return queueFrame(worker, connection, frame, encodeRoomSnapshot(room, frame, sizeof(frame))) == -1
+           ? DEFAULT_ERROR_RETURN : DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Hands a reconnecting player or a spectator over to the worker owning the match its token or match id belongs
+ *       to. The caller has to forget the connection once it has been handed over.
+ * Params:
+ *    worker - worker owning the connection
+ *    connection - connection of the reconnecting player or the spectator
+ *    owner - index of the worker owning the match
+ *    request - RESUME_REQUEST or SPECTATE_REQUEST
+ *    token - resume token or match id sent by the client
+ * Returns: 0 if handed over, -1 if the connection was dropped instead
+ */
+int handOverRequest(struct worker *worker, struct connection *connection, int owner, int request, uint64_t token) {
+    int fileDescriptor = connection->fileDescriptor;
+    struct handoff handoff;
+
+    handoff.fileDescriptor = fileDescriptor;
+    handoff.request = request;
+    handoff.variant = connection->variant;
+    handoff.acceptedUs = connection->acceptedUs;
+    handoff.token = token;
+    unwatchDescriptor(&worker->loop, fileDescriptor);
+
+    if (postHandoff(&worker->server->workers[owner].mailbox, &handoff) != 0) {
+        watchConnection(&worker->loop, fileDescriptor);
+        dropConnection(connection);
+        return -1;
+    }
+
+    destroyConnection(&worker->rooms, fileDescriptor);
+    return DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Gives up on the players of a recovered match that did not reconnect in time. Called by the cooldown timer of
+ *       the room RESUME_TIMEOUT after the recovery.
+ * Params:
+ *    timer - cooldown timer of the room
+ *    context - worker owning the room
+ */
+void expireResume(struct timer *timer, void *context) {
+    closeRecoveredRoom(context, containerOf(timer, struct room, cooldownTimer));
+}
+
+/*
+ * Desc: Closes a recovered room in which a seat is still waiting for its player, as if that player had left. A player
+ *       who did reconnect goes back to the lobby.
+ * Params:
+ *    worker - worker owning the room
+ *    room - recovered room
+ */
+void closeRecoveredRoom(struct worker *worker, struct room *room) {
+    struct roomTable *rooms = &worker->rooms;
+    int remainingClient = room->client1 > 0 ? room->client1 : room->client2 > 0 ? room->client2 : 0;
+
+    if (room->gameState == 1) {
+        logMatchEvent(worker, room, MATCH_LOG_RESULT, MATCH_RESULT_ABANDONED, room->client1 != RESUME_PENDING, 0);
+    }
+
+    closeChannels(worker, room);
+    destroyRoom(rooms, room);
+    countMetric(&worker->metrics, METRIC_ROOMS_CLOSED, 1);
+    worker->roomsChanged = 1;
+    traceEvent(worker->traceRing, TRACE_INFO, "Closed a recovered match.\n", 0, 0, 0);
+    if (rooms->roomCount == worker->server->maxRooms - 1) matchWaitingLobbies(worker);
+    if (remainingClient > 0) joinLobby(worker, findConnection(rooms, remainingClient));
+}
+
+/*
+ * Desc: Prepares a worker and registers its listener with its event loop.
+ * Params:
+ *    worker - worker to initialize
+ *    server - state shared by all workers
+ *    index - index of the worker
+ *    listener - listening socket owned by the worker
+ * Returns: 0 if initialized, 1 if error occurred
+ */
+int initWorker(struct worker *worker, struct server *server, int index, int listener) {
+    worker->server = server;
+    worker->index = index;
+    worker->listener = listener;
+    atomic_init(&worker->running, 1);
+    worker->nextMatchId = (uint64_t) index << 56 | (uint64_t) time(NULL) * 1000000;
+    if (getrandom(&worker->randomState, sizeof(uint64_t), 0) != sizeof(uint64_t)) {
+        worker->randomState = (uint64_t) time(NULL) ^ (uint64_t) index << 32;
+    }
+    initTimerWheel(&worker->timers);
+
+    for (int i = 0; i < VARIANT_COUNT; i++) initLobby(&worker->lobbies[i], i);
+
+    if ((worker->batch = calloc(1, sizeof(struct eventBatch))) == NULL || initRoomTable(&worker->rooms) != 0 ||
+        initResumeTable(&worker->resumes, 0) != 0) {
+        handleError(errno, 8);
+        return DEFAULT_ERROR_RETURN;
+    }
+
+    if (server->recovery != NULL) scheduleTimer(&worker->timers, &worker->snapshotTimer, SNAPSHOT_INTERVAL,
+                                                takeRoomSnapshot);
+
+    if (initEventLoop(&worker->loop, server->engine) != 0 || setNonBlocking(listener) != 0 ||
+        watchListener(&worker->loop, listener) != 0 || initMailbox(&worker->mailbox) != 0 ||
+        watchDescriptor(&worker->loop, worker->mailbox.eventFd) != 0) {
+        handleError(errno, 9);
+        return DEFAULT_ERROR_RETURN;
+    }
+
+    return DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Event loop of a worker thread: handles connections of its listener, runs the games of its rooms, fires its
+ *       timers and flushes the output gathered meanwhile until the worker is stopped.
+ * Params:
+ *    argument - the worker to run
+ * Returns: NULL
+ */
+void *runWorker(void *argument) {
+    struct worker *worker = argument;
+    struct eventBatch *batch = worker->batch;
+    int eventCount;
+
+    while (atomic_load_explicit(&worker->running, memory_order_relaxed)) {
+        eventCount = handleConnections(worker, nextTimerTimeout(&worker->timers));
+        worker->iteration++;
+
+        for (int i = 0; i < eventCount; i++) {
+            struct received *event = &batch->events[i];
+            int owned = findConnection(&worker->rooms, event->fileDescriptor) != NULL;
+            executeGame(event->connectionType, event, worker);
+
+            // Closing is deferred until the game has seen the disconnect, so the descriptor can not be reused by a
+            // connection accepted within the same batch. A connection handed over to another worker earlier in the
+            // batch is not ours to close anymore; its new owner sees the disconnect itself.
+            if (event->connectionType == DISCONNECTED && owned) {
+                close(event->fileDescriptor);
+                countMetric(&worker->metrics, METRIC_CONNECTIONS_CLOSED, 1);
+            }
+        }
+
+        runExpiredTimers(&worker->timers, worker);
+        flushDirtyConnections(worker);
+
+        if (worker->movesSinceWakeup > 0) {
+            recordValue(&worker->metrics, METRIC_MOVE_LATENCY, monotonicUs() - worker->wakeupUs,
+                        worker->movesSinceWakeup);
+            worker->movesSinceWakeup = 0;
+        }
+        traceEvent(worker->traceRing, TRACE_DEBUG, "Events: %d, rooms: %d\n", eventCount, worker->rooms.roomCount, 0);
+    }
+
+    // The last image is saved by the recovery writer when it is closed, so a clean stop loses no moves.
+    if (worker->server->recovery != NULL) publishRoomSnapshot(worker);
+
+    // The mailbox stays open until every worker has stopped, as the others may still hand connections over to it.
+    closeEventLoop(&worker->loop);
+    close(worker->listener);
+    for (int i = 0; i < VARIANT_COUNT; i++) freeLobby(&worker->lobbies[i]);
+    freeRoomTable(&worker->rooms);
+    freeResumeTable(&worker->resumes);
+    free(worker->batch);
+    free(worker->dirty);
+    return NULL;
+}
+
+/*
+ * Desc: Waits for signals on the main thread: SIGUSR1 prints the metrics of all workers every time it arrives, e.g.
+ *       after kill -USR1 <pid>, and SIGUSR2 moves the trace level on to the next one, from TRACE_DEBUG back to
+ *       TRACE_OFF. SIGINT or SIGTERM stops the workers and returns, so the match log and the snapshot file are closed
+ *       cleanly. The workers never see the signals, so the hot path pays nothing for them.
+ * Params:
+ *    server - server whose workers are reported
+ */
+void serveSignals(struct server *server) {
+    sigset_t signals;
+    int signal;
+
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGUSR1);
+    sigaddset(&signals, SIGUSR2);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+
+    while (sigwait(&signals, &signal) == 0) {
+        if (signal == SIGUSR1) dumpMetrics(server);
+        if (signal == SIGUSR2) {
+            int level = (atomic_load(&server->tracer->level) + 1) % (TRACE_DEBUG + 1);
+            setTraceLevel(server->tracer, level);
+            traceEvent(server->traceRing, TRACE_OFF, "Trace level %d\n", level, 0, 0);
+        }
+        if (signal == SIGINT || signal == SIGTERM) {
+            traceEvent(server->traceRing, TRACE_INFO, "Shutting down.\n", 0, 0, 0);
+            stopWorkers(server);
+            return;
+        }
+    }
+}
+
+/*
+ * Desc: Tells every worker to stop and wakes it through its mailbox, so it leaves its event loop after the current
+ *       iteration.
+ * Params:
+ *    server - server whose workers are stopped
+ */
+void stopWorkers(struct server *server) {
+    for (int i = 0; i < server->workerCount; i++) {
+        atomic_store_explicit(&server->workers[i].running, 0, memory_order_relaxed);
+        wakeMailbox(&server->workers[i].mailbox);
+    }
+}
+
+/*
+ * Desc: Sums up the counters and histograms of all workers and prints them.
+ * Params:
+ *    server - server whose workers are reported
+ */
+void dumpMetrics(struct server *server) {
+    struct metrics *snapshot = calloc(1, sizeof(struct metrics));
+    if (snapshot == NULL) return;
+
+    for (int i = 0; i < server->workerCount; i++) mergeMetrics(snapshot, &server->workers[i].metrics);
+
+    printf("workers %d\n", server->workerCount);
+    printMetrics(snapshot, stdout);
+    free(snapshot);
+}
+
+/*
+ * Desc: Hands a connection that would have to wait for an opponent over to the worker that already has a player
+ *       waiting for the same variant. The waiting slot is claimed first, so two workers never hand their players to
+ *       each other. A connection with unparsed input is kept, as the handoff only carries its descriptor. The caller
+ *       has to forget the connection once it has been handed over.
+ * Params:
+ *    worker - worker owning the connection
+ *    connection - connection of the joining player
+ * Returns: 0 if handed over, 1 if the connection stays with the worker
+ */
+int handOverToWaitingWorker(struct worker *worker, struct connection *connection) {
+    struct server *server = worker->server;
+    atomic_int *waitingSlot = &server->waitingWorker[connection->variant];
+    int waitingWorker = atomic_load_explicit(waitingSlot, memory_order_acquire);
+
+    // Bytes already read from the socket would be lost with the descriptor, so such a player waits here instead.
+    if (connection->input.tail != connection->input.head) return DEFAULT_ERROR_RETURN;
+    if (waitingWorker < 0 || waitingWorker == worker->index) return DEFAULT_ERROR_RETURN;
+    if (!atomic_compare_exchange_strong(waitingSlot, &waitingWorker, -1)) return DEFAULT_ERROR_RETURN;
+
+    struct handoff handoff;
+    handoff.fileDescriptor = connection->fileDescriptor;
+    handoff.request = JOIN_REQUEST;
+    handoff.variant = connection->variant;
+    handoff.acceptedUs = connection->acceptedUs;
+    handoff.token = 0;
+    unwatchDescriptor(&worker->loop, connection->fileDescriptor);
+
+    if (postHandoff(&server->workers[waitingWorker].mailbox, &handoff) != 0) {
+        watchConnection(&worker->loop, connection->fileDescriptor);
+        return DEFAULT_ERROR_RETURN;
+    }
+
+    traceEvent(worker->traceRing, TRACE_INFO, "Handed a player to worker %d\n", waitingWorker, 0, 0);
+    return DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Advertises to other workers whether this worker has a player waiting for an opponent of the lobby variant and a
+ *       free room for them.
+ * Params:
+ *    worker - worker to advertise
+ *    lobby - lobby that changed
+ */
+void publishWaitingPlayer(struct worker *worker, struct lobby *lobby) {
+    struct server *server = worker->server;
+    atomic_int *waitingSlot = &server->waitingWorker[lobby->variant];
+    int waiting = lobby->waitingCount > 0 && worker->rooms.roomCount < server->maxRooms;
+    int expected = waiting ? -1 : worker->index;
+    int desired = waiting ? worker->index : -1;
+
+    if (server->workerCount < 2) return;
+    if (atomic_load_explicit(waitingSlot, memory_order_relaxed) != expected) return;
+    atomic_compare_exchange_strong(waitingSlot, &expected, desired);
+}
+
+/*
+ * Desc: Adopts connections handed over by other workers and serves their request: joining players are queued in the
+ *       lobby of their variant, spectators subscribed to their match and reconnecting players seated in theirs.
+ * Params:
+ *    worker - worker owning the mailbox
+ * Returns: number of adopted connections
+ */
+int handleHandoffs(struct worker *worker) {
+    struct handoff handoffs[MAX_HANDOFFS_PER_WAKEUP];
+    int count, adopted = 0;
+
+    while ((count = takeHandoffs(&worker->mailbox, handoffs, MAX_HANDOFFS_PER_WAKEUP)) > 0) {
+        for (int i = 0; i < count; i++) {
+            int fileDescriptor = handoffs[i].fileDescriptor;
+            struct connection *connection = createConnection(&worker->rooms, fileDescriptor);
+
+            if (connection == NULL || watchConnection(&worker->loop, fileDescriptor) != 0) {
+                traceEvent(worker->traceRing, TRACE_INFO, "Unable to adopt a handed over connection. Errno: %d\n",
+                           errno, 0, 0);
+                destroyConnection(&worker->rooms, fileDescriptor);
+                close(fileDescriptor);
+                continue;
+            }
+
+            connection->variant = handoffs[i].variant;
+            connection->acceptedUs = handoffs[i].acceptedUs;
+            if (handoffs[i].request == RESUME_REQUEST) {
+                handleResumeRequest(worker, connection, handoffs[i].token);
+            } else if (handoffs[i].request == SPECTATE_REQUEST) {
+                handleSpectateRequest(worker, connection, handoffs[i].variant, handoffs[i].token);
+            } else {
+                joinLobby(worker, connection);
+            }
+            adopted++;
+        }
+
+        if (count < MAX_HANDOFFS_PER_WAKEUP) break;
+    }
+
+    return adopted;
+}
+
+/*
+ * Desc: Main game loop function that finds the room of the connection, handles its game state changing and directs
+ *       connections.
+ * Params:
+ *    connection_type - classifier that defines the type of incomming connection
+ *    receivedData - struct with data received from a connection
+ *    worker - worker owning the connection, its rooms and timers
+ * Returns:
+ *    0 - if all executed as expected
+ *    -1 - if error occurred
+ *    -3 - unhandled combination of input parameters
+ */
+int executeGame(int connection_type, struct received *receivedData, struct worker *worker) {
+    struct roomTable *rooms = &worker->rooms;
+    struct connection *connection = findConnection(rooms, receivedData->fileDescriptor);
+    struct room *room = connection == NULL ? NULL : connection->room;
+    int result;
+
+    if (connection == NULL && connection_type == NEW_CONNECTION) {
+        if ((connection = createConnection(rooms, receivedData->fileDescriptor)) == NULL) return DEFAULT_ERROR_RETURN;
+        connection->acceptedUs = worker->wakeupUs;
+        scheduleTimer(&worker->timers, &connection->idleTimer, JOIN_TIMEOUT, evictIdleConnection);
+        return DEFAULT_RETURN;
+
+    } else if (connection == NULL) {
+        return -3;
+
+    } else if (connection_type == DISCONNECTED) {
+        result = room == NULL ? DEFAULT_RETURN : handlePlayerDisconnect(worker, room, receivedData);
+
+        if (connection->ticket != 0) {
+            leaveLobby(&worker->lobbies[connection->variant], connection, rooms);
+            publishWaitingPlayer(worker, &worker->lobbies[connection->variant]);
+        }
+        destroyConnection(rooms, receivedData->fileDescriptor);
+        return result;
+
+    } else if (room == NULL && connection->variant < 0 && connection_type == NEW_DATA) {
+        return handleJoinRequest(worker, connection, receivedData);
+
+    } else if (room == NULL) {
+        return -3;
+
+    } else if (room->gameState == 1 && connection_type == NEW_DATA) {
+        result = handleGameSequence(worker, room, receivedData);
+        if (room->gameState == 1 && room->client2 == AI_OPPONENT) playAiMove(worker, room);
+        if (room->gameState == 1 && result == DEFAULT_RETURN) startTurn(worker, room);
+        if (room->gameState != 2) return result;
+
+        cancelTimer(&room->turnTimer);
+        recordValue(&worker->metrics, METRIC_MATCH_DURATION, worker->wakeupUs - room->startedUs, 1);
+        scheduleTimer(&worker->timers, &room->cooldownTimer, TIME_BETWEEN_GAMES, resetGame);
+        return result;
+    }
+
+    return -3;
+}
+
+/*
+ * Desc: Handles the first packet of a connection, which names the board size and win length the player wants to play
+ *       or watch. Requests for an unsupported variant are ignored, so their connection is evicted once its idle timer
+ *       expires.
+ * Params:
+ *    worker - worker owning the connection
+ *    connection - connection of the joining player
+ *    receivedData - the join request
+ * Returns: -1 on error, 0 otherwise
+ */
+int handleJoinRequest(struct worker *worker, struct connection *connection, struct received *receivedData) {
+    struct packet_data *request = receivedData->data;
+    int variant = variantIndex(request->x, request->y);
+
+    if (request->gameState == RESUME_REQUEST) {
+        cancelTimer(&connection->idleTimer);
+        return handleResumeRequest(worker, connection, request->token);
+    }
+    if (variant < 0 || (request->gameState != SPECTATE_REQUEST && request->gameState != JOIN_REQUEST)) {
+        return DEFAULT_ERROR_RETURN;
+    }
+
+    cancelTimer(&connection->idleTimer);
+    if (request->gameState == SPECTATE_REQUEST) {
+        return handleSpectateRequest(worker, connection, variant, request->token);
+    }
+
+    connection->variant = variant;
+    traceEvent(worker->traceRing, TRACE_INFO, "Player joined a %dx%d board, %d in a row.\n", request->x, request->x,
+               request->y);
+    return joinLobby(worker, connection);
+}
+
+/*
+ * Desc: Subscribes a spectator to the channel of the match it asked for, or to the channel of its variant if it asked
+ *       for any match, and sends it a snapshot of the match shown, or a waiting state until the next match of the
+ *       variant starts. A match of another worker is handed over to that worker; a spectator of a match that is not
+ *       running anymore or is not of the requested variant is disconnected.
+ * Params:
+ *    worker - worker owning the connection
+ *    connection - connection of the spectator
+ *    variant - board variant to watch
+ *    matchId - id of the match to watch, 0 for any match of the variant
+ * Returns: -1 on error, 0 otherwise
+ */
+int handleSpectateRequest(struct worker *worker, struct connection *connection, int variant, uint64_t matchId) {
+    int owner = (int) ((matchId >> 56) % (uint64_t) worker->server->workerCount);
+    struct channel *channel = &worker->channels[variant];
+    uint8_t frame[MAX_SNAPSHOT_SIZE];
+    struct packet_data waiting;
+    struct room *room;
+
+    connection->variant = variant;
+    if (matchId != 0 && owner != worker->index) {
+        return handOverRequest(worker, connection, owner, SPECTATE_REQUEST, matchId);
+    }
+
+    if (matchId != 0) {
+        room = findMatch(worker, matchId);
+        if (room == NULL || variantIndex(room->board.size, room->board.winLength) != variant) {
+            traceEvent(worker->traceRing, TRACE_INFO, "Rejected a spectator of an unknown match.\n", 0, 0, 0);
+            dropConnection(connection);
+            return DEFAULT_ERROR_RETURN;
+        }
+        channel = &room->channel;
+    }
+
+    if (subscribeToChannel(&worker->rooms, channel, connection) != 0) return DEFAULT_ERROR_RETURN;
+    traceEvent(worker->traceRing, TRACE_INFO, "Spectator joined, %d watching.\n", channel->spectatorCount, 0, 0);
+
+    if (channel->room == NULL) {
+        memset(&waiting, 0, sizeof(struct packet_data));
+        return sendData(worker, connection->fileDescriptor, &waiting) == -1 ? DEFAULT_ERROR_RETURN : DEFAULT_RETURN;
+    }
+
+    int frameLength = encodeRoomSnapshot(channel->room, frame, sizeof(frame));
+    return queueFrame(worker, connection, frame, frameLength) == -1 ? DEFAULT_ERROR_RETURN : DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Finds the room running a match by the match id. Spectate requests are rare next to moves, so the room list is
+ *       walked instead of keeping an index of the match ids.
+ * Params:
+ *    worker - worker owning the rooms
+ *    matchId - id of the match
+ * Returns: the room or NULL if none of the worker's rooms runs the match
+ */
+struct room *findMatch(struct worker *worker, uint64_t matchId) {
+    for (struct room *room = worker->rooms.roomList; room != NULL; room = room->nextRoom) {
+        if (room->matchId == matchId) return room;
+    }
+    return NULL;
+}
+
+/*
+ * Desc: Finds the channel of the variant played in a room.
+ * Params:
+ *    worker - worker owning the room
+ *    room - room of the match
+ * Returns: the channel
+ */
+struct channel *variantChannel(struct worker *worker, struct room *room) {
+    return &worker->channels[variantIndex(room->board.size, room->board.winLength)];
+}
+
+/*
+ * Desc: Tells whether any spectator watches the match of a room, through the channel of the room or of its variant.
+ * Params:
+ *    worker - worker owning the room
+ *    room - room of the match
+ * Returns: 1 if the match has spectators, 0 otherwise
+ */
+int isWatched(struct worker *worker, struct room *room) {
+    struct channel *channel = variantChannel(worker, room);
+    return room->channel.spectatorCount > 0 || (channel->room == room && channel->spectatorCount > 0);
+}
+
+/*
+ * Desc: Packs the board of a room into a snapshot frame.
+ * Params:
+ *    room - room of the match
+ *    frame - output the frame is written to
+ *    capacity - size of the output
+ * Returns: size of the frame, -1 if it does not fit into the output
+ */
+int encodeRoomSnapshot(struct room *room, uint8_t *frame, int capacity) {
+    struct board_snapshot snapshot;
+    int size = room->board.size;
+
+    snapshot.size = size;
+    snapshot.winLength = room->board.winLength;
+    snapshot.gameState = room->gameState;
+    for (int x = 0; x < size; x++) {
+        for (int y = 0; y < size; y++) snapshot.cells[x * size + y] = (uint8_t) (boardCell(&room->board, x, y) + 1);
+    }
+
+    return encodeSnapshot(frame, capacity, &snapshot);
+}
+
+/*
+ * Desc: Puts a starting match on the channel of its variant if the channel shows none, and sends the empty board to
+ *       the spectators of the match.
+ * Params:
+ *    worker - worker owning the room
+ *    room - room whose match starts
+ */
+void showMatchStart(struct worker *worker, struct room *room) {
+    struct channel *channel = variantChannel(worker, room);
+    uint8_t frame[MAX_SNAPSHOT_SIZE];
+
+    if (channel->room == NULL) channel->room = room;
+    if (!isWatched(worker, room)) return;
+
+    int frameLength = encodeRoomSnapshot(room, frame, sizeof(frame));
+    if (frameLength > 0) broadcastToSpectators(worker, room, frame, frameLength);
+}
+
+/*
+ * Desc: Fans an encoded frame out to the spectators of a room: those of its own channel and, if the channel of its
+ *       variant shows the room, those of the variant channel.
+ * Params:
+ *    worker - worker owning the room
+ *    room - room the frame belongs to
+ *    frame - encoded frame
+ *    frameLength - size of the frame
+ */
+void broadcastToSpectators(struct worker *worker, struct room *room, const uint8_t *frame, int frameLength) {
+    struct channel *channel = variantChannel(worker, room);
+
+    broadcastToChannel(worker, &room->channel, frame, frameLength);
+    if (channel->room == room) broadcastToChannel(worker, channel, frame, frameLength);
+}
+
+/*
+ * Desc: Fans an encoded frame out to the spectators of a channel. The frame is copied once into the open broadcast of
+ *       the loop iteration; when a new broadcast is opened, every spectator queues a reference to it, so the frames of
+ *       an iteration reach all spectators without being copied per spectator. Spectators whose feed is full are
+ *       dropped as slow consumers.
+ * Params:
+ *    worker - worker owning the channel
+ *    channel - channel to broadcast on
+ *    frame - encoded frame
+ *    frameLength - size of the frame
+ */
+void broadcastToChannel(struct worker *worker, struct channel *channel, const uint8_t *frame, int frameLength) {
+    struct pool *broadcasts = &worker->rooms.broadcastPool;
+
+    if (channel->spectatorCount == 0) return;
+    if (channel->open != NULL && channel->openIteration == worker->iteration &&
+        appendToBroadcast(channel->open, frame, frameLength) == 0) {
+        return;
+    }
+
+    if (channel->open != NULL) releaseBroadcast(broadcasts, channel->open);
+    if ((channel->open = createBroadcast(broadcasts)) == NULL) return;
+
+    retainBroadcast(channel->open);
+    channel->openIteration = worker->iteration;
+    appendToBroadcast(channel->open, frame, frameLength);
+
+    for (struct connection *spectator = channel->spectators; spectator != NULL; spectator = spectator->nextSpectator) {
+        if (spectator->dropped) continue;
+
+        if (pushToFeed(spectator->feed, channel->open) != 0) {
+            traceEvent(worker->traceRing, TRACE_INFO, "Dropping slow spectator %d.\n", spectator->fileDescriptor, 0, 0);
+            dropConnection(spectator);
+            continue;
+        }
+        markDirty(worker, spectator);
+    }
+}
+
+/*
+ * Desc: Encodes a state message for the spectators of a room once and broadcasts it.
+ * Params:
+ *    worker - worker owning the room
+ *    room - room of the match
+ *    gameState - 0 if the match closed, 1 for a move, 2 for the last move
+ *    player - player that moved, the winner or 2 for a draw
+ *    x - row of the move
+ *    y - column of the move
+ */
+void broadcastState(struct worker *worker, struct room *room, int gameState, int player, int x, int y) {
+    uint8_t frame[MAX_MESSAGE_SIZE];
+    struct packet_data data;
+
+    if (!isWatched(worker, room)) return;
 
-void handleError(int errorCode, int errorType);
+    memset(&data, 0, sizeof(struct packet_data));
+    data.gameState = gameState;
+    data.enemyMove = player;
+    data.x = x;
+    data.y = y;
 
-int bindToPort(struct addrinfo *ai, int *listener);
+    int frameLength = encodeMessage(frame, sizeof(frame), MESSAGE_STATE, &data);
+    if (frameLength > 0) broadcastToSpectators(worker, room, frame, frameLength);
+}
 
-int handleConnections(int listener, fd_set *master, int *maxFd, struct received *data, int *gameRunning);
+/*
+ * Desc: Tells the spectators of a room that is about to close that its match is over and takes the room off the
+ *       channel of its variant. The spectators of the room stay on as spectators of any match of the variant; if the
+ *       variant channel shows another match, they get its snapshot after the closing state.
+ * Params:
+ *    worker - worker owning the room
+ *    room - room that closes
+ */
+void closeChannels(struct worker *worker, struct room *room) {
+    struct channel *channel = variantChannel(worker, room);
+    uint8_t frame[MAX_SNAPSHOT_SIZE];
 
-int handleNewConnection(int listener, fd_set *master, int *maxFd);
+    broadcastState(worker, room, 0, 0, -1, -1);
+    if (channel->room == room) channel->room = NULL;
+    if (room->channel.spectatorCount == 0) return;
 
-int handleExistingConnection(int i, fd_set *master, int *maxFd, struct received *data);
+    if (channel->room != NULL) {
+        int frameLength = encodeRoomSnapshot(channel->room, frame, sizeof(frame));
+        if (frameLength > 0) broadcastToChannel(worker, &room->channel, frame, frameLength);
+    }
+    moveSpectators(&worker->rooms, &room->channel, channel);
+}
 
-int sendData(int socketFd, struct packet_data *data, int timeout);
+/*
+ * Desc: Queues a player in the lobby of its variant and pairs it with the player that has waited the longest, if there
+ *       is one. If nobody waits on this worker but another worker has a waiting player, the connection is handed over
+ *       instead. A player left alone in a lobby the solver covers is offered the AI opponent once the AI delay passed.
+ * Params:
+ *    worker - worker owning the connection
+ *    connection - connection of the joining player
+ * Returns: -1 on error, 0 otherwise
+ */
+int joinLobby(struct worker *worker, struct connection *connection) {
+    struct lobby *lobby = &worker->lobbies[connection->variant];
+    int fileDescriptor = connection->fileDescriptor;
 
-int executeGame(int connection_type, struct received *receivedData, struct gameState *gameState,
-                int gameBoard[BOARD_SIZE][BOARD_SIZE]);
+    if (lobby->waitingCount == 0 && handOverToWaitingWorker(worker, connection) == 0) {
+        destroyConnection(&worker->rooms, fileDescriptor);
+        return DEFAULT_RETURN;
+    }
 
-int addPlayer(struct received *receivedData, struct gameState *gameState);
+    if (enqueuePlayer(lobby, connection) == 0) return DEFAULT_ERROR_RETURN;
+    matchPlayers(worker, lobby);
+    publishWaitingPlayer(worker, lobby);
+    if (connection->ticket == 0) return DEFAULT_RETURN;
 
-void clearGameBoard(int gameBoard[BOARD_SIZE][BOARD_SIZE]);
+    if (worker->server->aiDelayMs >= 0 && lobby->variant == variantIndex(SOLVER_BOARD_SIZE, SOLVER_WIN_LENGTH)) {
+        if (worker->server->aiDelayMs == 0 && matchWithAi(worker, lobby) > 0) return DEFAULT_RETURN;
+        if (!isTimerPending(&lobby->opponentTimer)) {
+            scheduleTimer(&worker->timers, &lobby->opponentTimer, worker->server->aiDelayMs, offerAiOpponent);
+        }
+    }
 
-int handlePlayerDisconnect(struct gameState *gameState, struct received *receivedData);
+    if (!isTimerPending(&lobby->updateTimer)) {
+        lobby->reportedHead = lobby->head;
+        scheduleTimer(&worker->timers, &lobby->updateTimer, LOBBY_UPDATE_INTERVAL, updateQueuePositions);
+    }
 
-int handleGameSequence(struct gameState *gameState, struct received *receivedData, int gameBoard[BOARD_SIZE][BOARD_SIZE]);
+    traceEvent(worker->traceRing, TRACE_INFO, "Player queued at position %d.\n", queuePosition(lobby, connection), 0,
+               0);
+    return sendQueuePosition(worker, fileDescriptor, queuePosition(lobby, connection)) == -1 ? DEFAULT_ERROR_RETURN
+                                                                                            : DEFAULT_RETURN;
+}
 
-int handleNewPlayer(struct gameState *gameState, struct received *receivedData);
+/*
+ * Desc: Pairs waiting players of a lobby in the order they joined and opens a room for every pair, as long as the
+ *       worker has rooms left.
+ * Params:
+ *    worker - worker owning the lobby
+ *    lobby - lobby to pair players from
+ * Returns: number of rooms opened
+ */
+int matchPlayers(struct worker *worker, struct lobby *lobby) {
+    struct roomTable *rooms = &worker->rooms;
+    struct received playerData;
+    int opened = 0;
+    long long nowUs = lobby->waitingCount >= 2 ? monotonicUs() : 0;
+
+    while (lobby->waitingCount >= 2 && rooms->roomCount < worker->server->maxRooms) {
+        struct room *room = createRoom(rooms, lobby->variant);
+        if (room == NULL) break;
+
+        struct connection *first = dequeuePlayer(lobby, rooms);
+        struct connection *second = dequeuePlayer(lobby, rooms);
+        recordValue(&worker->metrics, METRIC_PAIR_WAIT, nowUs - first->acceptedUs, 1);
+        recordValue(&worker->metrics, METRIC_PAIR_WAIT, nowUs - second->acceptedUs, 1);
+        countMetric(&worker->metrics, METRIC_ROOMS_OPENED, 1);
+        attachToRoom(rooms, first->fileDescriptor, room);
+        attachToRoom(rooms, second->fileDescriptor, room);
+
+        memset(&playerData, 0, sizeof(struct received));
+        playerData.fileDescriptor = first->fileDescriptor;
+        addPlayer(&playerData, room);
+
+        playerData.fileDescriptor = second->fileDescriptor;
+        handleNewPlayer(worker, room, &playerData);
+        opened++;
+    }
 
-int checkIfWon(int gameBoard[BOARD_SIZE][BOARD_SIZE], struct gameState *gameState);
+    return opened;
+}
 
-void resetGame(struct gameState *gameState, struct received *receivedData, int gameBoard[BOARD_SIZE][BOARD_SIZE],
-               int *connectionType);
+/*
+ * Desc: Opens a room against the AI opponent for every player of a lobby, as long as the worker has rooms left. The
+ *       player opens the match and the AI answers every move from the solver table.
+ * Params:
+ *    worker - worker owning the lobby
+ *    lobby - lobby of the 3x3 board
+ * Returns: number of rooms opened
+ */
+int matchWithAi(struct worker *worker, struct lobby *lobby) {
+    struct roomTable *rooms = &worker->rooms;
+    struct received playerData;
+    int opened = 0;
+    long long nowUs = lobby->waitingCount > 0 ? monotonicUs() : 0;
+
+    while (lobby->waitingCount > 0 && rooms->roomCount < worker->server->maxRooms) {
+        struct room *room = createRoom(rooms, lobby->variant);
+        if (room == NULL) break;
+
+        struct connection *player = dequeuePlayer(lobby, rooms);
+        recordValue(&worker->metrics, METRIC_PAIR_WAIT, nowUs - player->acceptedUs, 1);
+        countMetric(&worker->metrics, METRIC_ROOMS_OPENED, 1);
+        attachToRoom(rooms, player->fileDescriptor, room);
+
+        memset(&playerData, 0, sizeof(struct received));
+        playerData.fileDescriptor = player->fileDescriptor;
+        addPlayer(&playerData, room);
+
+        playerData.fileDescriptor = AI_OPPONENT;
+        handleNewPlayer(worker, room, &playerData);
+        opened++;
+    }
 
-int main(int argc, char *argv[]) {
+    publishWaitingPlayer(worker, lobby);
+    if (opened > 0) {
+        traceEvent(worker->traceRing, TRACE_INFO, "%d players matched with the AI opponent.\n", opened, 0, 0);
+    }
+    return opened;
+}
 
-    int listener, maxFd, connectionType;
-    int gameRunning;
-    char hostPort[5];
-    struct addrinfo hints, *addrInfo;
-    struct received receivedData;
-    struct packet_data packetData;
-    struct gameState gameState;
-    int gameBoard[BOARD_SIZE][BOARD_SIZE];
-    fd_set master;
+/*
+ * Desc: Gives the players still waiting in a lobby the AI opponent. Called by the opponent timer of the lobby once the
+ *       AI delay has passed since a player was left waiting alone.
+ * Params:
+ *    timer - opponent timer of the lobby
+ *    context - worker owning the lobby
+ */
+void offerAiOpponent(struct timer *timer, void *context) {
+    struct lobby *lobby = containerOf(timer, struct lobby, opponentTimer);
+    matchWithAi(context, lobby);
+}
 
-    gameRunning = 1;
-    memset(&receivedData, 0, sizeof(struct received));
-    memset(&packetData, 0, sizeof(struct packet_data));
-    memset(&gameState, 0, sizeof(struct gameState));
-    memset(hostPort, 0, sizeof(hostPort));
-    receivedData.data = &packetData;
-    FD_ZERO(&master);
+/*
+ * Desc: Answers the move of a player in a room against the AI opponent with the move the solver table holds for the
+ *       position. It is played like a move received from a connection, so the player gets the same messages.
+ * Params:
+ *    worker - worker owning the room
+ *    room - room whose second client is the AI opponent
+ * Returns: -1 on error, 0 otherwise
+ */
+int playAiMove(struct worker *worker, struct room *room) {
+    struct received aiData;
+    struct packet_data move;
 
+    if (playerToMove(&room->board) != 1) return DEFAULT_RETURN;
 
-    prepareAddrinfoHints(&hints);
+    memset(&move, 0, sizeof(struct packet_data));
+    if (solverMove(&room->board, &move.x, &move.y) != 0) return DEFAULT_ERROR_RETURN;
 
-    if (argc < 2) {
-        handleError(errno, 1);
-        return DEFAULT_ERROR_RETURN;
-    } else {
-        strcpy(hostPort, *(argv + 1));
-    }
+    memset(&aiData, 0, sizeof(struct received));
+    aiData.connectionType = NEW_DATA;
+    aiData.fileDescriptor = AI_OPPONENT;
+    aiData.data = &move;
+    return handleGameSequence(worker, room, &aiData);
+}
 
-    if (getaddrinfo(NULL, hostPort, &hints, &addrInfo) != 0) {
-        handleError(errno, 2);
-        return DEFAULT_ERROR_RETURN;
-    }
+/*
+ * Desc: Pairs players of every lobby after a room has been freed on a worker that ran out of rooms.
+ * Params:
+ *    worker - worker owning the lobbies
+ */
+void matchWaitingLobbies(struct worker *worker) {
+    for (int i = 0; i < VARIANT_COUNT && worker->rooms.roomCount < worker->server->maxRooms; i++) {
+        if (worker->lobbies[i].waitingCount < 2) continue;
 
-    if ((bindToPort(addrInfo, &listener)) != 0) {
-        handleError(errno, 3);
-        return DEFAULT_ERROR_RETURN;
+        matchPlayers(worker, &worker->lobbies[i]);
+        publishWaitingPlayer(worker, &worker->lobbies[i]);
     }
+}
 
-    freeaddrinfo(addrInfo);
+/*
+ * Desc: Tells a waiting player how many players are in front of it.
+ * Params:
+ *    worker - worker owning the connection
+ *    fileDescriptor - file descriptor of the waiting player
+ *    position - 1-based position in the lobby
+ * Returns: 0 if queued, -1 if error
+ */
+int sendQueuePosition(struct worker *worker, int fileDescriptor, int position) {
+    struct packet_data exportData;
+    memset(&exportData, 0, sizeof(struct packet_data));
+    exportData.gameState = 0;
+    exportData.x = position;
+    return sendData(worker, fileDescriptor, &exportData);
+}
 
-    if (listen(listener, MAX_CONNECTION_QUEUE) != 0) {
-        handleError(errno, 4);
-        return DEFAULT_ERROR_RETURN;
-    }
+/*
+ * Desc: Periodically sends the exact queue position to every waiting player, but only if the queue has moved since the
+ *       last report. Called by the lobby timer every LOBBY_UPDATE_INTERVAL while players are waiting.
+ * Params:
+ *    timer - update timer of the lobby
+ *    context - worker owning the lobby
+ */
+void updateQueuePositions(struct timer *timer, void *context) {
+    struct worker *worker = context;
+    struct lobby *lobby = containerOf(timer, struct lobby, updateTimer);
+    int position = 0;
 
-    FD_SET(listener, &master);
-    maxFd = listener;
+    if (lobby->waitingCount == 0) return;
 
-    while (gameRunning) {
+    if (lobby->head != lobby->reportedHead) {
+        for (unsigned long ticket = lobby->head; ticket != lobby->tail; ticket++) {
+            struct lobbyEntry *entry = &lobby->entries[ticket & (lobby->capacity - 1)];
+            struct connection *connection = findConnection(&worker->rooms, entry->fileDescriptor);
 
-        if (gameState.gameState != 2) {
-            connectionType = handleConnections(listener, &master, &maxFd, &receivedData, &gameRunning);
-        } else {
-            resetGame(&gameState, &receivedData, gameBoard, &connectionType);
+            if (connection != NULL && connection->ticket == entry->ticket) {
+                sendQueuePosition(worker, entry->fileDescriptor, ++position);
+            }
         }
+        lobby->reportedHead = lobby->head;
+    }
+
+    scheduleTimer(&worker->timers, timer, LOBBY_UPDATE_INTERVAL, updateQueuePositions);
+}
+
+/*
+ * Desc: Function resets the game info and prepares game for the next round. Called by the room cooldown timer once
+ *       TIME_BETWEEN_GAMES has passed since the end of the match.
+ * Params:
+ *    timer - cooldown timer of the room
+ *    context - worker owning the room
+ */
+void resetGame(struct timer *timer, void *context) {
+    struct room *room = containerOf(timer, struct room, cooldownTimer);
+    struct received receivedData;
+    memset(&receivedData, 0, sizeof(struct received));
 
-        executeGame(connectionType, &receivedData, &gameState, gameBoard);
-        if (DEBUG) printf("Game state: %d\n", gameState.gameState);
+    // A recovered match that ended before both players were back has nobody to start the next one with.
+    if (room->client1 == RESUME_PENDING || room->client2 == RESUME_PENDING) {
+        closeRecoveredRoom(context, room);
+        return;
     }
 
-    return DEFAULT_RETURN;
+    room->gameState = 0;
+    receivedData.fileDescriptor = room->client2;
+    room->client2 = 0;
+    clearBoard(&room->board);
+    handleNewPlayer(context, room, &receivedData);
 }
 
 /*
- * Desc: Main game loop function that handles game state changing and directs connections.
+ * Desc: Gives the player to move the turn timeout of the server to play, replacing the deadline of the previous turn.
  * Params:
- *    connection_type - classifier that defines the type of incomming connection
- *    receivedData - struct with data received from a connection
- *    gameState - struct with information about current game
- * Returns:
- *    0 - if all executed as expected
- *    -1 - if error occurred
- *    -3 - unhandled combination of input parameters
+ *    worker - worker owning the room
+ *    room - room with a running match
  */
-int executeGame(int connection_type, struct received *receivedData, struct gameState *gameState,
-                int gameBoard[BOARD_SIZE][BOARD_SIZE]) {
-    if (gameState->gameState == 0 && connection_type == NEW_CONNECTION) {
-        clearGameBoard(gameBoard);
-        return handleNewPlayer(gameState, receivedData);
+void startTurn(struct worker *worker, struct room *room) {
+    if (worker->server->turnTimeoutMs == 0) return;
+    scheduleTimer(&worker->timers, &room->turnTimer, worker->server->turnTimeoutMs, forfeitTurn);
+}
 
-    } else if (gameState->gameState == 1 && connection_type == NEW_DATA) {
-        return handleGameSequence(gameState, receivedData, gameBoard);
+/*
+ * Desc: Ends the match of a player who did not move in time as a win for the opponent and drops the idle player
+ *       without a reply. The disconnect then closes the room and sends the opponent back to the lobby. Called by the
+ *       turn timer of the room.
+ * Params:
+ *    timer - turn timer of the room
+ *    context - worker owning the room
+ */
+void forfeitTurn(struct timer *timer, void *context) {
+    struct worker *worker = context;
+    struct room *room = containerOf(timer, struct room, turnTimer);
+    int idlePlayer = playerToMove(&room->board);
+    int idleClient = idlePlayer == 0 ? room->client1 : room->client2;
+    int winner = idlePlayer == 0 ? room->client2 : room->client1;
+    struct connection *connection = findConnection(&worker->rooms, idleClient);
+    struct packet_data data;
 
-    } else if (connection_type == DISCONNECTED) {
-        return handlePlayerDisconnect(gameState, receivedData);
-    }
+    // The AI opponent moves right away and a seat of a recovered match has its own resume timeout.
+    if (room->gameState != 1 || connection == NULL) return;
 
-    return -3;
+    memset(&data, 0, sizeof(struct packet_data));
+    data.gameState = 2;
+    data.x = -1;
+    data.y = -1;
+    data.enemyMove = 0;
+    sendData(worker, winner, &data);
+    room->gameState = 2;
+
+    logMatchEvent(worker, room, MATCH_LOG_RESULT, 1 - idlePlayer, 0, 0);
+    broadcastState(worker, room, 2, 1 - idlePlayer, -1, -1);
+    recordValue(&worker->metrics, METRIC_MATCH_DURATION, worker->wakeupUs - room->startedUs, 1);
+    countMetric(&worker->metrics, METRIC_TURNS_TIMED_OUT, 1);
+    worker->roomsChanged = 1;
+    traceEvent(worker->traceRing, TRACE_INFO, "Player #%d forfeited after %d ms without a move.\n", idlePlayer + 1,
+               worker->server->turnTimeoutMs, 0);
+    dropConnection(connection);
 }
 
 /*
- * Desc: Function resets the game info and prepares game for the next round.
+ * Desc: Drops a connection that did not send its first request within JOIN_TIMEOUT. Called by the idle timer of the
+ *       connection.
  * Params:
- *    gameState - struct with information about current game
- *    receivedData - struct with data received from a connection
- *    gameBoard - the game board matrix
- *    connection_type - classifier that defines the type of incomming connection
+ *    timer - idle timer of the connection
+ *    context - worker owning the connection
  */
-void resetGame(struct gameState *gameState, struct received *receivedData, int gameBoard[BOARD_SIZE][BOARD_SIZE],
-               int *connectionType) {
-    gameState->gameState = 0;
-    receivedData->fileDescriptor = gameState->client2;
-    gameState->client2 = 0;
-    *connectionType = NEW_CONNECTION;
-    clearGameBoard(gameBoard);
-    sleep(TIME_BETWEEN_GAMES);
+void evictIdleConnection(struct timer *timer, void *context) {
+    struct worker *worker = context;
+    struct connection *connection = containerOf(timer, struct connection, idleTimer);
+
+    if (connection->dropped) return;
+
+    countMetric(&worker->metrics, METRIC_IDLE_EVICTIONS, 1);
+    traceEvent(worker->traceRing, TRACE_INFO, "Evicted a connection that did not join within %d ms.\n", JOIN_TIMEOUT,
+               0, 0);
+    dropConnection(connection);
 }
 
 /*
  * Desc: Function controls the main game sequence.
  * Params:
- *   gameState - structure with current game state information
+ *   worker - worker owning the room
+ *   room - room with current game state information
  *   receivedData - data received from handleConnections function
  * Returns: -1 on error, 0 otherwise
  */
-int handleGameSequence(struct gameState *gameState, struct received *receivedData, int gameBoard[BOARD_SIZE][BOARD_SIZE]) {
-    int winner;
+int handleGameSequence(struct worker *worker, struct room *room, struct received *receivedData) {
+    int winner, player, result;
     struct packet_data data;
     memset(&data, 0, sizeof(struct packet_data));
 
@@ -215,55 +1675,69 @@ int handleGameSequence(struct gameState *gameState, struct received *receivedDat
     data.x = receivedData->data->x;
     data.y = receivedData->data->y;
 
-    if (gameBoard[data.x][data.y] == 0) {
-        gameBoard[data.x][data.y] = receivedData->fileDescriptor;
+    if (receivedData->fileDescriptor == room->client1) {
+        player = 0;
+    } else if (receivedData->fileDescriptor == room->client2) {
+        player = 1;
     } else {
         return DEFAULT_ERROR_RETURN;
     }
 
-    winner = checkIfWon(gameBoard, gameState);
-    if (winner == gameState->client1) {
+    // Moves outside of the board, on taken cells or out of turn are ignored.
+    if ((result = playMove(&room->board, player, data.x, data.y)) == MOVE_INVALID) return DEFAULT_ERROR_RETURN;
+    countMetric(&worker->metrics, METRIC_MOVES_PLAYED, 1);
+    worker->movesSinceWakeup++;
+    logMatchEvent(worker, room, MATCH_LOG_MOVE, player, data.x, data.y);
+    worker->roomsChanged = 1;
+    if (result != MOVE_PLAYED) {
+        logMatchEvent(worker, room, MATCH_LOG_RESULT, result == MOVE_WON ? player : MATCH_RESULT_DRAW, 0, 0);
+    }
+    broadcastState(worker, room, result == MOVE_PLAYED ? 1 : 2, result == MOVE_DRAW ? 2 : player, data.x, data.y);
+
+    winner = result == MOVE_WON ? receivedData->fileDescriptor : 0;
+    if (result == MOVE_DRAW) winner = -1;
+    if (winner == room->client1) {
         data.gameState = 2;
         data.enemyMove = 0;
-        sendData(gameState->client1, &data, MAX_SEND_RETRY_COUNT);
+        sendData(worker, room->client1, &data);
 
         data.enemyMove = 1;
-        sendData(gameState->client2, &data, MAX_SEND_RETRY_COUNT);
-        gameState->gameState = 2;
+        sendData(worker, room->client2, &data);
+        room->gameState = 2;
         return DEFAULT_RETURN;
 
-    } else if (winner == gameState->client2) {
+    } else if (winner == room->client2) {
         data.gameState = 2;
         data.enemyMove = 0;
-        sendData(gameState->client2, &data, MAX_SEND_RETRY_COUNT);
+        sendData(worker, room->client2, &data);
 
         data.enemyMove = 1;
-        sendData(gameState->client1, &data, MAX_SEND_RETRY_COUNT);
-        gameState->gameState = 2;
+        sendData(worker, room->client1, &data);
+        room->gameState = 2;
         return DEFAULT_RETURN;
 
     } else if (winner == -1) {
         data.gameState = 2;
         data.enemyMove = 2;
-        sendData(gameState->client1, &data, MAX_SEND_RETRY_COUNT);
-        sendData(gameState->client2, &data, MAX_SEND_RETRY_COUNT);
-        gameState->gameState = 2;
+        sendData(worker, room->client1, &data);
+        sendData(worker, room->client2, &data);
+        room->gameState = 2;
         return DEFAULT_RETURN;
 
-    } else if (receivedData->fileDescriptor == gameState->client1) {
+    } else if (receivedData->fileDescriptor == room->client1) {
         data.enemyMove = 0;
-        sendData(gameState->client2, &data, MAX_SEND_RETRY_COUNT);
+        sendData(worker, room->client2, &data);
 
         data.enemyMove = 1;
-        sendData(gameState->client1, &data, MAX_SEND_RETRY_COUNT);
+        sendData(worker, room->client1, &data);
         return DEFAULT_RETURN;
 
-    } else if (receivedData->fileDescriptor == gameState->client2) {
+    } else if (receivedData->fileDescriptor == room->client2) {
         data.enemyMove = 0;
-        sendData(gameState->client1, &data, MAX_SEND_RETRY_COUNT);
+        sendData(worker, room->client1, &data);
 
         data.enemyMove = 1;
-        sendData(gameState->client2, &data, MAX_SEND_RETRY_COUNT);
+        sendData(worker, room->client2, &data);
         return DEFAULT_RETURN;
 
     } else {
@@ -272,139 +1746,60 @@ int handleGameSequence(struct gameState *gameState, struct received *receivedDat
 }
 
 /*
- * Desc: Checks if the current game board has been won by any client.
- * Params:
- *    gameBoard - current representation of the game board
- *    gameState - current game state
- * Returns: file descriptor of the winning client or 0, if no winner is present and -1 if draw
- */
-int checkIfWon(int gameBoard[BOARD_SIZE][BOARD_SIZE], struct gameState *gameState) {
-    int sumClient1, sumClient2, drawSum;
-    int client1 = gameState->client1;
-    int client2 = gameState->client2;
-
-    // Vertical & draw
-    for (int i = 0; i < BOARD_SIZE; i++) {
-        sumClient1 = 0;
-        sumClient2 = 0;
-        drawSum = 0;
-
-        for (int j = 0; j < BOARD_SIZE; j++) {
-            sumClient1 += gameBoard[i][j] == client1;
-            sumClient2 += gameBoard[i][j] == client2;
-
-            drawSum += gameBoard[i][j] == client1;
-            drawSum += gameBoard[i][j] == client2;
-        }
-
-        if (sumClient1 == BOARD_SIZE) return client1;
-        if (sumClient2 == BOARD_SIZE) return client2;
-
-        if (drawSum == BOARD_SIZE * BOARD_SIZE) return -1;
-    }
-
-    // Horizontal
-    for (int i = 0; i < BOARD_SIZE; i++) {
-        sumClient1 = 0;
-        sumClient2 = 0;
-
-        for (int j = 0; j < BOARD_SIZE; j++) {
-            sumClient1 += gameBoard[j][i] == client1;
-            sumClient2 += gameBoard[j][i] == client2;
-        }
-
-        if (sumClient1 == BOARD_SIZE) return client1;
-        if (sumClient2 == BOARD_SIZE) return client2;
-    }
-
-    // Diagonal
-    sumClient1 = 0;
-    sumClient2 = 0;
-
-    for (int i = 0; i < BOARD_SIZE; i++) {
-        sumClient1 += gameBoard[i][i] == client1;
-        sumClient2 += gameBoard[i][i] == client2;
-    }
-
-    if (sumClient1 == BOARD_SIZE) return client1;
-    if (sumClient2 == BOARD_SIZE) return client2;
-
-    sumClient1 = 0;
-    sumClient2 = 0;
-
-    for (int i = 0; i < BOARD_SIZE; i++) {
-        sumClient1 += gameBoard[i][BOARD_SIZE - i] == client1;
-        sumClient2 += gameBoard[i][BOARD_SIZE - i] == client2;
-    }
-
-    if (sumClient1 == BOARD_SIZE) return client1;
-    if (sumClient2 == BOARD_SIZE) return client2;
-
-    return 0;
-}
-
-
-/*
- * Desc: Sets game board to initial state
- * Params:
- *    gameBoard - board to reset
- */
-void clearGameBoard(int gameBoard[BOARD_SIZE][BOARD_SIZE]) {
-    for (int i = 0; i < BOARD_SIZE; i++) {
-        memset(gameBoard[i], 0, sizeof(gameBoard[i]));
-    }
-}
-
-/*
- * Desc: Function handles disconnections from clients in various game states.
+ * Desc: Function handles disconnections from clients in various game states. The opponent of the disconnected player
+ *       goes back to the lobby and the room is closed.
  * Params:
- *    gameState - structure with current game state information
+ *    worker - worker owning the room
+ *    room - room of the disconnected client
  *    receivedData - data received from handleConnections function
  * Returns:
  *    0 if handled correctly.
  *    -1 on error
  *    -2 on disconnection from non-client
  */
-int handlePlayerDisconnect(struct gameState *gameState, struct received *receivedData) {
-    if (gameState->gameState == 0) {
-        gameState->client1 = 0;
-        if (DEBUG) printf("Player #1 disconnected. No more connected players.\n");
-        return DEFAULT_RETURN;
+int handlePlayerDisconnect(struct worker *worker, struct room *room, struct received *receivedData) {
+    struct roomTable *rooms = &worker->rooms;
+    int remainingClient;
 
-    } else if (gameState->gameState == 1) {
-        if (gameState->client1 == receivedData->fileDescriptor) {
-            gameState->client1 = gameState->client2;
+    if (room->client1 == receivedData->fileDescriptor) {
+        remainingClient = room->client2;
 
-        } else if (receivedData->fileDescriptor != gameState->client1 &&
-                   receivedData->fileDescriptor != gameState->client2) {
-            return DEFAULT_ERROR_RETURN;
-        }
+    } else if (room->client2 == receivedData->fileDescriptor) {
+        remainingClient = room->client1;
 
-        gameState->gameState = 0;
-        gameState->client2 = 0;
+    } else {
+        return -2;
+    }
 
-        struct packet_data exportData;
-        memset(&exportData, 0, sizeof(struct packet_data));
-        exportData.gameState = 0;
-        if (sendData(gameState->client1, &exportData, MAX_SEND_RETRY_COUNT) == -1) return DEFAULT_ERROR_RETURN;
+    if (room->gameState == 1) {
+        logMatchEvent(worker, room, MATCH_LOG_RESULT, MATCH_RESULT_ABANDONED, remainingClient == room->client1, 0);
+    }
 
-        if (DEBUG) printf("Player #2 disconnected.\n");
-        return DEFAULT_RETURN;
+    closeChannels(worker, room);
+    destroyRoom(rooms, room);
+    countMetric(&worker->metrics, METRIC_ROOMS_CLOSED, 1);
+    worker->roomsChanged = 1;
+    if (rooms->roomCount == worker->server->maxRooms - 1) matchWaitingLobbies(worker);
 
-    } else {
-        return -2;
+    if (remainingClient <= 0) {
+        traceEvent(worker->traceRing, TRACE_INFO, "Player #1 disconnected. No more connected players.\n", 0, 0, 0);
+        return DEFAULT_RETURN;
     }
+
+    traceEvent(worker->traceRing, TRACE_INFO, "Player #2 disconnected.\n", 0, 0, 0);
+    return joinLobby(worker, findConnection(rooms, remainingClient));
 }
 
 /*
  * Desc: Handles connections of new players and their waiting in queue
  * Params:
- *    gameState - the current state of the game struct
+ *    worker - worker owning the room
+ *    room - the room the player joins
  *    receivedData - struct that has the connecting players info
  * Returns: -1 on error, 0 otherwise
  */
-int handleNewPlayer(struct gameState *gameState, struct received *receivedData) {
-    int players = addPlayer(receivedData, gameState);
+int handleNewPlayer(struct worker *worker, struct room *room, struct received *receivedData) {
+    int players = addPlayer(receivedData, room);
     struct packet_data exportData;
     memset(&exportData, 0, sizeof(struct packet_data));
 
@@ -413,9 +1808,9 @@ int handleNewPlayer(struct gameState *gameState, struct received *receivedData)
 
     } else if (players == 1) {
         exportData.gameState = 0;
-        if (sendData(gameState->client1, &exportData, MAX_SEND_RETRY_COUNT) == -1) return DEFAULT_ERROR_RETURN;
+        if (sendData(worker, room->client1, &exportData) == -1) return DEFAULT_ERROR_RETURN;
 
-        if (DEBUG) printf("Player #1 added.\n");
+        traceEvent(worker->traceRing, TRACE_INFO, "Player #1 added.\n", 0, 0, 0);
         return DEFAULT_RETURN;
 
     } else if (players == 2) {
@@ -423,13 +1818,27 @@ int handleNewPlayer(struct gameState *gameState, struct received *receivedData)
         exportData.enemyMove = 0;
         exportData.x = -1;
         exportData.y = -1;
-        if (sendData(gameState->client1, &exportData, MAX_SEND_RETRY_COUNT) == -1) return DEFAULT_ERROR_RETURN;
+        if (sendData(worker, room->client1, &exportData) == -1) return DEFAULT_ERROR_RETURN;
 
         exportData.enemyMove = 1;
-        if (sendData(gameState->client2, &exportData, MAX_SEND_RETRY_COUNT) == -1) return DEFAULT_ERROR_RETURN;
-        if (DEBUG) printf("Player #2 added\n");
-
-        gameState->gameState = 1;
+        if (sendData(worker, room->client2, &exportData) == -1) return DEFAULT_ERROR_RETURN;
+        traceEvent(worker->traceRing, TRACE_INFO, "Player #2 added.\n", 0, 0, 0);
+
+        room->gameState = 1;
+        room->startedUs = worker->wakeupUs;
+        room->matchId = worker->nextMatchId++;
+        logMatchEvent(worker, room, MATCH_LOG_START, room->board.size, room->board.winLength,
+                      room->client2 == AI_OPPONENT);
+        worker->roomsChanged = 1;
+        startTurn(worker, room);
+
+        if (worker->server->recovery != NULL) {
+            room->tokens[0] = newResumeToken(worker);
+            room->tokens[1] = room->client2 == AI_OPPONENT ? 0 : newResumeToken(worker);
+            sendResumeToken(worker, room->client1, room->tokens[0], 0);
+            sendResumeToken(worker, room->client2, room->tokens[1], 1);
+        }
+        showMatchStart(worker, room);
         return DEFAULT_RETURN;
 
     } else {
@@ -441,19 +1850,19 @@ int handleNewPlayer(struct gameState *gameState, struct received *receivedData)
  * Desc: Adds connecting players to game state clients
  * Params:
  *    receivedData - struct that has the connecting player file descriptor
- *    gameState - struct to add the connections as clients
+ *    room - room to add the connections as clients
  * Returns:
  *    -1 - if error occured
  *    1 - if first client added
  *    2 - if second client added
  */
-int addPlayer(struct received *receivedData, struct gameState *gameState) {
-    if (gameState->client1 == 0) {
-        gameState->client1 = receivedData->fileDescriptor;
+int addPlayer(struct received *receivedData, struct room *room) {
+    if (room->client1 == 0) {
+        room->client1 = receivedData->fileDescriptor;
         return 1;
 
-    } else if (gameState->client2 == 0) {
-        gameState->client2 = receivedData->fileDescriptor;
+    } else if (room->client2 == 0) {
+        room->client2 = receivedData->fileDescriptor;
         return 2;
 
     } else {
@@ -462,152 +1871,379 @@ int addPlayer(struct received *receivedData, struct gameState *gameState) {
 }
 
 /*
- * Desc: Function repeatedly tries to send all data until it's all sent or a timeout is reached.
+ * Desc: Packs the packet into a state message and queues it for the connection. The AI opponent reads the room
+ *       directly, so messages to it are skipped.
  * Params:
- *   socketFd - socket file descriptor to be used for sending data
+ *   worker - worker owning the connection
+ *   fileDescriptor - file descriptor of the connection
  *   data - packet_data to send
- *   timeout - number of retries to send data in case it's not sent
- * Returns: 0 if sent, -1 if error
+ * Returns: 0 if queued, -1 if error
+ */
+int sendData(struct worker *worker, int fileDescriptor, struct packet_data *data) {
+    struct connection *connection = findConnection(&worker->rooms, fileDescriptor);
+    uint8_t frame[MAX_MESSAGE_SIZE];
+    int frameLength = encodeMessage(frame, sizeof(frame), MESSAGE_STATE, data);
+
+    if (fileDescriptor == AI_OPPONENT || fileDescriptor == RESUME_PENDING) return DEFAULT_RETURN;
+    if (connection == NULL) return DEFAULT_ERROR_RETURN;
+    return queueFrame(worker, connection, frame, frameLength);
+}
+
+/*
+ * Desc: Queues an encoded frame for a connection. The queue is flushed at the end of the loop iteration, so all
+ *       messages of an iteration leave with a single write per socket. A connection whose queue overflows is a slow
+ *       consumer and gets dropped, so it can not hold up the other games of the worker.
+ * Params:
+ *   worker - worker owning the connection
+ *   connection - connection to send to
+ *   frame - encoded frame
+ *   frameLength - size of the frame
+ * Returns: 0 if queued, -1 if error
+ */
+int queueFrame(struct worker *worker, struct connection *connection, const uint8_t *frame, int frameLength) {
+    int fileDescriptor = connection->fileDescriptor;
+
+    if (connection->dropped || frameLength < 0) return DEFAULT_ERROR_RETURN;
+
+    if (acquireOutput(&worker->rooms, connection) == NULL ||
+        appendToBuffer(connection->output, frame, frameLength) != 0) {
+        traceEvent(worker->traceRing, TRACE_INFO, "Dropping slow consumer %d.\n", fileDescriptor, 0, 0);
+        dropConnection(connection);
+        return DEFAULT_ERROR_RETURN;
+    }
+
+    markDirty(worker, connection);
+    return DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Lists a connection for the flush at the end of the loop iteration. If the list can not grow, the connection is
+ *       flushed right away instead.
+ * Params:
+ *   worker - worker owning the connection
+ *   connection - connection with queued output
  */
-int sendData(int socketFd, struct packet_data *data, int timeout) {
-    int sentBits = send(socketFd, data, sizeof(struct packet_data), 0);
+void markDirty(struct worker *worker, struct connection *connection) {
+    if (connection->dirty) return;
 
-    if (sentBits < sizeof(struct packet_data) && timeout > 0) {
-        return (sendData(socketFd, data, timeout) == sizeof(struct packet_data)) - 1;
+    if (worker->dirtyCount == worker->dirtyCapacity) {
+        int capacity = worker->dirtyCapacity == 0 ? INITIAL_DIRTY_CAPACITY : worker->dirtyCapacity * 2;
+        uint64_t *dirty = realloc(worker->dirty, capacity * sizeof(uint64_t));
+
+        if (dirty == NULL) {
+            flushConnection(worker, connection);
+            return;
+        }
+
+        worker->dirty = dirty;
+        worker->dirtyCapacity = capacity;
     }
-    return (sentBits == sizeof(struct packet_data)) - 1;
+
+    connection->dirty = 1;
+    worker->dirty[worker->dirtyCount++] = poolHandle(connection);
 }
 
 /*
- * Desc: Handles connections: accepts new ones, closes disconnected and receives data from existing ones.
+ * Desc: Flushes every connection that got output during the loop iteration. The list holds pool handles, so
+ *       connections closed or handed over meanwhile no longer resolve and are skipped.
  * Params:
- *   listener - file descriptor of listener socket
- *   master - master file descriptor set of all sockets
- *   buffer - char buffer for receiving data from an incoming packet
- *   gameRunning - state of game loop
- * Returns:
- *   DEFAULT_ERROR_RETURN - if error occurred
+ *   worker - worker whose dirty connections are flushed
+ */
+void flushDirtyConnections(struct worker *worker) {
+    for (int i = 0; i < worker->dirtyCount; i++) {
+        struct connection *connection = poolResolve(&worker->rooms.connectionPool, worker->dirty[i]);
+        if (connection == NULL || !connection->dirty) continue;
+
+        connection->dirty = 0;
+        flushConnection(worker, connection);
+    }
+
+    worker->dirtyCount = 0;
+}
+
+/*
+ * Desc: Sends the queued output of a connection, then the broadcasts queued for a spectator, as far as the socket
+ *       accepts them without blocking. A fully sent output buffer goes back to the buffer pool.
+ * Params:
+ *   worker - worker owning the connection
+ *   connection - connection to flush
+ * Returns: 0 if flushed or the socket is full, -1 if the connection failed and was dropped
+ */
+int flushConnection(struct worker *worker, struct connection *connection) {
+    struct feed *feed = connection->feed;
+    int queuedBytes, pendingBytes = 0;
+    long sentBytes;
+
+    if (connection->dropped) return DEFAULT_ERROR_RETURN;
+
+    if (connection->output != NULL) {
+        queuedBytes = (int) (connection->output->tail - connection->output->head);
+        countMetric(&worker->metrics, METRIC_WRITE_CALLS, 1);
+
+        if ((pendingBytes = sendQueued(&worker->loop, connection->fileDescriptor, connection->output)) < 0) {
+            traceEvent(worker->traceRing, TRACE_INFO, "Unable to send data to a connection. Errno: %d\n", errno, 0, 0);
+            dropConnection(connection);
+            return DEFAULT_ERROR_RETURN;
+        }
+
+        countMetric(&worker->metrics, METRIC_BYTES_SENT, queuedBytes - pendingBytes);
+        if (pendingBytes == 0) releaseOutput(&worker->rooms, connection);
+    }
+
+    // Broadcasts follow the snapshot a spectator got on subscribing, so they wait until the output buffer is empty.
+    if (pendingBytes > 0 || feed == NULL || feed->tail == feed->head) return DEFAULT_RETURN;
+    countMetric(&worker->metrics, METRIC_WRITE_CALLS, 1);
+
+    if ((sentBytes = flushFeed(connection->fileDescriptor, feed, &worker->rooms.broadcastPool)) < 0) {
+        traceEvent(worker->traceRing, TRACE_INFO, "Unable to send data to a connection. Errno: %d\n", errno, 0, 0);
+        dropConnection(connection);
+        return DEFAULT_ERROR_RETURN;
+    }
+
+    countMetric(&worker->metrics, METRIC_BYTES_SENT, sentBytes);
+    if (feed->tail != feed->head) waitWritable(&worker->loop, connection->fileDescriptor);
+    return DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Handles a write event of a connection: removes the bytes a completed send took from its output buffer and
+ *       marks the connection for flushing the rest.
+ * Params:
+ *   worker - worker owning the connection
+ *   connection - connection that became writable
+ */
+void completeSend(struct worker *worker, struct connection *connection) {
+    int sentBytes = takeSentBytes(&worker->loop);
+
+    if (sentBytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+    if (sentBytes < 0) {
+        traceEvent(worker->traceRing, TRACE_INFO, "Unable to send data to a connection. Errno: %d\n", errno, 0, 0);
+        dropConnection(connection);
+        return;
+    }
+
+    if (connection->output != NULL) connection->output->head += sentBytes;
+    countMetric(&worker->metrics, METRIC_BYTES_SENT, sentBytes);
+    markDirty(worker, connection);
+}
+
+/*
+ * Desc: Shuts a connection down without closing it. The shutdown wakes the event loop with a disconnect, which cleans
+ *       up the connection like any other.
+ * Params:
+ *   connection - connection to drop
+ */
+void dropConnection(struct connection *connection) {
+    connection->dropped = 1;
+    shutdown(connection->fileDescriptor, SHUT_RDWR);
+}
+
+/*
+ * Desc: Handles connections: accepts new ones, closes disconnected and receives data from existing ones. Every ready
+ *       descriptor of a wakeup is drained into the batch; descriptors that do not fit are serviced by the next call
+ *       before waiting again.
+ * Params:
+ *   worker - worker whose listener, mailbox and connections are handled; its batch is filled with the events
+ *   timeoutMs - maximum time to wait for events, -1 to wait indefinitely
+ * Returns: -1 if error occurred, number of events in the batch otherwise. Each event is classified as
  *   10 - if a new connection was handled
  *   20 - if data was received from an existing connection
  *   21 - if an existing connection disconnected
  */
-int handleConnections(int listener, fd_set *master, int *maxFd, struct received *data, int *gameRunning) {
-    fd_set readFds = *master;
-    int newFd;
+int handleConnections(struct worker *worker, int timeoutMs) {
+    struct eventLoop *loop = &worker->loop;
+    struct eventBatch *batch = worker->batch;
+    int listener = worker->listener;
+    int readyFd;
+    struct received *event;
+    int waiting = nextReadyDescriptor(loop) < 0;
+    batch->count = 0;
+
+    if (waitForEvents(loop, timeoutMs) < 0) {
+        traceEvent(worker->traceRing, TRACE_INFO, "Unable to handle an incoming connection. Errno: %d\n", errno, 0, 0);
+        return -1;
+    }
 
-    if (select(*maxFd + 1, &readFds, NULL, NULL, NULL) < 0) {
-        handleError(errno, 5);
-        return DEFAULT_ERROR_RETURN;
+    if (waiting) {
+        worker->wakeupUs = monotonicUs();
+        countMetric(&worker->metrics, METRIC_WAIT_CALLS, 1);
     }
 
-    for (int i = 0; i <= *maxFd; i++) {
-        if (FD_ISSET(i, &readFds)) {
-            if (i == listener) {
+    while ((readyFd = nextReadyDescriptor(loop)) >= 0 && (event = nextBatchEvent(batch)) != NULL) {
+        if (readyFd == listener) {
+            int newFd = handleNewConnection(worker);
+            countMetric(&worker->metrics, METRIC_ACCEPT_CALLS, 1);
 
-                if ((newFd = handleNewConnection(listener, master, maxFd)) < 0) {
-                    return DEFAULT_ERROR_RETURN;
+            if (newFd >= 0) {
+                traceEvent(worker->traceRing, TRACE_DEBUG, "New connection %d incoming.\n", newFd, 0, 0);
+                countMetric(&worker->metrics, METRIC_CONNECTIONS_ACCEPTED, 1);
+                event->connectionType = NEW_CONNECTION;
+                event->fileDescriptor = newFd;
+
+            } else {
+                // Pending connections that failed to be accepted are left in the backlog of the listener.
+                batch->count--;
+                markDrained(loop);
+            }
 
-                } else {
-                    data->fileDescriptor = newFd;
-                    return NEW_CONNECTION;
+        } else if (readyFd == worker->mailbox.eventFd) {
+            batch->count--;
+            handleHandoffs(worker);
+            markDrained(loop);
 
-                }
+        } else {
+            struct connection *connection = findConnection(&worker->rooms, readyFd);
+            if (connection != NULL && takeReadyEvents(loop, EPOLLOUT)) completeSend(worker, connection);
 
-            } else {
-                int receivedBits = handleExistingConnection(i, master, maxFd, data);
-                if (receivedBits < 0) {
-                    return DEFAULT_ERROR_RETURN;
+            int receivedBits = handleExistingConnection(worker, readyFd, event);
+            if (receivedBits == -2) {
+                batch->count--;
+                markDrained(loop);
 
-                } else if (receivedBits == 0) {
-                    return DISCONNECTED;
+            } else if (receivedBits <= 0) {
+                event->connectionType = DISCONNECTED;
+                markDrained(loop);
 
-                } else {
-                    return NEW_DATA;
+            } else {
+                event->connectionType = NEW_DATA;
 
-                }
             }
         }
     }
 
-    return DEFAULT_ERROR_RETURN;
+    return batch->count;
 }
 
 /*
- * Desc: Handles data from existing connections: transfers incoming data from packets to buffer and terminates
- *       disconnected connections.
+ * Desc: Reserves the next event slot of a batch.
  * Params:
- *   incomingFd - the file descriptor of connection from which the data is coming
- *   master - master set of all file descriptors
- *   maxFd - maximum file descriptor currently in use
- *   data - data buffer to be filled with packet data
+ *   batch - batch to reserve the slot in
+ * Returns: the reserved event or NULL if the batch is full
  */
-int handleExistingConnection(int incomingFd, fd_set *master, int *maxFd, struct received *data) {
-    if (DEBUG) printf("Existing connection incoming.\n");
-    int recv_bits = recv(incomingFd, data->data, sizeof(struct packet_data), 0);
-
-    if (recv_bits < 0) {
-        handleError(errno, 7);
-        close(incomingFd);
-        FD_CLR(incomingFd, master);
-        return DEFAULT_ERROR_RETURN;
-
-    } else if (recv_bits == 0) {
-        //TODO: Change the maxFD to be actual maxFD
-        data->fileDescriptor = incomingFd;
-        data->dataLength = 0;
+struct received *nextBatchEvent(struct eventBatch *batch) {
+    if (batch->count >= MAX_BATCH_SIZE) return NULL;
+
+    struct received *event = &batch->events[batch->count];
+    memset(event, 0, sizeof(struct received));
+    event->data = &batch->packets[batch->count];
+    batch->count++;
+    return event;
+}
 
-        close(incomingFd);
-        FD_CLR(incomingFd, master);
-        return 0;
+/*
+ * Desc: Handles data from existing connections: decodes the next message buffered for the connection and reads more
+ *       data only once no complete frame is left, so frames pipelined into a single read are handed out one by one.
+ *       Disconnected connections and connections sending malformed or server-bound messages are terminated.
+ * Params:
+ *   worker - worker owning the connection
+ *   incomingFd - the file descriptor of connection from which the data is coming. Disconnected descriptors are
+ *                removed from the loop and have to be closed by the caller.
+ *   data - data buffer to be filled with packet data
+ * Returns: -2 if no more data is pending, -1 if error, 0 if disconnected, size of the decoded packet otherwise
+ */
+int handleExistingConnection(struct worker *worker, int incomingFd, struct received *data) {
+    struct connection *connection = findConnection(&worker->rooms, incomingFd);
+    int type, receivedBytes;
+
+    // Descriptors handed over to another worker within the same wakeup are not ours to read anymore.
+    if (connection == NULL) return -2;
+
+    data->fileDescriptor = incomingFd;
+    data->dataLength = 0;
+
+    while ((type = receiveMessage(&connection->input, data->data)) == -2) {
+        traceEvent(worker->traceRing, TRACE_DEBUG, "Existing connection %d incoming.\n", incomingFd, 0, 0);
+        receivedBytes = receiveReady(&worker->loop, incomingFd, &connection->input);
+        countMetric(&worker->metrics, METRIC_READ_CALLS, 1);
+        if (receivedBytes > 0) countMetric(&worker->metrics, METRIC_BYTES_RECEIVED, receivedBytes);
+
+        if (receivedBytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return -2;
+
+        } else if (receivedBytes < 0) {
+            traceEvent(worker->traceRing, TRACE_INFO, "Unable to handle data from an existing connection. Errno: %d\n",
+                       errno, 0, 0);
+            unwatchDescriptor(&worker->loop, incomingFd);
+            return -1;
+
+        } else if (receivedBytes == 0) {
+            unwatchDescriptor(&worker->loop, incomingFd);
+            return 0;
+        }
+    }
 
-    } else {
-        data->fileDescriptor = incomingFd;
-        data->dataLength = recv_bits;
-        return recv_bits;
+    if (type != MESSAGE_JOIN && type != MESSAGE_MOVE && type != MESSAGE_SPECTATE && type != MESSAGE_RESUME) {
+        traceEvent(worker->traceRing, TRACE_INFO, "Received a malformed frame. Errno: %d\n", EPROTO, 0, 0);
+        unwatchDescriptor(&worker->loop, incomingFd);
+        return -1;
     }
+
+    data->dataLength = sizeof(struct packet_data);
+    return data->dataLength;
 }
 
 /*
  * Desc: Accepts a new connection and assigns a new file descriptor to it.
  * Params:
- *   listener - listener file descriptor
- *   master - the master set of all active file descriptors
- *   maxFd - the maximum file descriptor currently in use
- * Returns: -1 if error, new file descriptor otherwise.
+ *   worker - worker whose listener has a connection pending; the new connection is registered with its event loop
+ * Returns: -2 if no connection is pending, -1 if error, new file descriptor otherwise.
  */
-int handleNewConnection(int listener, fd_set *master, int *maxFd) {
-    if (DEBUG) printf("New connection incoming\n");
-    struct socaddr_storage *remoteAddress;
-    socklen_t addr_size = sizeof(remoteAddress);
+int handleNewConnection(struct worker *worker) {
+    struct eventLoop *loop = &worker->loop;
+    int newFd = acceptConnection(loop, worker->listener);
+
+    if (newFd == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return -2;
 
-    int newFd = accept(listener, (struct sockaddr *) remoteAddress, &addr_size);
+    } else if (newFd == -1) {
+        traceEvent(worker->traceRing, TRACE_INFO, "Unable to accept a new connection. Errno: %d\n", errno, 0, 0);
+        return DEFAULT_ERROR_RETURN;
 
-    if (newFd == -1) {
-        handleError(errno, 6);
+    } else if (watchConnection(loop, newFd) != 0) {
+        traceEvent(worker->traceRing, TRACE_INFO, "Unable to accept a new connection. Errno: %d\n", errno, 0, 0);
+        close(newFd);
         return DEFAULT_ERROR_RETURN;
+
     } else {
-        FD_SET(newFd, master);
-        if (newFd > *maxFd) *maxFd = newFd;
         return newFd;
     }
 }
 
+/*
+ * Desc: Raises the soft limit of open file descriptors to the hard limit, so a single process can hold as many idle
+ *       players as the system allows.
+ */
+void raiseDescriptorLimit() {
+    struct rlimit limit;
+
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
 /*
  * Desc: Function binds to first available address info
  * Params:
  *   ai - pointer to address info linked list
  *   listener - listener that has been binded to
+ *   reusePort - 1 to let several listeners share the port, so the kernel balances connections between them
  */
-int bindToPort(struct addrinfo *ai, int *listener) {
-    //TODO: Handle port reusing scenario
-
+int bindToPort(struct addrinfo *ai, int *listener, int reusePort) {
     struct addrinfo *curr;
+    int enabled = 1;
 
     for (curr = ai; curr != NULL; curr = curr->ai_next) {
 
         *listener = socket(curr->ai_family, curr->ai_socktype, curr->ai_protocol);
         if (*listener < 0) continue;
 
+        if (setsockopt(*listener, SOL_SOCKET, SO_REUSEADDR, &enabled, sizeof(enabled)) != 0 ||
+            (reusePort && setsockopt(*listener, SOL_SOCKET, SO_REUSEPORT, &enabled, sizeof(enabled)) != 0)) {
+            close(*listener);
+            continue;
+        }
+
         int bindError = bind(*listener, curr->ai_addr, curr->ai_addrlen);
         if (bindError < 0) {
             close(*listener);
@@ -636,7 +2272,8 @@ void prepareAddrinfoHints(struct addrinfo *info) {
 }
 
 /*
- * Desc: Function handles errors.
+ * Desc: Function handles errors of the server start-up on the main thread. Workers trace their errors instead, so
+ *       no client can make them print to the console.
  * Params:
  *   errorCode - code provided by the method that threw the exception
  *   errorType - type of function that threw the code
@@ -646,9 +2283,12 @@ void prepareAddrinfoHints(struct addrinfo *info) {
  *   2. Get address info
  *   3. Bind to port
  *   4. Listen for connection
- *   5. Connection handler
- *      6. New connection handler
- *      7. Existing connection handler
+ *   8. Room table allocation
+ *   9. Event loop setup
+ *   10. Command line options
+ *   11. Worker thread start
+ *   14. Match log
+ *   15. Snapshot recovery
  *
  */
 void handleError(int errorCode, int errorType) {
@@ -669,16 +2309,32 @@ void handleError(int errorCode, int errorType) {
             printf("Unable to listen. Errno: %d\n", errorCode);
             break;
 
-        case 5:
-            printf("Unable to handle an incoming connection. Errno: %d\n", errorCode);
+        case 8:
+            printf("Unable to allocate the room table. Errno: %d\n", errorCode);
+            break;
+
+        case 9:
+            printf("Unable to set up the event loop. Errno: %d\n", errorCode);
+            break;
+
+        case 10:
+            printf("Usage: Server [-w workers] [-r rooms] [-a AI delay] [-t turn timeout] [-l match log] [-s "
+                   "snapshot] [-u] [-v trace level] port. Workers must be between 0 (one per CPU) and %d, rooms per "
+                   "worker 0 (no limit) or more, AI delay 0 or more milliseconds, turn timeout 0 (no limit) or more "
+                   "milliseconds (default %d), trace level 0 (off), 1 (info, default) or 2 (debug). -u uses io_uring "
+                   "instead of epoll.\n", MAX_WORKERS, TURN_TIMEOUT);
+            break;
+
+        case 11:
+            printf("Unable to start a worker thread. Errno: %d\n", errorCode);
             break;
 
-        case 6:
-            printf("Unable to accept a new connection. Errno: %d\n", errorCode);
+        case 14:
+            printf("Unable to open the match log. Errno: %d\n", errorCode);
             break;
 
-        case 7:
-            printf("Unable to handle data from an existing connection. Errno: %d\n", errorCode);
+        case 15:
+            printf("Unable to recover the matches of the snapshot. Errno: %d\n", errorCode);
             break;
 
         default:
@@ -0,0 +1,283 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "common.h"
+#include "matchLog.h"
+
+void *runLogWriter(void *argument);
+
+int drainLogRings(struct matchLog *log);
+
+int writeLogBatch(int fileDescriptor, const uint8_t *bytes, size_t length);
+
+int prepareLogHeader(int fileDescriptor, uint64_t *epochMs);
+
+long long logClockMs(clockid_t clock);
+
+/*
+ * Desc: Opens or creates the match log and prepares one ring per worker. Records appended to an existing log keep
+ *       counting time from the epoch in its header.
+ * Params:
+ *    log - log to open
+ *    path - path of the log file
+ *    ringCount - number of workers appending records
+ * Returns: 0 if opened, 1 if error occurred with errno set
+ */
+int openMatchLog(struct matchLog *log, const char *path, int ringCount) {
+    uint64_t epochMs;
+    long long epochUs;
+
+    memset(log, 0, sizeof(struct matchLog));
+    log->ringCount = ringCount;
+    atomic_init(&log->stopping, 0);
+
+    if ((log->fileDescriptor = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644)) < 0) {
+        return DEFAULT_ERROR_RETURN;
+    }
+
+    log->rings = aligned_alloc(64, ringCount * sizeof(struct logRing));
+    log->batch = malloc(MATCH_LOG_BATCH_RECORDS * MATCH_LOG_RECORD_SIZE);
+    if (log->rings == NULL || log->batch == NULL || prepareLogHeader(log->fileDescriptor, &epochMs) != 0) {
+        closeMatchLog(log);
+        return DEFAULT_ERROR_RETURN;
+    }
+
+    // Records are stamped with the monotonic clock of the workers, so the epoch is moved onto that clock once.
+    epochUs = (logClockMs(CLOCK_MONOTONIC) - (logClockMs(CLOCK_REALTIME) - (long long) epochMs)) * 1000;
+    for (int i = 0; i < ringCount; i++) {
+        atomic_init(&log->rings[i].tail, 0);
+        atomic_init(&log->rings[i].head, 0);
+        log->rings[i].epochUs = epochUs;
+    }
+
+    return DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Starts the writer thread of an open log.
+ * Params:
+ *    log - open log
+ * Returns: 0 if started, otherwise the error of pthread_create
+ */
+int startMatchLog(struct matchLog *log) {
+    int error = pthread_create(&log->writer, NULL, runLogWriter, log);
+    log->writing = error == 0;
+    return error;
+}
+
+/*
+ * Desc: Stops the writer thread once it has written and synced every record still queued, then closes the log. The
+ *       workers must not append anymore.
+ * Params:
+ *    log - log to close
+ */
+void closeMatchLog(struct matchLog *log) {
+    if (log->writing) {
+        atomic_store(&log->stopping, 1);
+        pthread_join(log->writer, NULL);
+        log->writing = 0;
+    }
+
+    if (log->fileDescriptor >= 0) close(log->fileDescriptor);
+    log->fileDescriptor = -1;
+    free(log->rings);
+    free(log->batch);
+    log->rings = NULL;
+    log->batch = NULL;
+}
+
+/*
+ * Desc: Queues a record for the writer thread. Called by the worker owning the ring only; never blocks.
+ * Params:
+ *    ring - ring of the calling worker
+ *    matchId - match the record belongs to
+ *    timeUs - monotonic time of the event in microseconds
+ *    type - MATCH_LOG_START, MATCH_LOG_MOVE or MATCH_LOG_RESULT
+ *    a, b, c - fields of the record, see struct logRecord
+ * Returns: 0 if queued, -1 if the ring is full and the record was dropped
+ */
+int appendLogRecord(struct logRing *ring, uint64_t matchId, long long timeUs, int type, int a, int b, int c) {
+    unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    struct logRecord record;
+
+    if (tail - atomic_load_explicit(&ring->head, memory_order_acquire) == MATCH_LOG_RING_CAPACITY) return -1;
+
+    record.matchId = matchId;
+    record.elapsedMs = (uint64_t) ((timeUs - ring->epochUs) / 1000);
+    record.type = (uint8_t) type;
+    record.fields[0] = (uint8_t) a;
+    record.fields[1] = (uint8_t) b;
+    record.fields[2] = (uint8_t) c;
+    encodeLogRecord(&record, ring->records[tail & (MATCH_LOG_RING_CAPACITY - 1)]);
+
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Encodes a record in the byte order of the log file.
+ * Params:
+ *    record - record to encode
+ *    bytes - MATCH_LOG_RECORD_SIZE bytes to fill
+ */
+void encodeLogRecord(const struct logRecord *record, uint8_t *bytes) {
+    storeLittleEndian(bytes, record->matchId, 8);
+    storeLittleEndian(bytes + 8, record->elapsedMs, 8);
+    bytes[16] = record->type;
+    memcpy(bytes + 17, record->fields, 3);
+}
+
+/*
+ * Desc: Decodes a record of the log file.
+ * Params:
+ *    bytes - MATCH_LOG_RECORD_SIZE bytes of the record
+ *    record - filled with the record
+ */
+void decodeLogRecord(const uint8_t *bytes, struct logRecord *record) {
+    record->matchId = loadLittleEndian(bytes, 8);
+    record->elapsedMs = loadLittleEndian(bytes + 8, 8);
+    record->type = bytes[16];
+    memcpy(record->fields, bytes + 17, 3);
+}
+
+/*
+ * Desc: Reads the epoch of a log from its header.
+ * Params:
+ *    header - MATCH_LOG_HEADER_SIZE bytes at the start of the log
+ * Returns: epoch in Unix milliseconds or 0 if the header is not a match log header
+ */
+uint64_t decodeLogEpoch(const uint8_t *header) {
+    if (memcmp(header, MATCH_LOG_MAGIC, 8) != 0) return 0;
+    return loadLittleEndian(header + 8, 8);
+}
+
+/*
+ * Desc: Writer thread of the log: moves the records of all rings to the file in batches and syncs the file at most
+ *       every MATCH_LOG_SYNC_INTERVAL, and right away once the log is stopping.
+ * Params:
+ *    argument - the log to write
+ * Returns: NULL
+ */
+void *runLogWriter(void *argument) {
+    struct matchLog *log = argument;
+    struct timespec idle = {0, MATCH_LOG_IDLE_SLEEP * 1000000L};
+    long long syncedMs = logClockMs(CLOCK_MONOTONIC);
+    int unsynced = 0;
+
+    while (1) {
+        int stopping = atomic_load(&log->stopping);
+        int recordCount = drainLogRings(log);
+
+        if (recordCount > 0 &&
+            writeLogBatch(log->fileDescriptor, log->batch, recordCount * MATCH_LOG_RECORD_SIZE) != 0) {
+            printf("Unable to write the match log. Errno: %d\n", errno);
+        }
+        unsynced |= recordCount > 0;
+
+        if (unsynced && (stopping || logClockMs(CLOCK_MONOTONIC) - syncedMs >= MATCH_LOG_SYNC_INTERVAL)) {
+            if (fdatasync(log->fileDescriptor) != 0) printf("Unable to sync the match log. Errno: %d\n", errno);
+            syncedMs = logClockMs(CLOCK_MONOTONIC);
+            unsynced = 0;
+        }
+
+        if (recordCount == MATCH_LOG_BATCH_RECORDS) continue;
+        if (stopping && recordCount == 0) break;
+        if (recordCount == 0) nanosleep(&idle, NULL);
+    }
+
+    return NULL;
+}
+
+/*
+ * Desc: Copies queued records of all rings into the batch buffer of the log, taking from every ring in turn.
+ * Params:
+ *    log - log whose rings to drain
+ * Returns: number of records copied
+ */
+int drainLogRings(struct matchLog *log) {
+    int recordCount = 0;
+
+    for (int i = 0; i < log->ringCount && recordCount < MATCH_LOG_BATCH_RECORDS; i++) {
+        struct logRing *ring = &log->rings[i];
+        unsigned int head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+        for (; head != tail && recordCount < MATCH_LOG_BATCH_RECORDS; head++, recordCount++) {
+            memcpy(log->batch + recordCount * MATCH_LOG_RECORD_SIZE,
+                   ring->records[head & (MATCH_LOG_RING_CAPACITY - 1)], MATCH_LOG_RECORD_SIZE);
+        }
+        atomic_store_explicit(&ring->head, head, memory_order_release);
+    }
+
+    return recordCount;
+}
+
+/*
+ * Desc: Appends a batch to the log file, retrying short writes.
+ * Params:
+ *    fileDescriptor - log file opened for appending
+ *    bytes - records to write
+ *    length - number of bytes
+ * Returns: 0 if written, 1 if error occurred with errno set
+ */
+int writeLogBatch(int fileDescriptor, const uint8_t *bytes, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fileDescriptor, bytes, length);
+        if (written < 0 && errno == EINTR) continue;
+        if (written < 0) return DEFAULT_ERROR_RETURN;
+
+        bytes += written;
+        length -= written;
+    }
+    return DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Writes the header of a new log, or reads the epoch of an existing one. An existing log is cut back to its
+ *       last complete record, in case the server stopped in the middle of a write.
+ * Params:
+ *    fileDescriptor - log file
+ *    epochMs - filled with the epoch of the log in Unix milliseconds
+ * Returns: 0 if the log is ready for appending, 1 if it is not a match log or error occurred
+ */
+int prepareLogHeader(int fileDescriptor, uint64_t *epochMs) {
+    uint8_t header[MATCH_LOG_HEADER_SIZE];
+    struct stat status;
+
+    if (fstat(fileDescriptor, &status) != 0) return DEFAULT_ERROR_RETURN;
+
+    if (status.st_size == 0) {
+        *epochMs = (uint64_t) logClockMs(CLOCK_REALTIME);
+        memcpy(header, MATCH_LOG_MAGIC, 8);
+        storeLittleEndian(header + 8, *epochMs, 8);
+        return writeLogBatch(fileDescriptor, header, MATCH_LOG_HEADER_SIZE);
+    }
+
+    if (status.st_size < MATCH_LOG_HEADER_SIZE ||
+        pread(fileDescriptor, header, MATCH_LOG_HEADER_SIZE, 0) != MATCH_LOG_HEADER_SIZE ||
+        (*epochMs = decodeLogEpoch(header)) == 0) {
+        errno = EINVAL;
+        return DEFAULT_ERROR_RETURN;
+    }
+
+    off_t complete = status.st_size - (status.st_size - MATCH_LOG_HEADER_SIZE) % MATCH_LOG_RECORD_SIZE;
+    if (complete != status.st_size && ftruncate(fileDescriptor, complete) != 0) return DEFAULT_ERROR_RETURN;
+    return DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Reads a clock with millisecond resolution.
+ * Params:
+ *    clock - CLOCK_MONOTONIC or CLOCK_REALTIME
+ * Returns: milliseconds of the clock
+ */
+long long logClockMs(clockid_t clock) {
+    struct timespec now;
+    clock_gettime(clock, &now);
+    return (long long) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
@@ -0,0 +1,81 @@
+#ifndef SERVER_MATCH_LOG_H
+#define SERVER_MATCH_LOG_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#define MATCH_LOG_MAGIC "TTTMLOG2"
+#define MATCH_LOG_HEADER_SIZE 16
+#define MATCH_LOG_RECORD_SIZE 20
+#define MATCH_LOG_RING_CAPACITY 8192 // power of two, records a worker may get ahead of the writer before dropping
+#define MATCH_LOG_BATCH_RECORDS 4096 // records the writer gathers into one write
+#define MATCH_LOG_IDLE_SLEEP 5 // milliseconds the writer sleeps when every ring is empty
+#define MATCH_LOG_SYNC_INTERVAL 100 // milliseconds between two fsyncs of written records
+
+#define MATCH_LOG_START 1
+#define MATCH_LOG_MOVE 2
+#define MATCH_LOG_RESULT 3
+
+#define MATCH_RESULT_DRAW 2
+#define MATCH_RESULT_ABANDONED 3
+
+/*
+ * Record of the match log, 20 bytes in little-endian order:
+ *    0-7   match id, the index of the worker in the top 8 bits
+ *    8-15  milliseconds since the epoch in the header of the log, wide enough for a log appended to for ever
+ *    16    type: MATCH_LOG_START, MATCH_LOG_MOVE or MATCH_LOG_RESULT
+ *    17-19 start: board size, win length, 1 if played against the AI opponent
+ *          move: player (0 or 1), x, y
+ *          result: winner (0 or 1), MATCH_RESULT_DRAW or MATCH_RESULT_ABANDONED, the player who left an abandoned
+ *          match, one unused byte
+ * The log starts with a 16 byte header: MATCH_LOG_MAGIC and the epoch in Unix milliseconds.
+ */
+struct logRecord {
+    uint64_t matchId;
+    uint64_t elapsedMs;
+    uint8_t type;
+    uint8_t fields[3];
+};
+
+/*
+ * Encoded records from one worker to the writer thread. The worker only moves the tail and the writer only the head,
+ * so neither ever waits for the other; a worker finding the ring full drops the record instead of blocking.
+ */
+struct logRing {
+    _Alignas(64) atomic_uint tail;
+    _Alignas(64) atomic_uint head;
+    long long epochUs;
+    uint8_t records[MATCH_LOG_RING_CAPACITY][MATCH_LOG_RECORD_SIZE];
+};
+
+/*
+ * Append-only match log written by a background thread. The writer gathers the records of all worker rings into
+ * batches, appends each batch with one write and syncs the file at most every MATCH_LOG_SYNC_INTERVAL, so one fsync
+ * covers every batch written since the previous one and disk I/O never runs on a worker.
+ */
+struct matchLog {
+    int fileDescriptor;
+    int ringCount;
+    struct logRing *rings;
+    uint8_t *batch;
+    pthread_t writer;
+    int writing;
+    atomic_int stopping;
+};
+
+int openMatchLog(struct matchLog *log, const char *path, int ringCount);
+
+int startMatchLog(struct matchLog *log);
+
+void closeMatchLog(struct matchLog *log);
+
+int appendLogRecord(struct logRing *ring, uint64_t matchId, long long timeUs, int type, int a, int b, int c);
+
+void encodeLogRecord(const struct logRecord *record, uint8_t *bytes);
+
+void decodeLogRecord(const uint8_t *bytes, struct logRecord *record);
+
+uint64_t decodeLogEpoch(const uint8_t *header);
+
+#endif
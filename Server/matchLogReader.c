@@ -0,0 +1,314 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "common.h"
+#include "board.h"
+#include "matchLog.h"
+
+/*
+ * Reader of the match log written by the server with -l. The log is mapped into memory and its fixed-size records are
+ * decoded in place, so a replay or a summary of millions of moves is one sequential pass over the page cache without
+ * copying or parsing text.
+ */
+
+#define MODE_SUMMARY 0
+#define MODE_DUMP 1
+#define MODE_REPLAY 2
+
+/*
+ * Totals over every record of a log.
+ */
+struct logSummary {
+    long records;
+    long matches;
+    long aiMatches;
+    long moves;
+    long results[MATCH_RESULT_ABANDONED + 1];
+    long variantMatches[VARIANT_COUNT];
+    uint64_t firstMs;
+    uint64_t lastMs;
+};
+
+void handleError(int errorCode, int errorType);
+
+const uint8_t *mapLog(const char *path, size_t *length);
+
+void summarizeLog(const uint8_t *records, long recordCount);
+
+void dumpLog(const uint8_t *records, long recordCount, uint64_t epochMs);
+
+int replayMatch(const uint8_t *records, long recordCount, uint64_t matchId);
+
+void printRecord(const struct logRecord *record, uint64_t epochMs);
+
+int main(int argc, char *argv[]) {
+    int option, mode = MODE_SUMMARY;
+    uint64_t matchId = 0, epochMs;
+    const uint8_t *log;
+    char *end;
+    size_t length;
+    long recordCount;
+
+    while ((option = getopt(argc, argv, "dm:")) != -1) {
+        if (option == 'd') {
+            mode = MODE_DUMP;
+        } else if (option == 'm' && (matchId = strtoull(optarg, &end, 0), *optarg != 0 && *end == 0)) {
+            mode = MODE_REPLAY;
+        } else {
+            handleError(EINVAL, 1);
+            return DEFAULT_ERROR_RETURN;
+        }
+    }
+
+    if (optind >= argc) {
+        handleError(EINVAL, 1);
+        return DEFAULT_ERROR_RETURN;
+    }
+
+    if ((log = mapLog(argv[optind], &length)) == NULL) return DEFAULT_ERROR_RETURN;
+
+    if (length < MATCH_LOG_HEADER_SIZE || (epochMs = decodeLogEpoch(log)) == 0) {
+        handleError(EINVAL, 3);
+        return DEFAULT_ERROR_RETURN;
+    }
+
+    // A record cut off by a crash of the server is left out; the server drops it too when it appends again.
+    recordCount = (long) ((length - MATCH_LOG_HEADER_SIZE) / MATCH_LOG_RECORD_SIZE);
+
+    if (mode == MODE_DUMP) {
+        dumpLog(log + MATCH_LOG_HEADER_SIZE, recordCount, epochMs);
+    } else if (mode == MODE_REPLAY && replayMatch(log + MATCH_LOG_HEADER_SIZE, recordCount, matchId) != 0) {
+        handleError(ENOENT, 4);
+        return DEFAULT_ERROR_RETURN;
+    } else if (mode == MODE_SUMMARY) {
+        summarizeLog(log + MATCH_LOG_HEADER_SIZE, recordCount);
+    }
+
+    munmap((void *) log, length);
+    return DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Maps a log file read-only into memory and tells the kernel it is read front to back.
+ * Params:
+ *    path - path of the log
+ *    length - filled with the length of the log in bytes
+ * Returns: start of the mapped log or NULL if error occurred
+ */
+const uint8_t *mapLog(const char *path, size_t *length) {
+    struct stat status;
+    void *log;
+    int fileDescriptor = open(path, O_RDONLY | O_CLOEXEC);
+
+    if (fileDescriptor < 0 || fstat(fileDescriptor, &status) != 0) {
+        handleError(errno, 2);
+        if (fileDescriptor >= 0) close(fileDescriptor);
+        return NULL;
+    }
+
+    *length = (size_t) status.st_size;
+    if (*length == 0) {
+        close(fileDescriptor);
+        handleError(EINVAL, 3);
+        return NULL;
+    }
+
+    log = mmap(NULL, *length, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+    close(fileDescriptor);
+    if (log == MAP_FAILED) {
+        handleError(errno, 2);
+        return NULL;
+    }
+
+    madvise(log, *length, MADV_SEQUENTIAL);
+    return log;
+}
+
+/*
+ * Desc: Prints the number of matches, moves and results of a log and how the matches spread over the board variants.
+ * Params:
+ *    records - first record of the log
+ *    recordCount - number of records
+ */
+void summarizeLog(const uint8_t *records, long recordCount) {
+    struct logSummary summary;
+    struct logRecord record;
+    long finished;
+    double seconds;
+
+    memset(&summary, 0, sizeof(struct logSummary));
+    summary.records = recordCount;
+
+    for (long i = 0; i < recordCount; i++) {
+        decodeLogRecord(records + i * MATCH_LOG_RECORD_SIZE, &record);
+        if (i == 0) summary.firstMs = record.elapsedMs;
+        summary.lastMs = record.elapsedMs;
+
+        if (record.type == MATCH_LOG_START) {
+            summary.matches++;
+            summary.aiMatches += record.fields[2];
+            if (record.fields[0] >= MIN_BOARD_SIZE && record.fields[0] <= MAX_BOARD_SIZE &&
+                record.fields[1] >= MIN_WIN_LENGTH && record.fields[1] <= record.fields[0]) {
+                summary.variantMatches[variantIndex(record.fields[0], record.fields[1])]++;
+            }
+        } else if (record.type == MATCH_LOG_MOVE) {
+            summary.moves++;
+        } else if (record.type == MATCH_LOG_RESULT && record.fields[0] <= MATCH_RESULT_ABANDONED) {
+            summary.results[record.fields[0]]++;
+        }
+    }
+
+    finished = summary.results[0] + summary.results[1] + summary.results[MATCH_RESULT_DRAW];
+    seconds = (summary.lastMs - summary.firstMs) / 1000.0;
+
+    printf("records: %ld, seconds: %.3f\n", summary.records, seconds);
+    printf("matches: %ld, against the AI: %ld, finished: %ld, abandoned: %ld\n", summary.matches, summary.aiMatches,
+           finished, summary.results[MATCH_RESULT_ABANDONED]);
+    printf("wins of player 0: %ld, wins of player 1: %ld, draws: %ld\n", summary.results[0], summary.results[1],
+           summary.results[MATCH_RESULT_DRAW]);
+    printf("moves: %ld, moves/s: %.0f, moves per match: %.2f\n", summary.moves,
+           seconds > 0 ? summary.moves / seconds : 0.0,
+           summary.matches > 0 ? (double) summary.moves / (double) summary.matches : 0.0);
+
+    for (int variant = 0; variant < VARIANT_COUNT; variant++) {
+        if (summary.variantMatches[variant] == 0) continue;
+        printf("variant %dx%d win %d: %ld matches\n", variantSize(variant), variantSize(variant),
+               variantWinLength(variant), summary.variantMatches[variant]);
+    }
+}
+
+/*
+ * Desc: Prints every record of a log, one per line.
+ * Params:
+ *    records - first record of the log
+ *    recordCount - number of records
+ *    epochMs - epoch of the log in Unix milliseconds
+ */
+void dumpLog(const uint8_t *records, long recordCount, uint64_t epochMs) {
+    struct logRecord record;
+
+    for (long i = 0; i < recordCount; i++) {
+        decodeLogRecord(records + i * MATCH_LOG_RECORD_SIZE, &record);
+        printRecord(&record, epochMs);
+    }
+}
+
+/*
+ * Desc: Replays one match: prints its moves with the time since the match started and draws the final board.
+ * Params:
+ *    records - first record of the log
+ *    recordCount - number of records
+ *    matchId - id of the match, as printed by the dump
+ * Returns: 0 if the match was found, 1 otherwise
+ */
+int replayMatch(const uint8_t *records, long recordCount, uint64_t matchId) {
+    char cells[MAX_BOARD_SIZE][MAX_BOARD_SIZE];
+    struct logRecord record;
+    uint64_t startMs = 0;
+    int size = 0, found = 0;
+
+    for (long i = 0; i < recordCount; i++) {
+        decodeLogRecord(records + i * MATCH_LOG_RECORD_SIZE, &record);
+        if (record.matchId != matchId) continue;
+
+        if (record.type == MATCH_LOG_START && record.fields[0] <= MAX_BOARD_SIZE) {
+            found = 1;
+            size = record.fields[0];
+            startMs = record.elapsedMs;
+            memset(cells, '.', sizeof(cells));
+            printf("match %#llx: %dx%d board, %d in a row%s\n", (unsigned long long) matchId, size, size,
+                   record.fields[1], record.fields[2] ? ", player 1 is the AI" : "");
+
+        } else if (found && record.type == MATCH_LOG_MOVE && record.fields[1] < size && record.fields[2] < size) {
+            cells[record.fields[1]][record.fields[2]] = record.fields[0] == 0 ? 'X' : 'O';
+            printf("%8.3fs player %d: %d %d\n", (record.elapsedMs - startMs) / 1000.0, record.fields[0],
+                   record.fields[1], record.fields[2]);
+
+        } else if (found && record.type == MATCH_LOG_RESULT) {
+            if (record.fields[0] == MATCH_RESULT_DRAW) printf("draw\n");
+            else if (record.fields[0] == MATCH_RESULT_ABANDONED) printf("abandoned by player %d\n", record.fields[1]);
+            else printf("player %d won\n", record.fields[0]);
+        }
+    }
+
+    for (int x = 0; x < size; x++) printf("%.*s\n", size, cells[x]);
+    return found ? DEFAULT_RETURN : DEFAULT_ERROR_RETURN;
+}
+
+/*
+ * Desc: Prints a record with its wall clock time.
+ * Params:
+ *    record - decoded record
+ *    epochMs - epoch of the log in Unix milliseconds
+ */
+void printRecord(const struct logRecord *record, uint64_t epochMs) {
+    uint64_t timeMs = epochMs + record->elapsedMs;
+    time_t seconds = (time_t) (timeMs / 1000);
+    struct tm calendar;
+    char stamp[32];
+
+    gmtime_r(&seconds, &calendar);
+    strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S", &calendar);
+    printf("%s.%03dZ %#llx ", stamp, (int) (timeMs % 1000), (unsigned long long) record->matchId);
+
+    if (record->type == MATCH_LOG_START) {
+        printf("start %dx%d win %d%s\n", record->fields[0], record->fields[0], record->fields[1],
+               record->fields[2] ? " ai" : "");
+    } else if (record->type == MATCH_LOG_MOVE) {
+        printf("move player %d %d %d\n", record->fields[0], record->fields[1], record->fields[2]);
+    } else if (record->type == MATCH_LOG_RESULT && record->fields[0] == MATCH_RESULT_DRAW) {
+        printf("result draw\n");
+    } else if (record->type == MATCH_LOG_RESULT && record->fields[0] == MATCH_RESULT_ABANDONED) {
+        printf("result abandoned by player %d\n", record->fields[1]);
+    } else if (record->type == MATCH_LOG_RESULT) {
+        printf("result player %d won\n", record->fields[0]);
+    } else {
+        printf("unknown record type %d\n", record->type);
+    }
+}
+
+/*
+ * Desc: Function handles errors.
+ * Params:
+ *   errorCode - code provided by the method that threw the exception
+ *   errorType - type of function that threw the code
+ *
+ * Error type table:
+ *   1. Usage
+ *   2. Open & map the log
+ *   3. Not a match log
+ *   4. Match not found
+ *
+ */
+void handleError(int errorCode, int errorType) {
+    switch (errorType) {
+        case 1:
+            printf("Usage: MatchLogReader [-d] [-m match id] log. Without options a summary of the log is printed, "
+                   "-d prints every record, -m replays one match. Error code: %d\n", errorCode);
+            break;
+
+        case 2:
+            printf("Unable to open the match log. Error code: %d\n", errorCode);
+            break;
+
+        case 3:
+            printf("The file is not a match log. Error code: %d\n", errorCode);
+            break;
+
+        case 4:
+            printf("The match is not in the log. Error code: %d\n", errorCode);
+            break;
+
+        default:
+            printf("Unknown error type %d. Error code: %d\n", errorType, errorCode);
+    }
+
+    printf("Error code explanation: %s\n", strerror(errorCode));
+}
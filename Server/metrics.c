@@ -0,0 +1,129 @@
+#include "metrics.h"
+
+int histogramIndex(uint64_t value);
+
+uint64_t bucketValue(int index);
+
+uint64_t valueAtPercentile(struct histogram *histogram, uint64_t total, double percentile);
+
+static const char *counterNames[METRIC_COUNTER_COUNT] = {
+        "connections_accepted", "connections_closed", "rooms_opened", "rooms_closed", "moves_played",
+        "bytes_received", "bytes_sent", "accept_calls", "read_calls", "write_calls", "wait_calls",
+        "log_records_dropped", "turns_timed_out", "idle_evictions"
+};
+
+static const char *histogramNames[METRIC_HISTOGRAM_COUNT] = {"pair_wait_us", "move_latency_us", "match_duration_us"};
+
+/*
+ * Desc: Records a value in a histogram of the calling worker.
+ * Params:
+ *    metrics - metrics of the calling worker
+ *    histogram - METRIC_ histogram to record in
+ *    value - value in microseconds, negative values count as 0
+ *    count - number of times the value occurred
+ */
+void recordValue(struct metrics *metrics, int histogram, long long value, uint64_t count) {
+    _Atomic uint64_t *bucket = &metrics->histograms[histogram].counts[histogramIndex(value < 0 ? 0 : value)];
+    atomic_store_explicit(bucket, atomic_load_explicit(bucket, memory_order_relaxed) + count, memory_order_relaxed);
+}
+
+/*
+ * Desc: Adds the counters and histograms of a worker to a snapshot.
+ * Params:
+ *    into - snapshot owned by the calling thread
+ *    from - metrics of a worker
+ */
+void mergeMetrics(struct metrics *into, struct metrics *from) {
+    for (int i = 0; i < METRIC_COUNTER_COUNT; i++) {
+        into->counters[i] += atomic_load_explicit(&from->counters[i], memory_order_relaxed);
+    }
+
+    for (int i = 0; i < METRIC_HISTOGRAM_COUNT; i++) {
+        for (int j = 0; j < HISTOGRAM_BUCKETS; j++) {
+            into->histograms[i].counts[j] += atomic_load_explicit(&from->histograms[i].counts[j],
+                                                                  memory_order_relaxed);
+        }
+    }
+}
+
+/*
+ * Desc: Prints every counter and the count, percentiles and maximum of every histogram of a snapshot.
+ * Params:
+ *    metrics - snapshot to print
+ *    output - stream to print to
+ */
+void printMetrics(struct metrics *metrics, FILE *output) {
+    for (int i = 0; i < METRIC_COUNTER_COUNT; i++) {
+        fprintf(output, "%s %llu\n", counterNames[i], (unsigned long long) metrics->counters[i]);
+    }
+
+    for (int i = 0; i < METRIC_HISTOGRAM_COUNT; i++) {
+        struct histogram *histogram = &metrics->histograms[i];
+        uint64_t total = 0;
+
+        for (int j = 0; j < HISTOGRAM_BUCKETS; j++) total += histogram->counts[j];
+
+        fprintf(output, "%s count=%llu p50=%llu p90=%llu p99=%llu p99.9=%llu max=%llu\n", histogramNames[i],
+                (unsigned long long) total,
+                (unsigned long long) valueAtPercentile(histogram, total, 50.0),
+                (unsigned long long) valueAtPercentile(histogram, total, 90.0),
+                (unsigned long long) valueAtPercentile(histogram, total, 99.0),
+                (unsigned long long) valueAtPercentile(histogram, total, 99.9),
+                (unsigned long long) valueAtPercentile(histogram, total, 100.0));
+    }
+
+    fflush(output);
+}
+
+/*
+ * Desc: Finds the bucket of a value: the top HISTOGRAM_SUB_BUCKET_BITS bits of the value select the bucket within
+ *       its power of two.
+ * Params:
+ *    value - value to look up
+ * Returns: index of the bucket
+ */
+int histogramIndex(uint64_t value) {
+    if (value < (1 << HISTOGRAM_SUB_BUCKET_BITS)) return (int) value;
+
+    int shift = 63 - __builtin_clzll(value) - HISTOGRAM_SUB_BUCKET_BITS + 1;
+    if (shift > HISTOGRAM_MAX_SHIFT) return HISTOGRAM_BUCKETS - 1;
+
+    return shift * HISTOGRAM_HALF_BUCKETS + (int) (value >> shift);
+}
+
+/*
+ * Desc: Returns the highest value counted in a bucket.
+ * Params:
+ *    index - index of the bucket
+ * Returns: the highest value of the bucket
+ */
+uint64_t bucketValue(int index) {
+    if (index < (1 << HISTOGRAM_SUB_BUCKET_BITS)) return (uint64_t) index;
+
+    int shift = index / HISTOGRAM_HALF_BUCKETS - 1;
+    uint64_t subBucket = index % HISTOGRAM_HALF_BUCKETS + HISTOGRAM_HALF_BUCKETS;
+    return ((subBucket + 1) << shift) - 1;
+}
+
+/*
+ * Desc: Finds the value below or at which the given share of the recorded values lies.
+ * Params:
+ *    histogram - histogram to search
+ *    total - number of values in the histogram
+ *    percentile - share in percent
+ * Returns: the value, 0 if the histogram is empty
+ */
+uint64_t valueAtPercentile(struct histogram *histogram, uint64_t total, double percentile) {
+    uint64_t wanted = (uint64_t) (total * percentile / 100.0 + 0.5);
+    uint64_t seen = 0;
+
+    if (total == 0) return 0;
+    if (wanted < 1) wanted = 1;
+
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += histogram->counts[i];
+        if (seen >= wanted) return bucketValue(i);
+    }
+
+    return bucketValue(HISTOGRAM_BUCKETS - 1);
+}
@@ -0,0 +1,69 @@
+#ifndef SERVER_METRICS_H
+#define SERVER_METRICS_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define METRIC_CONNECTIONS_ACCEPTED 0
+#define METRIC_CONNECTIONS_CLOSED 1
+#define METRIC_ROOMS_OPENED 2
+#define METRIC_ROOMS_CLOSED 3
+#define METRIC_MOVES_PLAYED 4
+#define METRIC_BYTES_RECEIVED 5
+#define METRIC_BYTES_SENT 6
+#define METRIC_ACCEPT_CALLS 7
+#define METRIC_READ_CALLS 8
+#define METRIC_WRITE_CALLS 9
+#define METRIC_WAIT_CALLS 10
+#define METRIC_LOG_RECORDS_DROPPED 11
+#define METRIC_TURNS_TIMED_OUT 12
+#define METRIC_IDLE_EVICTIONS 13
+#define METRIC_COUNTER_COUNT 14
+
+#define METRIC_PAIR_WAIT 0
+#define METRIC_MOVE_LATENCY 1
+#define METRIC_MATCH_DURATION 2
+#define METRIC_HISTOGRAM_COUNT 3
+
+#define HISTOGRAM_SUB_BUCKET_BITS 5
+#define HISTOGRAM_HALF_BUCKETS (1 << (HISTOGRAM_SUB_BUCKET_BITS - 1))
+#define HISTOGRAM_MAX_SHIFT 35
+#define HISTOGRAM_BUCKETS ((HISTOGRAM_MAX_SHIFT + 2) * HISTOGRAM_HALF_BUCKETS)
+
+/*
+ * Log-linear histogram of microsecond values in the style of HdrHistogram: values below 2^HISTOGRAM_SUB_BUCKET_BITS
+ * are counted exactly, larger ones in buckets no wider than 1/16 of their value, up to about 2^40 microseconds.
+ */
+struct histogram {
+    _Atomic uint64_t counts[HISTOGRAM_BUCKETS];
+};
+
+/*
+ * Counters and histograms of one worker. Only the owning worker writes them, with plain relaxed loads and stores that
+ * compile to ordinary increments, so other threads can read a consistent enough snapshot without slowing it down.
+ */
+struct metrics {
+    _Atomic uint64_t counters[METRIC_COUNTER_COUNT];
+    struct histogram histograms[METRIC_HISTOGRAM_COUNT];
+};
+
+/*
+ * Desc: Adds to a counter of the calling worker.
+ * Params:
+ *    metrics - metrics of the calling worker
+ *    counter - METRIC_ counter to add to
+ *    amount - amount to add
+ */
+static inline void countMetric(struct metrics *metrics, int counter, uint64_t amount) {
+    _Atomic uint64_t *value = &metrics->counters[counter];
+    atomic_store_explicit(value, atomic_load_explicit(value, memory_order_relaxed) + amount, memory_order_relaxed);
+}
+
+void recordValue(struct metrics *metrics, int histogram, long long value, uint64_t count);
+
+void mergeMetrics(struct metrics *into, struct metrics *from);
+
+void printMetrics(struct metrics *metrics, FILE *output);
+
+#endif
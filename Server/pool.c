@@ -0,0 +1,150 @@
+#include <stdlib.h>
+#include <string.h>
+#include "common.h"
+#include "pool.h"
+
+int growPool(struct pool *pool);
+
+struct poolSlot *slotAt(struct pool *pool, uint32_t index);
+
+struct poolSlot *slotOf(void *object);
+
+/*
+ * Desc: Prepares an empty pool. No memory is allocated until the first object is requested.
+ * Params:
+ *    pool - pool to initialize
+ *    objectSize - size of the pooled objects
+ */
+void initPool(struct pool *pool, size_t objectSize) {
+    size_t alignment = _Alignof(max_align_t);
+
+    memset(pool, 0, sizeof(struct pool));
+    pool->slotSize = (sizeof(struct poolSlot) + objectSize + alignment - 1) & ~(alignment - 1);
+}
+
+/*
+ * Desc: Returns every slab of the pool to the system. Objects still allocated from the pool become invalid.
+ * Params:
+ *    pool - pool to free
+ */
+void freePool(struct pool *pool) {
+    for (int i = 0; i < pool->slabCount; i++) free(pool->slabs[i]);
+
+    free(pool->slabs);
+    memset(pool, 0, sizeof(struct pool));
+}
+
+/*
+ * Desc: Takes an object from the free list, carving a new slab if the list is empty. The object is not cleared.
+ * Params:
+ *    pool - pool to allocate from
+ * Returns: the object or NULL if memory could not be allocated
+ */
+void *poolAlloc(struct pool *pool) {
+    if (pool->freeList == NULL && growPool(pool) != 0) return NULL;
+
+    struct poolSlot *slot = pool->freeList;
+    pool->freeList = slot->nextFree;
+    slot->nextFree = NULL;
+    slot->generation++;
+    pool->liveCount++;
+    return slot->object;
+}
+
+/*
+ * Desc: Puts an object back on the free list and invalidates its handles.
+ * Params:
+ *    pool - pool the object was allocated from
+ *    object - object to release, may be NULL
+ */
+void poolFree(struct pool *pool, void *object) {
+    if (object == NULL) return;
+
+    struct poolSlot *slot = slotOf(object);
+    slot->generation++;
+    slot->nextFree = pool->freeList;
+    pool->freeList = slot;
+    pool->liveCount--;
+}
+
+/*
+ * Desc: Builds a handle that identifies an allocated object until it is released.
+ * Params:
+ *    object - allocated object
+ * Returns: the handle, never 0
+ */
+uint64_t poolHandle(void *object) {
+    struct poolSlot *slot = slotOf(object);
+    return ((uint64_t) slot->generation << 32) | slot->index;
+}
+
+/*
+ * Desc: Looks up the object of a handle.
+ * Params:
+ *    pool - pool the object was allocated from
+ *    handle - handle of the object
+ * Returns: the object or NULL if it has been released since the handle was taken
+ */
+void *poolResolve(struct pool *pool, uint64_t handle) {
+    uint32_t index = (uint32_t) handle;
+    uint32_t generation = (uint32_t) (handle >> 32);
+
+    if (index >= (uint32_t) pool->slabCount * SLAB_OBJECT_COUNT) return NULL;
+
+    struct poolSlot *slot = slotAt(pool, index);
+    return slot->generation == generation && (generation & 1) ? slot->object : NULL;
+}
+
+/*
+ * Desc: Carves a new slab and puts all of its objects on the free list, lowest index first.
+ * Params:
+ *    pool - pool to grow
+ * Returns: 0 if grown, 1 if memory could not be allocated
+ */
+int growPool(struct pool *pool) {
+    if (pool->slabCount == pool->slabCapacity) {
+        int capacity = pool->slabCapacity == 0 ? INITIAL_SLAB_CAPACITY : pool->slabCapacity * 2;
+        char **slabs = realloc(pool->slabs, capacity * sizeof(char *));
+        if (slabs == NULL) return DEFAULT_ERROR_RETURN;
+
+        pool->slabs = slabs;
+        pool->slabCapacity = capacity;
+    }
+
+    char *slab = malloc(pool->slotSize * SLAB_OBJECT_COUNT);
+    if (slab == NULL) return DEFAULT_ERROR_RETURN;
+
+    uint32_t firstIndex = (uint32_t) pool->slabCount * SLAB_OBJECT_COUNT;
+    pool->slabs[pool->slabCount++] = slab;
+
+    for (int i = SLAB_OBJECT_COUNT - 1; i >= 0; i--) {
+        struct poolSlot *slot = (struct poolSlot *) (slab + i * pool->slotSize);
+        slot->generation = 0;
+        slot->index = firstIndex + i;
+        slot->nextFree = pool->freeList;
+        pool->freeList = slot;
+    }
+
+    return DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Finds the slot with the given index.
+ * Params:
+ *    pool - pool owning the slot
+ *    index - index of the slot
+ * Returns: the slot
+ */
+struct poolSlot *slotAt(struct pool *pool, uint32_t index) {
+    return (struct poolSlot *) (pool->slabs[index / SLAB_OBJECT_COUNT] + (index % SLAB_OBJECT_COUNT) * pool->slotSize);
+}
+
+/*
+ * Desc: Finds the slot header of an object.
+ * Params:
+ *    object - pooled object
+ * Returns: the slot
+ */
+struct poolSlot *slotOf(void *object) {
+    return (struct poolSlot *) ((char *) object - offsetof(struct poolSlot, object));
+}
@@ -0,0 +1,46 @@
+#ifndef SERVER_POOL_H
+#define SERVER_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SLAB_OBJECT_COUNT 256
+#define INITIAL_SLAB_CAPACITY 8
+
+/*
+ * Header in front of every pooled object. The generation is odd while the object is allocated and grows on every
+ * allocation and release, so a handle taken from an object stops resolving once the object has been released.
+ */
+struct poolSlot {
+    uint32_t generation;
+    uint32_t index;
+    struct poolSlot *nextFree;
+    _Alignas(max_align_t) unsigned char object[];
+};
+
+/*
+ * Pool of fixed-size objects carved out of slabs of SLAB_OBJECT_COUNT objects. Released objects go to a free list and
+ * are reused first, so allocation and release are O(1) and slabs are only returned to the system with the pool.
+ */
+struct pool {
+    size_t slotSize;
+    char **slabs;
+    int slabCount;
+    int slabCapacity;
+    int liveCount;
+    struct poolSlot *freeList;
+};
+
+void initPool(struct pool *pool, size_t objectSize);
+
+void freePool(struct pool *pool);
+
+void *poolAlloc(struct pool *pool);
+
+void poolFree(struct pool *pool, void *object);
+
+uint64_t poolHandle(void *object);
+
+void *poolResolve(struct pool *pool, uint64_t handle);
+
+#endif
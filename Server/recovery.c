@@ -0,0 +1,466 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "common.h"
+#include "recovery.h"
+
+#define WRITER_SLEEP 10 // milliseconds the writer sleeps between two looks at the stop flag
+
+void *runRecoveryWriter(void *argument);
+
+int collectRecoveryImages(struct recoveryWriter *writer);
+
+int saveRecoveryFile(struct recoveryWriter *writer);
+
+int writeAll(int fileDescriptor, const uint8_t *bytes, size_t length);
+
+int decodeRoomImage(const uint8_t *bytes, size_t length, struct recoveredRoom *room);
+
+static inline uint64_t mixToken(uint64_t token) {
+    token ^= token >> 33;
+    token *= 0xff51afd7ed558ccdULL;
+    return token ^ token >> 33;
+}
+
+/*
+ * Desc: Allocates an empty image.
+ * Returns: the image or NULL if memory could not be allocated
+ */
+struct recoveryImage *createRecoveryImage() {
+    struct recoveryImage *image = calloc(1, sizeof(struct recoveryImage));
+    if (image == NULL) return NULL;
+
+    if ((image->bytes = malloc(INITIAL_IMAGE_CAPACITY)) == NULL) {
+        free(image);
+        return NULL;
+    }
+
+    image->capacity = INITIAL_IMAGE_CAPACITY;
+    return image;
+}
+
+/*
+ * Desc: Frees an image.
+ * Params:
+ *    image - image to free, may be NULL
+ */
+void destroyRecoveryImage(struct recoveryImage *image) {
+    if (image == NULL) return;
+
+    free(image->bytes);
+    free(image);
+}
+
+/*
+ * Desc: Appends the record of a running match to an image, growing the image when it is full.
+ * Params:
+ *    image - image being built by the worker owning the room
+ *    room - room of the match
+ *    aiOpponent - 1 if player 1 is the AI opponent
+ * Returns: 0 if appended, 1 if memory could not be allocated
+ */
+int appendRoomImage(struct recoveryImage *image, struct room *room, int aiOpponent) {
+    const struct board *board = &room->board;
+    int cellCount = board->size * board->size;
+
+    if (image->capacity - image->length < MAX_ROOM_IMAGE_SIZE) {
+        uint8_t *bytes = realloc(image->bytes, image->capacity * 2);
+        if (bytes == NULL) return DEFAULT_ERROR_RETURN;
+
+        image->bytes = bytes;
+        image->capacity *= 2;
+    }
+
+    uint8_t *record = image->bytes + image->length;
+    memset(record, 0, ROOM_IMAGE_HEADER_SIZE + (cellCount + 3) / 4);
+    storeLittleEndian(record, room->matchId, 8);
+    storeLittleEndian(record + 8, room->tokens[0], 8);
+    storeLittleEndian(record + 16, room->tokens[1], 8);
+    record[24] = (uint8_t) aiOpponent;
+    record[25] = board->size;
+    record[26] = board->winLength;
+
+    for (int i = 0; i < cellCount; i++) {
+        int owner = boardCell(board, i / board->size, i % board->size);
+        record[ROOM_IMAGE_HEADER_SIZE + i / 4] |= (uint8_t) ((owner + 1) << (2 * (i % 4)));
+    }
+
+    image->length += ROOM_IMAGE_HEADER_SIZE + (cellCount + 3) / 4;
+    image->roomCount++;
+    return DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Prepares the writer of a snapshot file without starting its thread.
+ * Params:
+ *    writer - writer to initialize
+ *    path - path of the snapshot file
+ *    workerCount - number of workers publishing images
+ * Returns: 0 if prepared, 1 if memory could not be allocated
+ */
+int openRecoveryWriter(struct recoveryWriter *writer, const char *path, int workerCount) {
+    size_t length = strlen(path);
+    const char *slash = strrchr(path, '/');
+
+    memset(writer, 0, sizeof(struct recoveryWriter));
+    writer->workerCount = workerCount;
+    atomic_init(&writer->stopping, 0);
+
+    writer->path = strdup(path);
+    writer->temporaryPath = malloc(length + sizeof(".tmp"));
+    writer->directory = slash == NULL ? strdup(".") : strndup(path, slash == path ? 1 : (size_t) (slash - path));
+    writer->published = calloc(workerCount, sizeof(*writer->published));
+    writer->saved = calloc(workerCount, sizeof(struct recoveryImage *));
+
+    if (writer->path == NULL || writer->temporaryPath == NULL || writer->directory == NULL ||
+        writer->published == NULL || writer->saved == NULL) {
+        closeRecoveryWriter(writer);
+        return DEFAULT_ERROR_RETURN;
+    }
+
+    snprintf(writer->temporaryPath, length + sizeof(".tmp"), "%s.tmp", path);
+    for (int i = 0; i < workerCount; i++) atomic_init(&writer->published[i], NULL);
+    return DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Starts the writer thread.
+ * Params:
+ *    writer - prepared writer
+ * Returns: 0 if started, otherwise the error of pthread_create
+ */
+int startRecoveryWriter(struct recoveryWriter *writer) {
+    int error = pthread_create(&writer->thread, NULL, runRecoveryWriter, writer);
+    writer->writing = error == 0;
+    return error;
+}
+
+/*
+ * Desc: Hands the latest image of a worker to the writer. An image the writer has not collected yet is outdated by
+ *       the new one and freed right away.
+ * Params:
+ *    writer - writer of the snapshot file
+ *    index - index of the publishing worker
+ *    image - complete image, owned by the writer from now on
+ */
+void publishRecoveryImage(struct recoveryWriter *writer, int index, struct recoveryImage *image) {
+    destroyRecoveryImage(atomic_exchange(&writer->published[index], image));
+}
+
+/*
+ * Desc: Stops the writer thread after it saved the images still published, then frees the writer. The workers must
+ *       not publish anymore.
+ * Params:
+ *    writer - writer to close
+ */
+void closeRecoveryWriter(struct recoveryWriter *writer) {
+    if (writer->writing) {
+        atomic_store(&writer->stopping, 1);
+        pthread_join(writer->thread, NULL);
+        writer->writing = 0;
+    }
+
+    for (int i = 0; writer->published != NULL && i < writer->workerCount; i++) {
+        destroyRecoveryImage(atomic_exchange(&writer->published[i], NULL));
+    }
+    for (int i = 0; writer->saved != NULL && i < writer->workerCount; i++) destroyRecoveryImage(writer->saved[i]);
+
+    free(writer->path);
+    free(writer->temporaryPath);
+    free(writer->directory);
+    free(writer->published);
+    free(writer->saved);
+    memset(writer, 0, sizeof(struct recoveryWriter));
+}
+
+/*
+ * Desc: Writer thread: saves the snapshot file every SNAPSHOT_INTERVAL in which a worker published a new image, and a
+ *       last time when stopping.
+ * Params:
+ *    argument - the writer
+ * Returns: NULL
+ */
+void *runRecoveryWriter(void *argument) {
+    struct recoveryWriter *writer = argument;
+    struct timespec pause = {0, WRITER_SLEEP * 1000000L};
+    int stopping = 0;
+
+    while (!stopping) {
+        for (int slept = 0; slept < SNAPSHOT_INTERVAL && !stopping; slept += WRITER_SLEEP) {
+            nanosleep(&pause, NULL);
+            stopping = atomic_load(&writer->stopping);
+        }
+
+        if (collectRecoveryImages(writer) > 0 && saveRecoveryFile(writer) != 0) {
+            printf("Unable to save the snapshot. Errno: %d\n", errno);
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Desc: Takes the images published since the last collection, replacing the saved images of their workers.
+ * Params:
+ *    writer - writer of the snapshot file
+ * Returns: number of new images
+ */
+int collectRecoveryImages(struct recoveryWriter *writer) {
+    int collected = 0;
+
+    for (int i = 0; i < writer->workerCount; i++) {
+        struct recoveryImage *image = atomic_exchange(&writer->published[i], NULL);
+        if (image == NULL) continue;
+
+        destroyRecoveryImage(writer->saved[i]);
+        writer->saved[i] = image;
+        collected++;
+    }
+
+    return collected;
+}
+
+/*
+ * Desc: Replaces the snapshot file with the saved images of all workers. The new file only takes the place of the old
+ *       one once it is completely on disk, and the rename is synced through the directory.
+ * Params:
+ *    writer - writer of the snapshot file
+ * Returns: 0 if saved, 1 if error occurred with errno set
+ */
+int saveRecoveryFile(struct recoveryWriter *writer) {
+    uint8_t header[RECOVERY_HEADER_SIZE];
+    uint64_t roomCount = 0;
+    int fileDescriptor, directory, result = DEFAULT_RETURN;
+
+    for (int i = 0; i < writer->workerCount; i++) roomCount += writer->saved[i] ? writer->saved[i]->roomCount : 0;
+
+    memset(header, 0, sizeof(header));
+    memcpy(header, RECOVERY_MAGIC, 8);
+    storeLittleEndian(header + 8, roomCount, 4);
+
+    fileDescriptor = open(writer->temporaryPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fileDescriptor < 0) return DEFAULT_ERROR_RETURN;
+
+    result |= writeAll(fileDescriptor, header, sizeof(header));
+    for (int i = 0; i < writer->workerCount && result == DEFAULT_RETURN; i++) {
+        struct recoveryImage *image = writer->saved[i];
+        if (image != NULL) result |= writeAll(fileDescriptor, image->bytes, image->length);
+    }
+
+    if (result != DEFAULT_RETURN || fsync(fileDescriptor) != 0) result = DEFAULT_ERROR_RETURN;
+    if (close(fileDescriptor) != 0) result = DEFAULT_ERROR_RETURN;
+    if (result != DEFAULT_RETURN || rename(writer->temporaryPath, writer->path) != 0) return DEFAULT_ERROR_RETURN;
+
+    if ((directory = open(writer->directory, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) >= 0) {
+        fsync(directory);
+        close(directory);
+    }
+    return DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Writes a whole buffer, retrying short writes.
+ * Params:
+ *    fileDescriptor - file to write to
+ *    bytes - bytes to write
+ *    length - number of bytes
+ * Returns: 0 if written, 1 if error occurred with errno set
+ */
+int writeAll(int fileDescriptor, const uint8_t *bytes, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fileDescriptor, bytes, length);
+        if (written < 0 && errno == EINTR) continue;
+        if (written < 0) return DEFAULT_ERROR_RETURN;
+
+        bytes += written;
+        length -= written;
+    }
+    return DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Reads every match of a snapshot file. A missing file is an empty snapshot.
+ * Params:
+ *    path - path of the snapshot file
+ *    rooms - set to the matches, to be freed by the caller
+ *    roomCount - set to the number of matches
+ * Returns: 0 if read, 1 if the file can not be read or is not a complete snapshot
+ */
+int readRecoveryFile(const char *path, struct recoveredRoom **rooms, int *roomCount) {
+    struct stat status;
+    uint8_t *bytes;
+    size_t offset = RECOVERY_HEADER_SIZE;
+    int fileDescriptor = open(path, O_RDONLY | O_CLOEXEC);
+
+    *rooms = NULL;
+    *roomCount = 0;
+    if (fileDescriptor < 0 && errno == ENOENT) return DEFAULT_RETURN;
+    if (fileDescriptor < 0) return DEFAULT_ERROR_RETURN;
+
+    if (fstat(fileDescriptor, &status) != 0 || status.st_size < RECOVERY_HEADER_SIZE ||
+        (bytes = malloc(status.st_size)) == NULL) {
+        close(fileDescriptor);
+        return DEFAULT_ERROR_RETURN;
+    }
+
+    ssize_t length = pread(fileDescriptor, bytes, status.st_size, 0);
+    close(fileDescriptor);
+
+    int count = length == status.st_size && memcmp(bytes, RECOVERY_MAGIC, 8) == 0 ? (int) loadLittleEndian(bytes + 8, 4)
+                                                                                  : -1;
+    if (count < 0 || (*rooms = calloc(count > 0 ? count : 1, sizeof(struct recoveredRoom))) == NULL) {
+        free(bytes);
+        errno = EINVAL;
+        return DEFAULT_ERROR_RETURN;
+    }
+
+    for (int i = 0; i < count; i++) {
+        int recordLength = decodeRoomImage(bytes + offset, (size_t) length - offset, &(*rooms)[i]);
+
+        if (recordLength < 0) {
+            free(bytes);
+            free(*rooms);
+            *rooms = NULL;
+            errno = EINVAL;
+            return DEFAULT_ERROR_RETURN;
+        }
+        offset += recordLength;
+    }
+
+    free(bytes);
+    *roomCount = count;
+    return DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Decodes the record of one room.
+ * Params:
+ *    bytes - start of the record
+ *    length - bytes left in the snapshot
+ *    room - filled with the match
+ * Returns: length of the record, -1 if it is cut off or names an unknown board
+ */
+int decodeRoomImage(const uint8_t *bytes, size_t length, struct recoveredRoom *room) {
+    if (length < ROOM_IMAGE_HEADER_SIZE) return -1;
+
+    room->matchId = loadLittleEndian(bytes, 8);
+    room->tokens[0] = loadLittleEndian(bytes + 8, 8);
+    room->tokens[1] = loadLittleEndian(bytes + 16, 8);
+    room->aiOpponent = bytes[24];
+    room->size = bytes[25];
+    room->winLength = bytes[26];
+
+    int cellCount = room->size * room->size;
+    int recordLength = ROOM_IMAGE_HEADER_SIZE + (cellCount + 3) / 4;
+    if (variantIndex(room->size, room->winLength) < 0 || length < (size_t) recordLength) return -1;
+
+    for (int i = 0; i < cellCount; i++) {
+        room->cells[i] = (bytes[ROOM_IMAGE_HEADER_SIZE + i / 4] >> (2 * (i % 4))) & 3;
+    }
+    return recordLength;
+}
+
+/*
+ * Desc: Replays the stones of a recovered match onto the empty board of its new room, alternating between the players
+ *       like the match did, so the board ends up in the same state it was saved in.
+ * Params:
+ *    board - empty board of the recovered size and win length
+ *    recovered - the recovered match
+ * Returns: 0 if restored, 1 if the stones do not form a running match
+ */
+int restoreBoard(struct board *board, const struct recoveredRoom *recovered) {
+    int cellCount = recovered->size * recovered->size;
+    int next[2] = {0, 0};
+
+    for (int stone = 0;; stone++) {
+        int player = stone & 1;
+
+        while (next[player] < cellCount && recovered->cells[next[player]] != player + 1) next[player]++;
+        if (next[player] == cellCount) break;
+
+        int cell = next[player]++;
+        if (playMove(board, player, cell / recovered->size, cell % recovered->size) != MOVE_PLAYED) {
+            return DEFAULT_ERROR_RETURN;
+        }
+    }
+
+    // The replay stops at the first player without stones left; any stone of the other player is one too many.
+    for (int player = 0; player < 2; player++) {
+        while (next[player] < cellCount && recovered->cells[next[player]] != player + 1) next[player]++;
+        if (next[player] != cellCount) return DEFAULT_ERROR_RETURN;
+    }
+    return DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Allocates an empty resume table with room for a number of tokens.
+ * Params:
+ *    table - table to initialize
+ *    tokenCount - number of tokens that will be added
+ * Returns: 0 if allocated, 1 if memory could not be allocated
+ */
+int initResumeTable(struct resumeTable *table, int tokenCount) {
+    table->capacity = 16;
+    while (table->capacity < tokenCount * 2) table->capacity *= 2;
+
+    table->entries = calloc(table->capacity, sizeof(struct resumeEntry));
+    return table->entries == NULL ? DEFAULT_ERROR_RETURN : DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Frees a resume table.
+ * Params:
+ *    table - table to free
+ */
+void freeResumeTable(struct resumeTable *table) {
+    free(table->entries);
+    table->entries = NULL;
+    table->capacity = 0;
+}
+
+/*
+ * Desc: Maps a resume token to the room of its match.
+ * Params:
+ *    table - resume table of the worker owning the room
+ *    token - token of a player, not 0
+ *    room - pool handle of the room
+ * Returns: 0 if added, 1 if the table is full
+ */
+int addResumeToken(struct resumeTable *table, uint64_t token, uint64_t room) {
+    uint32_t mask = (uint32_t) table->capacity - 1, slot = (uint32_t) mixToken(token) & mask;
+
+    for (uint32_t probe = 0; probe <= mask; probe++, slot = (slot + 1) & mask) {
+        if (table->entries[slot].token != 0) continue;
+
+        table->entries[slot].token = token;
+        table->entries[slot].room = room;
+        return DEFAULT_RETURN;
+    }
+    return DEFAULT_ERROR_RETURN;
+}
+
+/*
+ * Desc: Looks up the room of a resume token and removes the token, so it can be used only once.
+ * Params:
+ *    table - resume table of the worker owning the room
+ *    token - token sent by the reconnecting player
+ * Returns: pool handle of the room, 0 if the token is unknown or was claimed before
+ */
+uint64_t claimResumeToken(struct resumeTable *table, uint64_t token) {
+    uint32_t mask = (uint32_t) table->capacity - 1, slot = (uint32_t) mixToken(token) & mask;
+
+    for (uint32_t probe = 0; probe <= mask && token != 0 && table->entries[slot].token != 0; probe++) {
+        if (table->entries[slot].token == token) {
+            uint64_t room = table->entries[slot].room;
+            table->entries[slot].room = 0;
+            return room;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return 0;
+}
@@ -0,0 +1,106 @@
+#ifndef SERVER_RECOVERY_H
+#define SERVER_RECOVERY_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include "board.h"
+#include "room.h"
+
+#define RECOVERY_MAGIC "TTTSNAP1"
+#define RECOVERY_HEADER_SIZE 16
+#define ROOM_IMAGE_HEADER_SIZE 27
+#define MAX_ROOM_IMAGE_SIZE (ROOM_IMAGE_HEADER_SIZE + (MAX_BOARD_SIZE * MAX_BOARD_SIZE + 3) / 4)
+#define INITIAL_IMAGE_CAPACITY 4096 // bytes
+#define SNAPSHOT_INTERVAL 1000 // milliseconds between two snapshots of the rooms of a worker
+#define RESUME_TIMEOUT 30000 // milliseconds a recovered match waits for its players to reconnect
+
+/*
+ * Running matches of one worker, encoded at one point between two batches of its event loop. Every room takes a
+ * little-endian record:
+ *    0-7   match id
+ *    8-23  resume tokens of player 0 and player 1, 0 for the AI opponent
+ *    24    1 if player 1 is the AI opponent
+ *    25-26 board size, win length
+ *    27-   the cells in row-major order, 2 bits each (0 empty, 1 player 0, 2 player 1), first cell in the low bits
+ * Once published the image is never written again, so the worker keeps playing while the writer saves it.
+ */
+struct recoveryImage {
+    int roomCount;
+    int length;
+    int capacity;
+    uint8_t *bytes;
+};
+
+/*
+ * Background thread saving the latest image of every worker. Workers publish a new image by swapping it into their
+ * slot; every SNAPSHOT_INTERVAL the writer collects the new images and replaces the snapshot file with all images at
+ * once: it writes a temporary file, syncs it and renames it over the previous snapshot, so a crash at any point leaves
+ * either the old or the new snapshot. The file starts with RECOVERY_MAGIC and the number of rooms.
+ */
+struct recoveryWriter {
+    char *path;
+    char *temporaryPath;
+    char *directory;
+    int workerCount;
+    _Atomic(struct recoveryImage *) *published;
+    struct recoveryImage **saved;
+    pthread_t thread;
+    int writing;
+    atomic_int stopping;
+};
+
+/*
+ * Match read back from a snapshot, cells holding 0 for empty, 1 for player 0 and 2 for player 1.
+ */
+struct recoveredRoom {
+    uint64_t matchId;
+    uint64_t tokens[2];
+    int aiOpponent;
+    int size;
+    int winLength;
+    uint8_t cells[MAX_BOARD_SIZE * MAX_BOARD_SIZE];
+};
+
+/*
+ * Resume tokens of the recovered matches of a worker, mapped to the pool handle of their room. The table is filled
+ * once at startup, so it is an open addressing table that never grows; a claimed token keeps its slot with handle 0
+ * so later probes still pass it. Handles of rooms closed meanwhile simply no longer resolve.
+ */
+struct resumeEntry {
+    uint64_t token;
+    uint64_t room;
+};
+
+struct resumeTable {
+    int capacity;
+    struct resumeEntry *entries;
+};
+
+struct recoveryImage *createRecoveryImage();
+
+void destroyRecoveryImage(struct recoveryImage *image);
+
+int appendRoomImage(struct recoveryImage *image, struct room *room, int aiOpponent);
+
+int openRecoveryWriter(struct recoveryWriter *writer, const char *path, int workerCount);
+
+int startRecoveryWriter(struct recoveryWriter *writer);
+
+void publishRecoveryImage(struct recoveryWriter *writer, int index, struct recoveryImage *image);
+
+void closeRecoveryWriter(struct recoveryWriter *writer);
+
+int readRecoveryFile(const char *path, struct recoveredRoom **rooms, int *roomCount);
+
+int restoreBoard(struct board *board, const struct recoveredRoom *recovered);
+
+int initResumeTable(struct resumeTable *table, int tokenCount);
+
+void freeResumeTable(struct resumeTable *table);
+
+int addResumeToken(struct resumeTable *table, uint64_t token, uint64_t room);
+
+uint64_t claimResumeToken(struct resumeTable *table, uint64_t token);
+
+#endif
@@ -0,0 +1,304 @@
+#include <stdlib.h>
+#include <string.h>
+#include "common.h"
+#include "room.h"
+
+int growRoomTable(struct roomTable *table, int fileDescriptor);
+
+/*
+ * Desc: Prepares an empty room table.
+ * Params:
+ *    table - table to initialize
+ * Returns: 0 if initialized, 1 if memory could not be allocated
+ */
+int initRoomTable(struct roomTable *table) {
+    memset(table, 0, sizeof(struct roomTable));
+    table->byFd = calloc(INITIAL_TABLE_CAPACITY, sizeof(struct connection *));
+    if (table->byFd == NULL) return DEFAULT_ERROR_RETURN;
+
+    table->capacity = INITIAL_TABLE_CAPACITY;
+    initPool(&table->connectionPool, sizeof(struct connection));
+    initPool(&table->roomPool, sizeof(struct room));
+    initPool(&table->bufferPool, sizeof(struct sendBuffer));
+    initPool(&table->feedPool, sizeof(struct feed));
+    initPool(&table->broadcastPool, sizeof(struct broadcast));
+    return DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Releases the table together with every connection and room that is still in it.
+ * Params:
+ *    table - table to free
+ */
+void freeRoomTable(struct roomTable *table) {
+    while (table->roomList != NULL) destroyRoom(table, table->roomList);
+
+    freePool(&table->connectionPool);
+    freePool(&table->roomPool);
+    freePool(&table->bufferPool);
+    freePool(&table->feedPool);
+    freePool(&table->broadcastPool);
+    free(table->byFd);
+    memset(table, 0, sizeof(struct roomTable));
+}
+
+/*
+ * Desc: Registers a new connection, growing the table if the file descriptor does not fit yet.
+ * Params:
+ *    table - table to update
+ *    fileDescriptor - file descriptor of the connection
+ * Returns: the new connection or NULL if memory could not be allocated
+ */
+struct connection *createConnection(struct roomTable *table, int fileDescriptor) {
+    if (fileDescriptor < 0) return NULL;
+    if (fileDescriptor >= table->capacity && growRoomTable(table, fileDescriptor) != 0) return NULL;
+
+    struct connection *connection = poolAlloc(&table->connectionPool);
+    if (connection == NULL) return NULL;
+
+    memset(connection, 0, sizeof(struct connection));
+    connection->fileDescriptor = fileDescriptor;
+    connection->variant = -1;
+    initReceiveBuffer(&connection->input);
+    table->byFd[fileDescriptor] = connection;
+    table->connectionCount++;
+    return connection;
+}
+
+/*
+ * Desc: Forgets a connection, cancelling its idle timer and ending its subscription if it is a spectator. The
+ *       connection has to be detached from its room first.
+ * Params:
+ *    table - table to update
+ *    fileDescriptor - file descriptor of the connection
+ */
+void destroyConnection(struct roomTable *table, int fileDescriptor) {
+    struct connection *connection = findConnection(table, fileDescriptor);
+    if (connection == NULL) return;
+
+    cancelTimer(&connection->idleTimer);
+    unsubscribeFromChannel(table, connection);
+    releaseOutput(table, connection);
+    table->byFd[fileDescriptor] = NULL;
+    table->connectionCount--;
+    poolFree(&table->connectionPool, connection);
+}
+
+/*
+ * Desc: Returns the output buffer of a connection, taking an empty one from the buffer pool if it has none.
+ * Params:
+ *    table - table owning the connection
+ *    connection - connection that wants to send
+ * Returns: the output buffer or NULL if memory could not be allocated
+ */
+struct sendBuffer *acquireOutput(struct roomTable *table, struct connection *connection) {
+    if (connection->output != NULL) return connection->output;
+
+    if ((connection->output = poolAlloc(&table->bufferPool)) != NULL) initSendBuffer(connection->output);
+    return connection->output;
+}
+
+/*
+ * Desc: Gives the output buffer of a connection back to the buffer pool. Output still queued in it is discarded.
+ * Params:
+ *    table - table owning the connection
+ *    connection - connection that is done sending
+ */
+void releaseOutput(struct roomTable *table, struct connection *connection) {
+    poolFree(&table->bufferPool, connection->output);
+    connection->output = NULL;
+}
+
+/*
+ * Desc: Looks up a connection by its file descriptor.
+ * Params:
+ *    table - table to search
+ *    fileDescriptor - file descriptor of the connection
+ * Returns: the connection or NULL if the descriptor is not registered
+ */
+struct connection *findConnection(struct roomTable *table, int fileDescriptor) {
+    if (fileDescriptor < 0 || fileDescriptor >= table->capacity) return NULL;
+    return table->byFd[fileDescriptor];
+}
+
+/*
+ * Desc: Takes a new empty room from the room pool. The room is not reachable through the table until a player is
+ *       attached to it.
+ * Params:
+ *    table - table that will own the room
+ *    variant - board variant played in the room
+ * Returns: the new room or NULL if memory could not be allocated
+ */
+struct room *createRoom(struct roomTable *table, int variant) {
+    struct room *room = poolAlloc(&table->roomPool);
+    if (room == NULL) return NULL;
+
+    memset(room, 0, sizeof(struct room));
+    room->channel.room = room;
+    if (initBoard(&room->board, variantSize(variant), variantWinLength(variant)) != 0) {
+        poolFree(&table->roomPool, room);
+        return NULL;
+    }
+
+    room->nextRoom = table->roomList;
+    if (table->roomList != NULL) table->roomList->previousRoom = room;
+    table->roomList = room;
+    table->roomCount++;
+    return room;
+}
+
+/*
+ * Desc: Detaches both players from a room, ends the subscriptions of spectators still watching it, cancels its timers
+ *       and returns it to the room pool.
+ * Params:
+ *    table - table that owns the room
+ *    room - room to destroy
+ */
+void destroyRoom(struct roomTable *table, struct room *room) {
+    if (room->client1 > 0) detachFromRoom(table, room->client1);
+    if (room->client2 > 0) detachFromRoom(table, room->client2);
+    while (room->channel.spectators != NULL) unsubscribeFromChannel(table, room->channel.spectators);
+    if (room->channel.open != NULL) releaseBroadcast(&table->broadcastPool, room->channel.open);
+    cancelTimer(&room->cooldownTimer);
+    cancelTimer(&room->turnTimer);
+    freeBoard(&room->board);
+
+    if (room->previousRoom != NULL) room->previousRoom->nextRoom = room->nextRoom;
+    else table->roomList = room->nextRoom;
+    if (room->nextRoom != NULL) room->nextRoom->previousRoom = room->previousRoom;
+
+    table->roomCount--;
+    poolFree(&table->roomPool, room);
+}
+
+/*
+ * Desc: Looks up the room a connection belongs to.
+ * Params:
+ *    table - table to search
+ *    fileDescriptor - file descriptor of the connection
+ * Returns: the room or NULL if the connection is not in any room
+ */
+struct room *findRoom(struct roomTable *table, int fileDescriptor) {
+    struct connection *connection = findConnection(table, fileDescriptor);
+    return connection == NULL ? NULL : connection->room;
+}
+
+/*
+ * Desc: Maps a registered connection to a room.
+ * Params:
+ *    table - table to update
+ *    fileDescriptor - file descriptor of the connection
+ *    room - room the connection plays in
+ */
+void attachToRoom(struct roomTable *table, int fileDescriptor, struct room *room) {
+    struct connection *connection = findConnection(table, fileDescriptor);
+    if (connection != NULL) connection->room = room;
+}
+
+/*
+ * Desc: Removes the mapping of a connection to its room. The room itself is left untouched.
+ * Params:
+ *    table - table to update
+ *    fileDescriptor - file descriptor of the connection
+ */
+void detachFromRoom(struct roomTable *table, int fileDescriptor) {
+    struct connection *connection = findConnection(table, fileDescriptor);
+    if (connection != NULL) connection->room = NULL;
+}
+
+/*
+ * Desc: Makes a connection a spectator of a channel. Frames already collected in the open broadcast of the channel are
+ *       covered by the snapshot the spectator gets instead, so the channel starts a new broadcast for the next frames.
+ * Params:
+ *    table - table owning the connection
+ *    channel - channel to watch
+ *    connection - connection of the spectator
+ * Returns: 0 if subscribed, 1 if memory could not be allocated
+ */
+int subscribeToChannel(struct roomTable *table, struct channel *channel, struct connection *connection) {
+    if ((connection->feed = poolAlloc(&table->feedPool)) == NULL) return DEFAULT_ERROR_RETURN;
+
+    initFeed(connection->feed);
+    connection->channel = channel;
+    connection->previousSpectator = NULL;
+    connection->nextSpectator = channel->spectators;
+    if (channel->spectators != NULL) channel->spectators->previousSpectator = connection;
+    channel->spectators = connection;
+    channel->spectatorCount++;
+
+    if (channel->open != NULL) releaseBroadcast(&table->broadcastPool, channel->open);
+    channel->open = NULL;
+    return DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Ends the subscription of a spectator and drops the broadcasts it has not received yet.
+ * Params:
+ *    table - table owning the connection
+ *    connection - connection of the spectator, connections that do not watch any channel are left untouched
+ */
+void unsubscribeFromChannel(struct roomTable *table, struct connection *connection) {
+    struct channel *channel = connection->channel;
+    if (channel == NULL) return;
+
+    if (connection->previousSpectator != NULL) connection->previousSpectator->nextSpectator = connection->nextSpectator;
+    else channel->spectators = connection->nextSpectator;
+    if (connection->nextSpectator != NULL) connection->nextSpectator->previousSpectator = connection->previousSpectator;
+    channel->spectatorCount--;
+
+    clearFeed(connection->feed, &table->broadcastPool);
+    poolFree(&table->feedPool, connection->feed);
+    connection->feed = NULL;
+    connection->channel = NULL;
+    connection->nextSpectator = NULL;
+    connection->previousSpectator = NULL;
+}
+
+/*
+ * Desc: Moves every spectator of a channel to another channel, keeping the broadcasts they have not received yet.
+ *       Like a new subscriber, they hold none of the frames already collected in the open broadcast of the other
+ *       channel, so it starts a new broadcast for the next frames.
+ * Params:
+ *    table - table owning the spectators
+ *    from - channel the spectators leave
+ *    to - channel the spectators watch from now on
+ */
+void moveSpectators(struct roomTable *table, struct channel *from, struct channel *to) {
+    struct connection *last = NULL;
+
+    for (struct connection *spectator = from->spectators; spectator != NULL; spectator = spectator->nextSpectator) {
+        spectator->channel = to;
+        last = spectator;
+    }
+    if (last == NULL) return;
+
+    last->nextSpectator = to->spectators;
+    if (to->spectators != NULL) to->spectators->previousSpectator = last;
+    to->spectators = from->spectators;
+    to->spectatorCount += from->spectatorCount;
+    from->spectators = NULL;
+    from->spectatorCount = 0;
+
+    if (to->open != NULL) releaseBroadcast(&table->broadcastPool, to->open);
+    to->open = NULL;
+}
+
+/*
+ * Desc: Doubles the table capacity until the given file descriptor fits.
+ * Params:
+ *    table - table to grow
+ *    fileDescriptor - file descriptor that has to fit into the table
+ * Returns: 0 if grown, 1 if memory could not be allocated
+ */
+int growRoomTable(struct roomTable *table, int fileDescriptor) {
+    int capacity = table->capacity;
+    while (capacity <= fileDescriptor) capacity *= 2;
+
+    struct connection **byFd = realloc(table->byFd, capacity * sizeof(struct connection *));
+    if (byFd == NULL) return DEFAULT_ERROR_RETURN;
+
+    memset(byFd + table->capacity, 0, (capacity - table->capacity) * sizeof(struct connection *));
+    table->byFd = byFd;
+    table->capacity = capacity;
+    return DEFAULT_RETURN;
+}
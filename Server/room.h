@@ -0,0 +1,126 @@
+#ifndef SERVER_ROOM_H
+#define SERVER_ROOM_H
+
+#include "board.h"
+#include "broadcast.h"
+#include "pool.h"
+#include "protocol.h"
+#include "timer.h"
+
+#define INITIAL_TABLE_CAPACITY 64
+#define AI_OPPONENT -2 // client slot of a room taken by the server-side solver instead of a connection
+#define RESUME_PENDING -3 // client slot of a recovered room whose player has not reconnected yet
+
+struct connection;
+
+/*
+ * Spectators and the match they are shown. The channel of a room shows the matches of that room; the channel of a
+ * board variant, for spectators who asked for any match, shows the first match of the variant opened after the
+ * previous one closed. Frames for the spectators of one loop iteration are collected in the open broadcast, which the
+ * channel holds a reference to until the next iteration broadcasts.
+ */
+struct channel {
+    struct room *room;
+    struct connection *spectators;
+    int spectatorCount;
+    struct broadcast *open;
+    unsigned long openIteration;
+};
+
+/*
+ * Room of two players. The resume tokens let the players take their seats again if the room is recovered from a
+ * snapshot. While a match runs, the turn timer expires when the player to move has not moved in time. The channel of
+ * the room holds the spectators who asked for its match. All rooms of a table are linked into its room list.
+ */
+struct room {
+    int gameState;
+    int client1;
+    int client2;
+    long long startedUs;
+    uint64_t matchId;
+    uint64_t tokens[2];
+    struct board board;
+    struct timer cooldownTimer;
+    struct timer turnTimer;
+    struct channel channel;
+    struct room *nextRoom;
+    struct room *previousRoom;
+};
+
+/*
+ * Session of a connected client. A connection has not joined yet (variant is -1), waits in the lobby of its variant
+ * (ticket is set), plays in a room or watches the channel of a room or of its variant as a spectator. Bytes of frames
+ * that have not been received completely wait in the input buffer, frames the socket did not accept yet in the output
+ * buffer, which is only taken from the buffer pool while there is output. Spectators additionally get the shared
+ * broadcasts of their channel through their feed, which is sent once the output buffer is empty. A dirty connection is
+ * listed for the next flush of its worker. A dropped connection is shut down and only waits for its disconnect to be
+ * processed. Until its first request arrives, the idle timer of a connection runs to evict it if it never joins.
+ */
+struct connection {
+    int fileDescriptor;
+    int variant;
+    int dirty;
+    int dropped;
+    long long acceptedUs;
+    unsigned long ticket;
+    struct timer idleTimer;
+    struct room *room;
+    struct receiveBuffer input;
+    struct sendBuffer *output;
+    struct channel *channel;
+    struct connection *nextSpectator;
+    struct connection *previousSpectator;
+    struct feed *feed;
+};
+
+/*
+ * Session table: maps every connected file descriptor to its connection and the room it plays in. File descriptors
+ * are small dense integers, so the table is a plain array indexed by descriptor and lookups are O(1). Connections,
+ * rooms, output buffers, spectator feeds and broadcasts come from slab pools owned by the table, so connecting,
+ * pairing and sending do not allocate once the pools have grown to the working set. The room list also reaches rooms
+ * without any connection, like recovered rooms whose players have not reconnected yet.
+ */
+struct roomTable {
+    struct connection **byFd;
+    struct room *roomList;
+    int capacity;
+    int roomCount;
+    int connectionCount;
+    struct pool connectionPool;
+    struct pool roomPool;
+    struct pool bufferPool;
+    struct pool feedPool;
+    struct pool broadcastPool;
+};
+
+int initRoomTable(struct roomTable *table);
+
+void freeRoomTable(struct roomTable *table);
+
+struct connection *createConnection(struct roomTable *table, int fileDescriptor);
+
+void destroyConnection(struct roomTable *table, int fileDescriptor);
+
+struct sendBuffer *acquireOutput(struct roomTable *table, struct connection *connection);
+
+void releaseOutput(struct roomTable *table, struct connection *connection);
+
+struct connection *findConnection(struct roomTable *table, int fileDescriptor);
+
+struct room *createRoom(struct roomTable *table, int variant);
+
+void destroyRoom(struct roomTable *table, struct room *room);
+
+struct room *findRoom(struct roomTable *table, int fileDescriptor);
+
+void attachToRoom(struct roomTable *table, int fileDescriptor, struct room *room);
+
+void detachFromRoom(struct roomTable *table, int fileDescriptor);
+
+int subscribeToChannel(struct roomTable *table, struct channel *channel, struct connection *connection);
+
+void unsubscribeFromChannel(struct roomTable *table, struct connection *connection);
+
+void moveSpectators(struct roomTable *table, struct channel *from, struct channel *to);
+
+#endif
@@ -0,0 +1,176 @@
+#include <stdint.h>
+#include <string.h>
+#include "common.h"
+#include "solver.h"
+
+#define SYMMETRY_COUNT 8
+#define LINE_COUNT 8
+#define MASK_COUNT (1 << SOLVER_CELL_COUNT)
+#define UNSOLVED -128
+#define NO_MOVE 0xff
+
+/*
+ * Perfect play table of the 3x3 board. A position is numbered in base 3, digit c being 0 for an empty cell c, 1 for a
+ * stone of player 0 and 2 for one of player 1, so a lookup is one addition of two precomputed digit sums. The table
+ * is solved once at startup, before the workers run, and only read afterwards. Positions equal up to a rotation or
+ * reflection are searched once: every other position copies the result of its canonical form, the smallest number
+ * among its 8 symmetric images, with the best move mapped back.
+ */
+static uint16_t ternaryDigits[MASK_COUNT];
+static uint16_t symmetricMasks[SYMMETRY_COUNT][MASK_COUNT];
+static uint8_t symmetricCells[SYMMETRY_COUNT][SOLVER_CELL_COUNT];
+static int8_t positionScores[SOLVER_POSITION_COUNT];
+static uint8_t bestMoves[SOLVER_POSITION_COUNT];
+
+static const uint16_t lineMasks[LINE_COUNT] = {0007, 0070, 0700, 0111, 0222, 0444, 0421, 0124};
+
+int solvePosition(uint16_t cells[2]);
+
+int isWinningMask(uint16_t mask);
+
+static inline int positionNumber(uint16_t cells[2]) {
+    return ternaryDigits[cells[0]] + 2 * ternaryDigits[cells[1]];
+}
+
+/*
+ * Desc: Builds the symmetry tables and solves every position a match can reach: stones of both players on distinct
+ *       cells, player 0 ahead by at most one stone and no winner yet. Searching from the empty board alone would not
+ *       do, since the search only descends into canonical positions.
+ */
+void initSolver() {
+    for (int symmetry = 0; symmetry < SYMMETRY_COUNT; symmetry++) {
+        for (int cell = 0; cell < SOLVER_CELL_COUNT; cell++) {
+            int x = cell / SOLVER_BOARD_SIZE, y = cell % SOLVER_BOARD_SIZE, last = SOLVER_BOARD_SIZE - 1;
+
+            // Symmetries 4-7 mirror the board at its diagonal first, then each one rotates it by a quarter turn more.
+            if (symmetry >= 4) {
+                int swap = x;
+                x = y;
+                y = swap;
+            }
+            for (int turn = 0; turn < symmetry % 4; turn++) {
+                int rotated = last - x;
+                x = y;
+                y = rotated;
+            }
+            symmetricCells[symmetry][cell] = (uint8_t) (x * SOLVER_BOARD_SIZE + y);
+        }
+    }
+
+    for (int mask = 0; mask < MASK_COUNT; mask++) {
+        int digit = 1;
+
+        for (int cell = 0; cell < SOLVER_CELL_COUNT; cell++, digit *= 3) {
+            if (!(mask & (1 << cell))) continue;
+
+            ternaryDigits[mask] += digit;
+            for (int symmetry = 0; symmetry < SYMMETRY_COUNT; symmetry++) {
+                symmetricMasks[symmetry][mask] |= 1 << symmetricCells[symmetry][cell];
+            }
+        }
+    }
+
+    memset(positionScores, UNSOLVED, sizeof(positionScores));
+    memset(bestMoves, NO_MOVE, sizeof(bestMoves));
+
+    for (int first = 0; first < MASK_COUNT; first++) {
+        for (int second = 0; second < MASK_COUNT; second++) {
+            uint16_t cells[2] = {(uint16_t) first, (uint16_t) second};
+            int lead = __builtin_popcount(first) - __builtin_popcount(second);
+
+            if ((first & second) != 0 || lead < 0 || lead > 1) continue;
+            if (isWinningMask(cells[0]) || isWinningMask(cells[1])) continue;
+            solvePosition(cells);
+        }
+    }
+}
+
+/*
+ * Desc: Looks up the perfect move for the player to move on a 3x3 board.
+ * Params:
+ *    board - 3x3 board of a running match
+ *    x - filled with the row of the move
+ *    y - filled with the column of the move
+ * Returns: 0 if a move was found, 1 if the board is not 3x3 or the match is over
+ */
+int solverMove(const struct board *board, int *x, int *y) {
+    uint16_t cells[2] = {board->cells[0], board->cells[1]};
+
+    if (board->size != SOLVER_BOARD_SIZE || board->winLength != SOLVER_WIN_LENGTH) return DEFAULT_ERROR_RETURN;
+
+    int move = bestMoves[positionNumber(cells)];
+    if (move == NO_MOVE) return DEFAULT_ERROR_RETURN;
+
+    *x = move / SOLVER_BOARD_SIZE;
+    *y = move % SOLVER_BOARD_SIZE;
+    return DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Negamax search of a position without a winner yet, memoized in the position table. Wins score one more than
+ *       the number of cells left after the winning move, so faster wins and slower losses are preferred.
+ * Params:
+ *    cells - stone masks of player 0 and player 1; the player to move follows from the stone count
+ * Returns: score of the position for the player to move, 0 for a draw
+ */
+int solvePosition(uint16_t cells[2]) {
+    int number = positionNumber(cells), canonical = number, canonicalSymmetry = 0;
+    int player = __builtin_popcount(cells[0] | cells[1]) & 1;
+    int emptyCells = SOLVER_CELL_COUNT - __builtin_popcount(cells[0] | cells[1]);
+    int bestScore = -SOLVER_CELL_COUNT - 1, bestMove = NO_MOVE;
+
+    if (positionScores[number] != UNSOLVED) return positionScores[number];
+
+    for (int symmetry = 1; symmetry < SYMMETRY_COUNT; symmetry++) {
+        uint16_t image[2] = {symmetricMasks[symmetry][cells[0]], symmetricMasks[symmetry][cells[1]]};
+        int imageNumber = positionNumber(image);
+
+        if (imageNumber < canonical) {
+            canonical = imageNumber;
+            canonicalSymmetry = symmetry;
+        }
+    }
+
+    if (canonical != number) {
+        uint16_t image[2] = {symmetricMasks[canonicalSymmetry][cells[0]], symmetricMasks[canonicalSymmetry][cells[1]]};
+        positionScores[number] = (int8_t) solvePosition(image);
+
+        for (int cell = 0; cell < SOLVER_CELL_COUNT; cell++) {
+            if (symmetricCells[canonicalSymmetry][cell] == bestMoves[canonical]) bestMoves[number] = (uint8_t) cell;
+        }
+        return positionScores[number];
+    }
+
+    for (int cell = 0; cell < SOLVER_CELL_COUNT && emptyCells > 0; cell++) {
+        uint16_t bit = 1u << cell;
+        int score;
+
+        if ((cells[0] | cells[1]) & bit) continue;
+
+        cells[player] |= bit;
+        if (isWinningMask(cells[player])) score = emptyCells;
+        else score = emptyCells == 1 ? 0 : -solvePosition(cells);
+        cells[player] &= ~bit;
+
+        if (score <= bestScore) continue;
+        bestScore = score;
+        bestMove = cell;
+    }
+
+    positionScores[number] = (int8_t) (emptyCells == 0 ? 0 : bestScore);
+    bestMoves[number] = (uint8_t) bestMove;
+    return positionScores[number];
+}
+
+/*
+ * Desc: Tests whether a stone mask covers a whole row, column or diagonal.
+ * Params:
+ *    mask - stones of one player
+ * Returns: 1 if the mask wins, 0 otherwise
+ */
+int isWinningMask(uint16_t mask) {
+    for (int line = 0; line < LINE_COUNT; line++) {
+        if ((mask & lineMasks[line]) == lineMasks[line]) return 1;
+    }
+    return 0;
+}
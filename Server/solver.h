@@ -0,0 +1,15 @@
+#ifndef SERVER_SOLVER_H
+#define SERVER_SOLVER_H
+
+#include "board.h"
+
+#define SOLVER_BOARD_SIZE 3
+#define SOLVER_WIN_LENGTH 3
+#define SOLVER_CELL_COUNT (SOLVER_BOARD_SIZE * SOLVER_BOARD_SIZE)
+#define SOLVER_POSITION_COUNT 19683 // 3^9, every way to fill the cells with nothing, player 0 or player 1
+
+void initSolver();
+
+int solverMove(const struct board *board, int *x, int *y);
+
+#endif
@@ -0,0 +1,189 @@
+#include <string.h>
+#include <time.h>
+#include "timer.h"
+
+void insertTimer(struct timerWheel *wheel, struct timer *timer);
+
+void cascadeTimers(struct timerWheel *wheel, int level, int slot);
+
+unsigned long elapsedTicks(struct timerWheel *wheel);
+
+/*
+ * Desc: Prepares an empty timer wheel starting at the current time.
+ * Params:
+ *    wheel - wheel to initialize
+ */
+void initTimerWheel(struct timerWheel *wheel) {
+    memset(wheel, 0, sizeof(struct timerWheel));
+    wheel->startMs = monotonicMs();
+}
+
+/*
+ * Desc: Schedules a timer to fire after the given delay. A timer that is already pending is rescheduled.
+ * Params:
+ *    wheel - wheel to schedule the timer on
+ *    timer - timer to schedule
+ *    delayMs - delay in milliseconds, rounded up to the next tick
+ *    callback - function called with the timer and the context given to runExpiredTimers
+ */
+void scheduleTimer(struct timerWheel *wheel, struct timer *timer, int delayMs,
+                   void (*callback)(struct timer *timer, void *context)) {
+    cancelTimer(timer);
+
+    timer->wheel = wheel;
+    timer->callback = callback;
+    timer->expires = elapsedTicks(wheel) + (delayMs + TIMER_TICK_MS - 1) / TIMER_TICK_MS;
+    insertTimer(wheel, timer);
+    wheel->pendingCount++;
+}
+
+/*
+ * Desc: Removes a pending timer from its wheel. Cancelling a timer that is not pending does nothing.
+ * Params:
+ *    timer - timer to cancel
+ */
+void cancelTimer(struct timer *timer) {
+    if (!isTimerPending(timer)) return;
+
+    *timer->previous = timer->next;
+    if (timer->next != NULL) timer->next->previous = timer->previous;
+
+    timer->wheel->pendingCount--;
+    timer->next = NULL;
+    timer->previous = NULL;
+}
+
+/*
+ * Desc: Checks if a timer is waiting to fire.
+ * Params:
+ *    timer - timer to check
+ * Returns: 1 if pending, 0 otherwise
+ */
+int isTimerPending(struct timer *timer) {
+    return timer->previous != NULL;
+}
+
+/*
+ * Desc: Calculates how long the event loop may sleep before the next timer is due.
+ * Params:
+ *    wheel - wheel to check
+ * Returns: -1 if no timer is pending, milliseconds until the next timer or cascade otherwise
+ */
+int nextTimerTimeout(struct timerWheel *wheel) {
+    if (wheel->pendingCount == 0) return -1;
+
+    long long nextTickMs = wheel->startMs + (long long) (wheel->currentTick + 1) * TIMER_TICK_MS;
+    int ticks = 0;
+
+    // Only level 0 is searched; timers of higher levels are due no earlier than the next cascade at slot 0.
+    while (ticks < TIMER_WHEEL_SLOTS) {
+        int slot = (wheel->currentTick + ticks) & TIMER_WHEEL_MASK;
+        if (slot == 0 || wheel->slots[0][slot] != NULL) break;
+        ticks++;
+    }
+
+    long long timeout = nextTickMs + (long long) (ticks - 1) * TIMER_TICK_MS - monotonicMs();
+    return timeout < 0 ? 0 : (int) timeout;
+}
+
+/*
+ * Desc: Advances the wheel to the current time and calls the callbacks of all expired timers. Callbacks may schedule
+ *       and cancel timers, including their own.
+ * Params:
+ *    wheel - wheel to advance
+ *    context - pointer passed to every callback
+ */
+void runExpiredTimers(struct timerWheel *wheel, void *context) {
+    unsigned long targetTick = elapsedTicks(wheel);
+
+    while (wheel->currentTick <= targetTick) {
+        unsigned long tick = wheel->currentTick;
+        int slot = tick & TIMER_WHEEL_MASK;
+
+        for (int level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+            if (((tick >> ((level - 1) * TIMER_WHEEL_BITS)) & TIMER_WHEEL_MASK) != 0) break;
+            cascadeTimers(wheel, level, (tick >> (level * TIMER_WHEEL_BITS)) & TIMER_WHEEL_MASK);
+        }
+
+        // Timers scheduled by the callbacks below land in the following ticks, never in the slot being emptied.
+        wheel->currentTick = tick + 1;
+
+        struct timer *timer;
+        while ((timer = wheel->slots[0][slot]) != NULL) {
+            cancelTimer(timer);
+            timer->callback(timer, context);
+        }
+    }
+}
+
+/*
+ * Desc: Reads the monotonic clock.
+ * Returns: milliseconds since an arbitrary fixed point
+ */
+long long monotonicMs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/*
+ * Desc: Reads the monotonic clock with microsecond resolution.
+ * Returns: microseconds since the same fixed point as monotonicMs
+ */
+long long monotonicUs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+/*
+ * Desc: Links a timer into the slot matching its expiry relative to the current tick.
+ * Params:
+ *    wheel - wheel to link the timer into
+ *    timer - timer with the expiry already set
+ */
+void insertTimer(struct timerWheel *wheel, struct timer *timer) {
+    if (timer->expires < wheel->currentTick) timer->expires = wheel->currentTick;
+
+    unsigned long delta = timer->expires - wheel->currentTick;
+    int level = 0;
+
+    while (level < TIMER_WHEEL_LEVELS - 1 && delta >= (1UL << ((level + 1) * TIMER_WHEEL_BITS))) level++;
+    if (delta >= (1UL << (TIMER_WHEEL_LEVELS * TIMER_WHEEL_BITS))) {
+        timer->expires = wheel->currentTick + (1UL << (TIMER_WHEEL_LEVELS * TIMER_WHEEL_BITS)) - 1;
+    }
+
+    struct timer **slot = &wheel->slots[level][(timer->expires >> (level * TIMER_WHEEL_BITS)) & TIMER_WHEEL_MASK];
+    timer->next = *slot;
+    if (timer->next != NULL) timer->next->previous = &timer->next;
+    timer->previous = slot;
+    *slot = timer;
+}
+
+/*
+ * Desc: Moves all timers of a higher level slot down to the levels matching their remaining time.
+ * Params:
+ *    wheel - wheel to update
+ *    level - level of the slot
+ *    slot - slot to empty
+ */
+void cascadeTimers(struct timerWheel *wheel, int level, int slot) {
+    struct timer *timer = wheel->slots[level][slot];
+    wheel->slots[level][slot] = NULL;
+
+    while (timer != NULL) {
+        struct timer *next = timer->next;
+        insertTimer(wheel, timer);
+        timer = next;
+    }
+}
+
+/*
+ * Desc: Converts the time passed since the wheel was started into ticks.
+ * Params:
+ *    wheel - wheel to check
+ * Returns: number of whole ticks since the start of the wheel
+ */
+unsigned long elapsedTicks(struct timerWheel *wheel) {
+    return (unsigned long) ((monotonicMs() - wheel->startMs) / TIMER_TICK_MS);
+}
@@ -0,0 +1,56 @@
+#ifndef SERVER_TIMER_H
+#define SERVER_TIMER_H
+
+#include <stddef.h>
+
+#define TIMER_TICK_MS 10
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SLOTS - 1)
+#define TIMER_WHEEL_LEVELS 4
+
+#define containerOf(pointer, type, member) ((type *) ((char *) (pointer) - offsetof(type, member)))
+
+struct timerWheel;
+
+/*
+ * Timer embedded into the object it belongs to. The callback recovers the object with containerOf.
+ */
+struct timer {
+    struct timer *next;
+    struct timer **previous;
+    struct timerWheel *wheel;
+    unsigned long expires;
+    void (*callback)(struct timer *timer, void *context);
+};
+
+/*
+ * Hierarchical timer wheel: level 0 holds timers due within TIMER_WHEEL_SLOTS ticks, each following level covers
+ * TIMER_WHEEL_SLOTS times the range of the previous one and is cascaded down when the lower level wraps around.
+ * Scheduling and cancelling are O(1).
+ */
+struct timerWheel {
+    unsigned long currentTick;
+    long long startMs;
+    int pendingCount;
+    struct timer *slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+};
+
+void initTimerWheel(struct timerWheel *wheel);
+
+void scheduleTimer(struct timerWheel *wheel, struct timer *timer, int delayMs,
+                   void (*callback)(struct timer *timer, void *context));
+
+void cancelTimer(struct timer *timer);
+
+int isTimerPending(struct timer *timer);
+
+int nextTimerTimeout(struct timerWheel *wheel);
+
+void runExpiredTimers(struct timerWheel *wheel, void *context);
+
+long long monotonicMs();
+
+long long monotonicUs();
+
+#endif
@@ -0,0 +1,169 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "common.h"
+#include "timer.h"
+#include "trace.h"
+
+void *runTraceWriter(void *argument);
+
+int writeTraceRecords(struct tracer *tracer);
+
+/*
+ * Desc: Prepares one ring per tracing thread. Records are written once the writer has been started.
+ * Params:
+ *    tracer - tracer to open
+ *    ringCount - number of threads tracing
+ *    level - TRACE_OFF, TRACE_INFO or TRACE_DEBUG
+ *    output - stream the writer formats the records to
+ * Returns: 0 if opened, 1 if error occurred with errno set
+ */
+int openTracer(struct tracer *tracer, int ringCount, int level, FILE *output) {
+    memset(tracer, 0, sizeof(struct tracer));
+    atomic_init(&tracer->level, level);
+    atomic_init(&tracer->stopping, 0);
+    tracer->ringCount = ringCount;
+    tracer->output = output;
+    tracer->startUs = monotonicUs();
+
+    if ((tracer->rings = aligned_alloc(64, ringCount * sizeof(struct traceRing))) == NULL) return DEFAULT_ERROR_RETURN;
+
+    for (int i = 0; i < ringCount; i++) {
+        atomic_init(&tracer->rings[i].tail, 0);
+        atomic_init(&tracer->rings[i].head, 0);
+        atomic_init(&tracer->rings[i].dropped, 0);
+        tracer->rings[i].reportedDrops = 0;
+        tracer->rings[i].level = &tracer->level;
+    }
+    return DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Starts the writer thread of an open tracer.
+ * Params:
+ *    tracer - open tracer
+ * Returns: 0 if started, otherwise the error of pthread_create
+ */
+int startTracer(struct tracer *tracer) {
+    int error = pthread_create(&tracer->writer, NULL, runTraceWriter, tracer);
+    tracer->writing = error == 0;
+    return error;
+}
+
+/*
+ * Desc: Stops the writer thread once it has written every record still queued, then frees the rings. No thread may
+ *       trace anymore.
+ * Params:
+ *    tracer - tracer to close
+ */
+void closeTracer(struct tracer *tracer) {
+    if (tracer->writing) {
+        atomic_store(&tracer->stopping, 1);
+        pthread_join(tracer->writer, NULL);
+        tracer->writing = 0;
+    }
+
+    free(tracer->rings);
+    tracer->rings = NULL;
+}
+
+/*
+ * Desc: Changes the level of a tracer. Safe to call from any thread while the others keep tracing.
+ * Params:
+ *    tracer - tracer to update
+ *    level - TRACE_OFF, TRACE_INFO or TRACE_DEBUG
+ */
+void setTraceLevel(struct tracer *tracer, int level) {
+    atomic_store_explicit(&tracer->level, level, memory_order_relaxed);
+}
+
+/*
+ * Desc: Queues a record for the writer thread. Called by the thread owning the ring only; never blocks.
+ * Params:
+ *    ring - ring of the calling thread
+ *    format - string literal with up to three int conversions
+ *    a, b, c - arguments of the conversions
+ * Returns: 0 if queued, -1 if the ring is full and the record was dropped
+ */
+int appendTraceRecord(struct traceRing *ring, const char *format, int a, int b, int c) {
+    unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    struct traceRecord *record;
+
+    if (tail - atomic_load_explicit(&ring->head, memory_order_acquire) == TRACE_RING_CAPACITY) {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return -1;
+    }
+
+    record = &ring->records[tail & (TRACE_RING_CAPACITY - 1)];
+    record->timeUs = monotonicUs();
+    record->format = format;
+    record->arguments[0] = a;
+    record->arguments[1] = b;
+    record->arguments[2] = c;
+
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Writer thread of the tracer: formats the records of all rings and flushes the output once per pass, sleeping
+ *       while every ring is empty. Stops once the tracer is stopping and the rings are drained.
+ * Params:
+ *    argument - the tracer to write
+ * Returns: NULL
+ */
+void *runTraceWriter(void *argument) {
+    struct tracer *tracer = argument;
+    struct timespec idle = {0, TRACE_IDLE_SLEEP * 1000000L};
+
+    while (1) {
+        int stopping = atomic_load(&tracer->stopping);
+        int recordCount = writeTraceRecords(tracer);
+
+        if (recordCount > 0) fflush(tracer->output);
+        if (stopping && recordCount == 0) break;
+        if (recordCount == 0) nanosleep(&idle, NULL);
+    }
+
+    return NULL;
+}
+
+/*
+ * Desc: Formats the queued records of all rings, prefixed with the seconds since the tracer was opened and the thread
+ *       that traced them; the last ring belongs to the main thread. Records dropped since the last pass are reported
+ *       in their place.
+ * Params:
+ *    tracer - tracer whose rings to drain
+ * Returns: number of records written
+ */
+int writeTraceRecords(struct tracer *tracer) {
+    int recordCount = 0;
+
+    for (int i = 0; i < tracer->ringCount; i++) {
+        struct traceRing *ring = &tracer->rings[i];
+        unsigned int head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        unsigned int dropped = atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+
+        for (; head != tail; head++, recordCount++) {
+            struct traceRecord *record = &ring->records[head & (TRACE_RING_CAPACITY - 1)];
+            long long elapsedUs = record->timeUs - tracer->startUs;
+
+            if (i == tracer->ringCount - 1) {
+                fprintf(tracer->output, "%lld.%06lld main: ", elapsedUs / 1000000, elapsedUs % 1000000);
+            } else {
+                fprintf(tracer->output, "%lld.%06lld worker %d: ", elapsedUs / 1000000, elapsedUs % 1000000, i);
+            }
+            fprintf(tracer->output, record->format, record->arguments[0], record->arguments[1], record->arguments[2]);
+        }
+        atomic_store_explicit(&ring->head, head, memory_order_release);
+
+        if (dropped != ring->reportedDrops) {
+            fprintf(tracer->output, "Dropped %u trace records of ring %d.\n", dropped - ring->reportedDrops, i);
+            ring->reportedDrops = dropped;
+            recordCount++;
+        }
+    }
+
+    return recordCount;
+}
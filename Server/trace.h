@@ -0,0 +1,73 @@
+#ifndef SERVER_TRACE_H
+#define SERVER_TRACE_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+
+#define TRACE_OFF 0
+#define TRACE_INFO 1 // players joining, matches, handoffs and recovery
+#define TRACE_DEBUG 2 // every connection, frame and loop iteration
+
+#define TRACE_RING_CAPACITY 4096 // power of two, records a thread may get ahead of the writer before dropping
+#define TRACE_IDLE_SLEEP 10 // milliseconds the writer sleeps when every ring is empty
+
+/*
+ * Trace message as it travels to the writer thread: the format is a string literal of the server taking up to three
+ * int conversions, so it is formatted by the writer and never on the thread that traced it.
+ */
+struct traceRecord {
+    long long timeUs;
+    const char *format;
+    int arguments[3];
+};
+
+/*
+ * Records from one thread to the writer thread. Like the rings of the match log, the tracing thread only moves the
+ * tail and the writer only the head; a full ring drops the record and counts it.
+ */
+struct traceRing {
+    _Alignas(64) atomic_uint tail;
+    atomic_uint dropped;
+    const atomic_int *level;
+    _Alignas(64) atomic_uint head;
+    unsigned int reportedDrops;
+    struct traceRecord records[TRACE_RING_CAPACITY];
+};
+
+/*
+ * Trace output of the server. Every worker and the main thread trace into a ring of their own, and a background
+ * thread formats the records and writes them to the output, so a disabled level costs a relaxed load and an enabled
+ * one a clock read and a copy. The level may be changed at any time and takes effect on the next record.
+ */
+struct tracer {
+    atomic_int level;
+    int ringCount;
+    struct traceRing *rings;
+    FILE *output;
+    long long startUs;
+    pthread_t writer;
+    int writing;
+    atomic_int stopping;
+};
+
+int openTracer(struct tracer *tracer, int ringCount, int level, FILE *output);
+
+int startTracer(struct tracer *tracer);
+
+void closeTracer(struct tracer *tracer);
+
+void setTraceLevel(struct tracer *tracer, int level);
+
+int appendTraceRecord(struct traceRing *ring, const char *format, int a, int b, int c);
+
+/*
+ * Traces a message if the current level includes it. Kept inline so a disabled level costs no call.
+ */
+static inline void traceEvent(struct traceRing *ring, int level, const char *format, int a, int b, int c) {
+    if (ring != NULL && atomic_load_explicit(ring->level, memory_order_relaxed) >= level) {
+        appendTraceRecord(ring, format, a, b, c);
+    }
+}
+
+#endif
@@ -0,0 +1,747 @@
+#include <errno.h>
+#include <poll.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include "common.h"
+#include "uring.h"
+
+int setupRing(struct io_uring_params *params);
+
+int mapRing(struct uring *ring, struct io_uring_params *params);
+
+int provideBuffers(struct uring *ring);
+
+void recycleBuffer(struct uring *ring, int bufferId);
+
+struct uringDescriptor *descriptorOf(struct uring *ring, int fileDescriptor);
+
+struct io_uring_sqe *prepareEntry(struct uring *ring, int opcode, int fileDescriptor, int operation);
+
+int armReceive(struct uring *ring, int fileDescriptor);
+
+int armAccept(struct uring *ring, int fileDescriptor);
+
+int armPoll(struct uring *ring, int fileDescriptor);
+
+int armWritable(struct uring *ring, int fileDescriptor);
+
+int enterRing(struct uring *ring, int getEvents, unsigned waitCount, int timeoutMs);
+
+void harvestCompletions(struct eventLoop *loop);
+
+void handleCompletion(struct eventLoop *loop, struct io_uring_cqe *completion);
+
+void addReadyEvent(struct eventLoop *loop, uint32_t events, int fileDescriptor, int operation, int result,
+                   int bufferId);
+
+/*
+ * Desc: Checks that the kernel offers everything the io_uring engine needs by setting up a ring and closing it again.
+ * Returns: 0 if io_uring can be used, 1 otherwise
+ */
+int probeUring() {
+    struct eventLoop loop;
+
+    memset(&loop, 0, sizeof(struct eventLoop));
+    if (initUring(&loop) != 0) return DEFAULT_ERROR_RETURN;
+    closeUring(&loop);
+    return DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Sets up the ring of a cleared loop with its provided buffers. Needs Linux 6.0 or later for multishot receives.
+ * Params:
+ *    loop - loop to back with an io_uring instance
+ * Returns: 0 if set up, 1 if io_uring is not available or error occurred
+ */
+int initUring(struct eventLoop *loop) {
+    struct io_uring_params params;
+    struct uring *ring;
+
+    loop->epollFd = -1;
+    if ((ring = loop->uring = calloc(1, sizeof(struct uring))) == NULL) return DEFAULT_ERROR_RETURN;
+    ring->ringFd = -1;
+
+    if ((ring->ringFd = setupRing(&params)) < 0 ||
+        (params.features & (IORING_FEAT_EXT_ARG | IORING_FEAT_NODROP)) != (IORING_FEAT_EXT_ARG | IORING_FEAT_NODROP) ||
+        mapRing(ring, &params) != 0 || provideBuffers(ring) != 0) {
+        closeUring(loop);
+        return DEFAULT_ERROR_RETURN;
+    }
+
+    return DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Tears down the ring of a loop. Requests still in flight are cancelled by the kernel.
+ * Params:
+ *    loop - loop backed by a ring
+ */
+void closeUring(struct eventLoop *loop) {
+    struct uring *ring = loop->uring;
+    if (ring == NULL) return;
+
+    if (ring->ringFd >= 0) close(ring->ringFd);
+    if (ring->entries != NULL) munmap(ring->entries, ring->entriesSize);
+    if (ring->completionRing != NULL && ring->completionRing != ring->submissionRing) {
+        munmap(ring->completionRing, ring->completionRingSize);
+    }
+    if (ring->submissionRing != NULL) munmap(ring->submissionRing, ring->submissionRingSize);
+    if (ring->bufferRing != NULL) munmap(ring->bufferRing, URING_BUFFER_COUNT * sizeof(struct io_uring_buf));
+
+    free(ring->buffers);
+    free(ring->descriptors);
+    free(ring);
+    loop->uring = NULL;
+}
+
+/*
+ * Desc: Creates the ring. Task work only runs when the worker enters the kernel anyway and a failing entry does not
+ *       hold up the ones behind it; kernels that do not know these flags get a plain ring.
+ * Params:
+ *    params - filled with the parameters of the ring
+ * Returns: file descriptor of the ring, -1 if error occurred
+ */
+int setupRing(struct io_uring_params *params) {
+    unsigned flagSets[2] = {IORING_SETUP_COOP_TASKRUN | IORING_SETUP_SUBMIT_ALL, 0};
+    int ringFd = -1;
+
+    for (int i = 0; i < 2 && ringFd < 0; i++) {
+        memset(params, 0, sizeof(struct io_uring_params));
+        params->flags = flagSets[i] | IORING_SETUP_CQSIZE;
+        params->cq_entries = 4 * URING_QUEUE_DEPTH;
+        ringFd = (int) syscall(__NR_io_uring_setup, URING_QUEUE_DEPTH, params);
+    }
+    return ringFd;
+}
+
+/*
+ * Desc: Maps the submission and completion rings and the submission entries into memory. Entries are always taken in
+ *       order, so the index array of the submission ring is filled once.
+ * Params:
+ *    ring - ring to map
+ *    params - parameters returned by the setup
+ * Returns: 0 if mapped, 1 if error occurred
+ */
+int mapRing(struct uring *ring, struct io_uring_params *params) {
+    int singleMap = (params->features & IORING_FEAT_SINGLE_MMAP) != 0;
+    void *mapped;
+    unsigned *indices;
+
+    ring->submissionRingSize = params->sq_off.array + params->sq_entries * sizeof(unsigned);
+    ring->completionRingSize = params->cq_off.cqes + params->cq_entries * sizeof(struct io_uring_cqe);
+    if (singleMap && ring->completionRingSize > ring->submissionRingSize) {
+        ring->submissionRingSize = ring->completionRingSize;
+    }
+
+    mapped = mmap(NULL, ring->submissionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->ringFd,
+                  IORING_OFF_SQ_RING);
+    if (mapped == MAP_FAILED) return DEFAULT_ERROR_RETURN;
+    ring->submissionRing = mapped;
+
+    if (singleMap) {
+        ring->completionRing = ring->submissionRing;
+    } else {
+        mapped = mmap(NULL, ring->completionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring->ringFd, IORING_OFF_CQ_RING);
+        if (mapped == MAP_FAILED) return DEFAULT_ERROR_RETURN;
+        ring->completionRing = mapped;
+    }
+
+    ring->entriesSize = params->sq_entries * sizeof(struct io_uring_sqe);
+    mapped = mmap(NULL, ring->entriesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->ringFd,
+                  IORING_OFF_SQES);
+    if (mapped == MAP_FAILED) return DEFAULT_ERROR_RETURN;
+    ring->entries = mapped;
+
+    ring->submissionHead = (unsigned *) ((char *) ring->submissionRing + params->sq_off.head);
+    ring->submissionTail = (unsigned *) ((char *) ring->submissionRing + params->sq_off.tail);
+    ring->submissionMask = *(unsigned *) ((char *) ring->submissionRing + params->sq_off.ring_mask);
+    ring->submissionEntries = params->sq_entries;
+    ring->preparedTail = *ring->submissionTail;
+    indices = (unsigned *) ((char *) ring->submissionRing + params->sq_off.array);
+    for (unsigned i = 0; i < params->sq_entries; i++) indices[i] = i;
+
+    ring->completionHead = (unsigned *) ((char *) ring->completionRing + params->cq_off.head);
+    ring->completionTail = (unsigned *) ((char *) ring->completionRing + params->cq_off.tail);
+    ring->completionMask = *(unsigned *) ((char *) ring->completionRing + params->cq_off.ring_mask);
+    ring->completions = (struct io_uring_cqe *) ((char *) ring->completionRing + params->cq_off.cqes);
+    return DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Registers the provided buffer ring (buffer group 0) and hands every buffer to the kernel.
+ * Params:
+ *    ring - ring to provide buffers to
+ * Returns: 0 if registered, 1 if error occurred
+ */
+int provideBuffers(struct uring *ring) {
+    struct io_uring_buf_reg registration;
+    void *mapped = mmap(NULL, URING_BUFFER_COUNT * sizeof(struct io_uring_buf), PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (mapped == MAP_FAILED) return DEFAULT_ERROR_RETURN;
+    ring->bufferRing = mapped;
+    if ((ring->buffers = malloc((size_t) URING_BUFFER_COUNT * URING_BUFFER_SIZE)) == NULL) return DEFAULT_ERROR_RETURN;
+
+    memset(&registration, 0, sizeof(struct io_uring_buf_reg));
+    registration.ring_addr = (uint64_t) (uintptr_t) ring->bufferRing;
+    registration.ring_entries = URING_BUFFER_COUNT;
+    registration.bgid = 0;
+    if (syscall(__NR_io_uring_register, ring->ringFd, IORING_REGISTER_PBUF_RING, &registration, 1) != 0) {
+        return DEFAULT_ERROR_RETURN;
+    }
+
+    for (int i = 0; i < URING_BUFFER_COUNT; i++) recycleBuffer(ring, i);
+    return DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Gives a provided buffer back to the kernel once its data has been copied out. The tail of the buffer ring
+ *       shares its memory with the first entry, so the fields are written one by one.
+ * Params:
+ *    ring - ring owning the buffer
+ *    bufferId - id of the buffer
+ */
+void recycleBuffer(struct uring *ring, int bufferId) {
+    struct io_uring_buf *buffer = &ring->bufferRing->bufs[ring->bufferTail & (URING_BUFFER_COUNT - 1)];
+
+    buffer->addr = (uint64_t) (uintptr_t) (ring->buffers + (size_t) bufferId * URING_BUFFER_SIZE);
+    buffer->len = URING_BUFFER_SIZE;
+    buffer->bid = (uint16_t) bufferId;
+    ring->bufferTail++;
+    atomic_store_explicit((_Atomic uint16_t *) &ring->bufferRing->tail, ring->bufferTail, memory_order_release);
+}
+
+/*
+ * Desc: Returns the state of a descriptor, growing the table like the session table when a larger one shows up.
+ * Params:
+ *    ring - ring of the loop
+ *    fileDescriptor - descriptor to look up
+ * Returns: state of the descriptor or NULL if memory could not be allocated
+ */
+struct uringDescriptor *descriptorOf(struct uring *ring, int fileDescriptor) {
+    if (fileDescriptor < 0 || fileDescriptor > 0xffffff) return NULL;
+
+    if (fileDescriptor >= ring->descriptorCapacity) {
+        int capacity = ring->descriptorCapacity == 0 ? 64 : ring->descriptorCapacity;
+        while (capacity <= fileDescriptor) capacity *= 2;
+
+        struct uringDescriptor *descriptors = realloc(ring->descriptors, capacity * sizeof(struct uringDescriptor));
+        if (descriptors == NULL) return NULL;
+
+        memset(descriptors + ring->descriptorCapacity, 0,
+               (capacity - ring->descriptorCapacity) * sizeof(struct uringDescriptor));
+        ring->descriptors = descriptors;
+        ring->descriptorCapacity = capacity;
+    }
+    return &ring->descriptors[fileDescriptor];
+}
+
+/*
+ * Desc: Takes the next submission entry and tags it with the operation, the descriptor and its generation. A full
+ *       submission queue is submitted first.
+ * Params:
+ *    ring - ring to prepare the entry in
+ *    opcode - io_uring opcode
+ *    fileDescriptor - descriptor the operation works on
+ *    operation - URING_ACCEPT, URING_POLL, URING_RECEIVE, URING_SEND, URING_WRITABLE or URING_CANCEL
+ * Returns: the cleared entry or NULL if the queue stays full
+ */
+struct io_uring_sqe *prepareEntry(struct uring *ring, int opcode, int fileDescriptor, int operation) {
+    unsigned head = atomic_load_explicit((_Atomic unsigned *) ring->submissionHead, memory_order_acquire);
+    struct io_uring_sqe *entry;
+
+    if (ring->preparedTail - head == ring->submissionEntries) {
+        enterRing(ring, 0, 0, 0);
+        head = atomic_load_explicit((_Atomic unsigned *) ring->submissionHead, memory_order_acquire);
+        if (ring->preparedTail - head == ring->submissionEntries) return NULL;
+    }
+
+    entry = &ring->entries[ring->preparedTail & ring->submissionMask];
+    memset(entry, 0, sizeof(struct io_uring_sqe));
+    entry->opcode = (uint8_t) opcode;
+    entry->fd = fileDescriptor;
+    entry->user_data = (uint64_t) operation << 56 | (uint64_t) ring->descriptors[fileDescriptor].generation << 24 |
+                       (uint64_t) fileDescriptor;
+    ring->preparedTail++;
+    return entry;
+}
+
+/*
+ * Desc: Keeps a multishot receive in flight for a connection, reading into the provided buffers.
+ * Params:
+ *    ring - ring of the loop
+ *    fileDescriptor - connection to receive from
+ * Returns: 0 if prepared, 1 if the submission queue is full
+ */
+int armReceive(struct uring *ring, int fileDescriptor) {
+    struct io_uring_sqe *entry = prepareEntry(ring, IORING_OP_RECV, fileDescriptor, URING_RECEIVE);
+    if (entry == NULL) return DEFAULT_ERROR_RETURN;
+
+    entry->ioprio = IORING_RECV_MULTISHOT;
+    entry->flags = IOSQE_BUFFER_SELECT;
+    entry->buf_group = 0;
+    ring->descriptors[fileDescriptor].receiving = 1;
+    return DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Keeps a multishot accept in flight for a listener. Accepted sockets are non-blocking like those of accept4.
+ * Params:
+ *    ring - ring of the loop
+ *    fileDescriptor - listener
+ * Returns: 0 if prepared, 1 if the submission queue is full
+ */
+int armAccept(struct uring *ring, int fileDescriptor) {
+    struct io_uring_sqe *entry = prepareEntry(ring, IORING_OP_ACCEPT, fileDescriptor, URING_ACCEPT);
+    if (entry == NULL) return DEFAULT_ERROR_RETURN;
+
+    entry->ioprio = IORING_ACCEPT_MULTISHOT;
+    entry->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    return DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Keeps a multishot poll for readability in flight, e.g. for the eventfd of the mailbox.
+ * Params:
+ *    ring - ring of the loop
+ *    fileDescriptor - descriptor to watch
+ * Returns: 0 if prepared, 1 if the submission queue is full
+ */
+int armPoll(struct uring *ring, int fileDescriptor) {
+    struct io_uring_sqe *entry = prepareEntry(ring, IORING_OP_POLL_ADD, fileDescriptor, URING_POLL);
+    if (entry == NULL) return DEFAULT_ERROR_RETURN;
+
+    entry->poll32_events = POLLIN;
+    entry->len = IORING_POLL_ADD_MULTI;
+    return DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Asks once to be told when a full socket accepts data again, unless that was asked already.
+ * Params:
+ *    ring - ring of the loop
+ *    fileDescriptor - socket to watch
+ * Returns: 0 if prepared, 1 if the submission queue is full
+ */
+int armWritable(struct uring *ring, int fileDescriptor) {
+    struct io_uring_sqe *entry;
+
+    if (ring->descriptors[fileDescriptor].waitingWritable) return DEFAULT_RETURN;
+    if ((entry = prepareEntry(ring, IORING_OP_POLL_ADD, fileDescriptor, URING_WRITABLE)) == NULL) {
+        return DEFAULT_ERROR_RETURN;
+    }
+
+    entry->poll32_events = POLLOUT;
+    ring->descriptors[fileDescriptor].waitingWritable = 1;
+    return DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Submits every prepared entry and optionally waits for completions, all in one io_uring_enter. Nothing is
+ *       entered if there is neither anything to submit nor to wait for.
+ * Params:
+ *    ring - ring to enter
+ *    getEvents - 1 to run pending completion work of the kernel
+ *    waitCount - number of completions to wait for, 0 to return right away
+ *    timeoutMs - maximum time to wait in milliseconds, -1 to wait until the completions arrive
+ * Returns: 0 if entered or the wait timed out, -1 if error occurred
+ */
+int enterRing(struct uring *ring, int getEvents, unsigned waitCount, int timeoutMs) {
+    unsigned head = atomic_load_explicit((_Atomic unsigned *) ring->submissionHead, memory_order_acquire);
+    unsigned submitCount = ring->preparedTail - head;
+    struct io_uring_getevents_arg argument;
+    struct __kernel_timespec timeout;
+    unsigned flags = getEvents ? IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG : 0;
+    long result;
+
+    atomic_store_explicit((_Atomic unsigned *) ring->submissionTail, ring->preparedTail, memory_order_release);
+    if (submitCount == 0 && !getEvents) return DEFAULT_RETURN;
+
+    memset(&argument, 0, sizeof(struct io_uring_getevents_arg));
+    timeout.tv_sec = timeoutMs / 1000;
+    timeout.tv_nsec = (long long) (timeoutMs % 1000) * 1000000;
+    argument.ts = timeoutMs >= 0 ? (uint64_t) (uintptr_t) &timeout : 0;
+
+    result = syscall(__NR_io_uring_enter, ring->ringFd, submitCount, waitCount, flags, getEvents ? &argument : NULL,
+                     sizeof(struct io_uring_getevents_arg));
+    if (result < 0 && errno != ETIME && errno != EINTR && errno != EBUSY) return -1;
+    return DEFAULT_RETURN;
+}
+
+/*
+ * Desc: Registers a listener: the multishot accept completes once per accepted connection.
+ * Params:
+ *    loop - loop backed by a ring
+ *    fileDescriptor - listener
+ * Returns: 0 if registered, 1 if error occurred
+ */
+int uringWatchListener(struct eventLoop *loop, int fileDescriptor) {
+    struct uringDescriptor *descriptor = descriptorOf(loop->uring, fileDescriptor);
+    if (descriptor == NULL) return DEFAULT_ERROR_RETURN;
+
+    descriptor->generation++;
+    return armAccept(loop->uring, fileDescriptor);
+}
+
+/*
+ * Desc: Registers a descriptor for readability, reported without reading from it.
+ * Params:
+ *    loop - loop backed by a ring
+ *    fileDescriptor - descriptor to watch
+ * Returns: 0 if registered, 1 if error occurred
+ */
+int uringWatchDescriptor(struct eventLoop *loop, int fileDescriptor) {
+    struct uringDescriptor *descriptor = descriptorOf(loop->uring, fileDescriptor);
+    if (descriptor == NULL) return DEFAULT_ERROR_RETURN;
+
+    descriptor->generation++;
+    return armPoll(loop->uring, fileDescriptor);
+}
+
+/*
+ * Desc: Registers a connection: its data arrives in provided buffers without further requests.
+ * Params:
+ *    loop - loop backed by a ring
+ *    fileDescriptor - connection to watch
+ * Returns: 0 if registered, 1 if error occurred
+ */
+int uringWatchConnection(struct eventLoop *loop, int fileDescriptor) {
+    struct uringDescriptor *descriptor = descriptorOf(loop->uring, fileDescriptor);
+    if (descriptor == NULL) return DEFAULT_ERROR_RETURN;
+
+    descriptor->generation++;
+    descriptor->sending = 0;
+    descriptor->waitingWritable = 0;
+    return armReceive(loop->uring, fileDescriptor);
+}
+
+/*
+ * Desc: Stops watching a descriptor, which may be closed or handed to another worker right after. Requests still in
+ *       flight are cancelled and prepared sends submitted right away, so nothing refers to the descriptor once it is
+ *       closed and the kernel hands its number to the next connection.
+ * Params:
+ *    loop - loop backed by a ring
+ *    fileDescriptor - descriptor to forget
+ */
+void uringUnwatch(struct eventLoop *loop, int fileDescriptor) {
+    struct uring *ring = loop->uring;
+    struct uringDescriptor *descriptor = descriptorOf(ring, fileDescriptor);
+    struct io_uring_sqe *entry;
+
+    if (descriptor == NULL) return;
+
+    if ((descriptor->receiving || descriptor->waitingWritable) &&
+        (entry = prepareEntry(ring, IORING_OP_ASYNC_CANCEL, fileDescriptor, URING_CANCEL)) != NULL) {
+        entry->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+    }
+    if (descriptor->receiving || descriptor->waitingWritable || descriptor->sending) enterRing(ring, 0, 0, 0);
+
+    descriptor->generation++;
+    descriptor->receiving = 0;
+    descriptor->sending = 0;
+    descriptor->waitingWritable = 0;
+}
+
+/*
+ * Desc: Submits the prepared entries and, unless ready events or completions are left from before, waits for new
+ *       completions, then turns them into ready events.
+ * Params:
+ *    loop - loop backed by a ring
+ *    timeoutMs - maximum time to wait in milliseconds, -1 to wait until a completion arrives
+ * Returns: number of ready events or -1 if entering the ring failed
+ */
+int uringWait(struct eventLoop *loop, int timeoutMs) {
+    struct uring *ring = loop->uring;
+    unsigned head = *ring->completionHead;
+    int waiting = loop->nextReady >= loop->readyCount &&
+                  atomic_load_explicit((_Atomic unsigned *) ring->completionTail, memory_order_acquire) == head;
+
+    if (enterRing(ring, waiting, waiting && timeoutMs != 0, timeoutMs) != 0) return -1;
+    if (loop->nextReady < loop->readyCount) return loop->readyCount - loop->nextReady;
+
+    loop->readyCount = 0;
+    loop->nextReady = 0;
+    harvestCompletions(loop);
+    return loop->readyCount;
+}
+
+/*
+ * Desc: Turns the completions of the completion queue into ready events, as many as fit. The rest stays queued for
+ *       the next wakeup.
+ * Params:
+ *    loop - loop backed by a ring
+ */
+void harvestCompletions(struct eventLoop *loop) {
+    struct uring *ring = loop->uring;
+    unsigned head = *ring->completionHead;
+    unsigned tail = atomic_load_explicit((_Atomic unsigned *) ring->completionTail, memory_order_acquire);
+
+    for (; head != tail && loop->readyCount < MAX_EVENTS; head++) {
+        handleCompletion(loop, &ring->completions[head & ring->completionMask]);
+    }
+    atomic_store_explicit((_Atomic unsigned *) ring->completionHead, head, memory_order_release);
+}
+
+/*
+ * Desc: Files one completion: requests that stopped are armed again, stale completions are dropped and everything else
+ *       becomes a ready event of its descriptor. Receives are readable events, sends and polls for space writable ones.
+ * Params:
+ *    loop - loop backed by a ring
+ *    completion - completion queue entry
+ */
+void handleCompletion(struct eventLoop *loop, struct io_uring_cqe *completion) {
+    struct uring *ring = loop->uring;
+    int operation = (int) (completion->user_data >> 56);
+    int fileDescriptor = (int) (completion->user_data & 0xffffff);
+    uint32_t generation = (uint32_t) (completion->user_data >> 24);
+    int more = (completion->flags & IORING_CQE_F_MORE) != 0;
+    int bufferId = completion->flags & IORING_CQE_F_BUFFER ? (int) (completion->flags >> IORING_CQE_BUFFER_SHIFT) : -1;
+    struct uringDescriptor *descriptor;
+
+    if (operation == URING_CANCEL) return;
+
+    descriptor = &ring->descriptors[fileDescriptor];
+    if (descriptor->generation != generation) {
+        if (bufferId >= 0) recycleBuffer(ring, bufferId);
+        return;
+    }
+
+    switch (operation) {
+        case URING_ACCEPT:
+            if (!more) armAccept(ring, fileDescriptor);
+            addReadyEvent(loop, EPOLLIN, fileDescriptor, operation, completion->res, -1);
+            break;
+
+        case URING_POLL:
+            if (!more) armPoll(ring, fileDescriptor);
+            addReadyEvent(loop, EPOLLIN, fileDescriptor, operation, completion->res, -1);
+            break;
+
+        case URING_RECEIVE:
+            descriptor->receiving = more;
+            // A receive that ran out of provided buffers stops; it is armed again and finds the recycled ones.
+            if (!more && (completion->res > 0 || completion->res == -ENOBUFS)) armReceive(ring, fileDescriptor);
+            if (completion->res != -ENOBUFS) {
+                addReadyEvent(loop, completion->res == 0 ? EPOLLIN | EPOLLRDHUP : EPOLLIN, fileDescriptor, operation,
+                              completion->res, bufferId);
+            }
+            break;
+
+        case URING_SEND:
+        case URING_WRITABLE:
+            addReadyEvent(loop, EPOLLOUT, fileDescriptor, operation, completion->res, -1);
+            break;
+
+        default:
+            if (bufferId >= 0) recycleBuffer(ring, bufferId);
+    }
+}
+
+/*
+ * Desc: Appends a ready event together with its completion.
+ * Params:
+ *    loop - loop backed by a ring
+ *    events - EPOLLIN, EPOLLOUT or EPOLLRDHUP as the epoll loop would report them
+ *    fileDescriptor - descriptor the completion belongs to
+ *    operation - operation that completed
+ *    result - result of the operation
+ *    bufferId - provided buffer holding received data, -1 if none
+ */
+void addReadyEvent(struct eventLoop *loop, uint32_t events, int fileDescriptor, int operation, int result,
+                   int bufferId) {
+    struct uringCompletion *ready = &loop->uring->ready[loop->readyCount];
+
+    loop->events[loop->readyCount].events = events;
+    loop->events[loop->readyCount].data.fd = fileDescriptor;
+    ready->operation = operation;
+    ready->result = result;
+    ready->bufferId = bufferId;
+    ready->offset = 0;
+    ready->generation = loop->uring->descriptors[fileDescriptor].generation;
+    loop->readyCount++;
+}
+
+/*
+ * Desc: Returns the descriptor of the next ready event, skipping events of descriptors unwatched since the
+ *       completion arrived.
+ * Params:
+ *    loop - loop backed by a ring
+ * Returns: ready file descriptor or -1 if every event has been drained
+ */
+int uringNextReady(struct eventLoop *loop) {
+    struct uring *ring = loop->uring;
+
+    while (loop->nextReady < loop->readyCount) {
+        int fileDescriptor = loop->events[loop->nextReady].data.fd;
+        if (ring->descriptors[fileDescriptor].generation == ring->ready[loop->nextReady].generation) {
+            return fileDescriptor;
+        }
+        uringMarkDrained(loop);
+    }
+    return -1;
+}
+
+/*
+ * Desc: Moves on to the next ready event, giving the provided buffer of the current one back if it still holds it.
+ * Params:
+ *    loop - loop backed by a ring
+ */
+void uringMarkDrained(struct eventLoop *loop) {
+    struct uringCompletion *ready = &loop->uring->ready[loop->nextReady];
+
+    if (loop->nextReady >= loop->readyCount) return;
+    if (ready->bufferId >= 0) recycleBuffer(loop->uring, ready->bufferId);
+    ready->bufferId = -1;
+    loop->nextReady++;
+}
+
+/*
+ * Desc: Takes the connection accepted by the current event of the listener. Like accept4 on a drained listener, a
+ *       second call fails with EAGAIN.
+ * Params:
+ *    loop - loop backed by a ring
+ * Returns: the accepted socket or -1 with errno set
+ */
+int uringAccept(struct eventLoop *loop) {
+    struct uringCompletion *ready = &loop->uring->ready[loop->nextReady];
+
+    if (loop->nextReady >= loop->readyCount || ready->operation != URING_ACCEPT) {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    ready->operation = 0;
+    if (ready->result < 0) {
+        errno = -ready->result;
+        return -1;
+    }
+    return ready->result;
+}
+
+/*
+ * Desc: Copies the received data of the current event into a receive buffer, as much as fits, and gives the provided
+ *       buffer back once it has been copied completely. Behaves like a read of a non-blocking socket.
+ * Params:
+ *    loop - loop backed by a ring
+ *    buffer - receive buffer of the connection
+ * Returns: number of bytes copied, 0 if the peer closed the connection, -1 with errno set on error, EAGAIN if the
+ *          event holds no more data and ENOBUFS if the receive buffer is full
+ */
+int uringReceive(struct eventLoop *loop, struct receiveBuffer *buffer) {
+    struct uringCompletion *ready = &loop->uring->ready[loop->nextReady];
+    uint32_t space = RECEIVE_BUFFER_SIZE - (buffer->tail - buffer->head);
+    uint32_t offset = buffer->tail & (RECEIVE_BUFFER_SIZE - 1);
+    uint32_t length, firstLength;
+    const uint8_t *data;
+
+    if (loop->nextReady >= loop->readyCount || ready->operation != URING_RECEIVE) {
+        errno = EAGAIN;
+        return -1;
+    } else if (ready->result == 0) {
+        return 0;
+    } else if (ready->result < 0) {
+        errno = -ready->result;
+        return -1;
+    } else if (ready->bufferId < 0) {
+        errno = EAGAIN;
+        return -1;
+    } else if (space == 0) {
+        errno = ENOBUFS;
+        return -1;
+    }
+
+    data = loop->uring->buffers + (size_t) ready->bufferId * URING_BUFFER_SIZE + ready->offset;
+    length = (uint32_t) (ready->result - ready->offset) < space ? (uint32_t) (ready->result - ready->offset) : space;
+    firstLength = RECEIVE_BUFFER_SIZE - offset < length ? RECEIVE_BUFFER_SIZE - offset : length;
+    memcpy(buffer->data + offset, data, firstLength);
+    memcpy(buffer->data, data + firstLength, length - firstLength);
+    buffer->tail += length;
+    ready->offset += (int) length;
+
+    if (ready->offset == ready->result) {
+        recycleBuffer(loop->uring, ready->bufferId);
+        ready->bufferId = -1;
+    }
+    return (int) length;
+}
+
+/*
+ * Desc: Prepares a send of the queued bytes up to the end of the ring, unless a send is in flight or the socket is
+ *       full. The bytes stay queued until the completion reports how many were sent.
+ * Params:
+ *    loop - loop backed by a ring
+ *    fileDescriptor - socket to send to
+ *    buffer - output buffer of the connection
+ * Returns: number of bytes still queued, -1 if the send could not be prepared
+ */
+int uringSend(struct eventLoop *loop, int fileDescriptor, struct sendBuffer *buffer) {
+    struct uringDescriptor *descriptor = descriptorOf(loop->uring, fileDescriptor);
+    uint32_t used = buffer->tail - buffer->head;
+    uint32_t offset = buffer->head & (SEND_BUFFER_SIZE - 1);
+    struct io_uring_sqe *entry;
+
+    if (descriptor == NULL) return -1;
+    if (used == 0 || descriptor->sending || descriptor->waitingWritable) return (int) used;
+
+    if ((entry = prepareEntry(loop->uring, IORING_OP_SEND, fileDescriptor, URING_SEND)) == NULL) {
+        errno = EBUSY;
+        return -1;
+    }
+
+    entry->addr = (uint64_t) (uintptr_t) (buffer->data + offset);
+    entry->len = SEND_BUFFER_SIZE - offset < used ? SEND_BUFFER_SIZE - offset : used;
+    entry->msg_flags = MSG_NOSIGNAL | MSG_DONTWAIT;
+    descriptor->sending = 1;
+    return (int) used;
+}
+
+/*
+ * Desc: Takes the result of the send or the poll for space behind the current writable event. A send that found the
+ *       socket full asks to be told when it accepts data again.
+ * Params:
+ *    loop - loop backed by a ring
+ * Returns: number of bytes sent, 0 if the socket became writable, -1 with errno set on error or EAGAIN if the socket
+ *          is still full
+ */
+int uringTakeSent(struct eventLoop *loop) {
+    struct uringCompletion *ready = &loop->uring->ready[loop->nextReady];
+    struct uringDescriptor *descriptor;
+    int fileDescriptor;
+
+    if (loop->nextReady >= loop->readyCount) return 0;
+    fileDescriptor = loop->events[loop->nextReady].data.fd;
+    descriptor = &loop->uring->descriptors[fileDescriptor];
+
+    if (ready->operation == URING_WRITABLE) {
+        descriptor->waitingWritable = 0;
+        return 0;
+    } else if (ready->operation != URING_SEND) {
+        return 0;
+    }
+
+    descriptor->sending = 0;
+    if (ready->result == -EAGAIN) armWritable(loop->uring, fileDescriptor);
+    if (ready->result < 0) {
+        errno = -ready->result;
+        return -1;
+    }
+    return ready->result;
+}
+
+/*
+ * Desc: Asks to be told with a writable event once a socket that did not take everything accepts data again.
+ * Params:
+ *    loop - loop backed by a ring
+ *    fileDescriptor - full socket
+ * Returns: 0 if asked, 1 if error occurred
+ */
+int uringWaitWritable(struct eventLoop *loop, int fileDescriptor) {
+    if (descriptorOf(loop->uring, fileDescriptor) == NULL) return DEFAULT_ERROR_RETURN;
+    return armWritable(loop->uring, fileDescriptor);
+}
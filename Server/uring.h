@@ -0,0 +1,106 @@
+#ifndef SERVER_URING_H
+#define SERVER_URING_H
+
+#include <stdint.h>
+#include <linux/io_uring.h>
+#include "eventLoop.h"
+#include "protocol.h"
+
+#define URING_QUEUE_DEPTH 1024 // submission queue entries, the completion queue gets four times as many
+#define URING_BUFFER_COUNT 1024 // power of two, provided buffers shared by the receives of all connections
+#define URING_BUFFER_SIZE 512 // bytes per provided buffer
+
+#define URING_ACCEPT 1
+#define URING_POLL 2
+#define URING_RECEIVE 3
+#define URING_SEND 4
+#define URING_WRITABLE 5
+#define URING_CANCEL 6
+
+/*
+ * What the ring has in flight for a descriptor. The generation grows whenever the descriptor is watched or unwatched,
+ * so completions of a closed connection are recognized as stale even after the kernel reused its descriptor number.
+ */
+struct uringDescriptor {
+    uint32_t generation;
+    uint8_t receiving;
+    uint8_t sending;
+    uint8_t waitingWritable;
+};
+
+/*
+ * Completion behind a ready event of the loop: the result of the operation and, for a receive, the provided buffer
+ * holding the data and how much of it has been handed out already.
+ */
+struct uringCompletion {
+    int operation;
+    int result;
+    int bufferId;
+    int offset;
+    uint32_t generation;
+};
+
+/*
+ * io_uring instance of an event loop, driven without liburing. The listener keeps a multishot accept in flight and
+ * every connection a multishot receive that picks its buffer from the provided buffer ring, so no system call is made
+ * to accept or read. Sends are prepared while the iteration flushes and go to the kernel together with the wait for
+ * the next completions in a single io_uring_enter. Sends do not wait for socket space (MSG_DONTWAIT): the kernel
+ * copies the bytes during that call, so the send buffer is free again once it returns, and a full socket is reported
+ * back as EAGAIN, after which a one-shot poll tells when it is writable again.
+ */
+struct uring {
+    int ringFd;
+    void *submissionRing;
+    void *completionRing;
+    size_t submissionRingSize;
+    size_t completionRingSize;
+    struct io_uring_sqe *entries;
+    size_t entriesSize;
+    unsigned *submissionHead;
+    unsigned *submissionTail;
+    unsigned submissionMask;
+    unsigned submissionEntries;
+    unsigned preparedTail;
+    unsigned *completionHead;
+    unsigned *completionTail;
+    unsigned completionMask;
+    struct io_uring_cqe *completions;
+    struct io_uring_buf_ring *bufferRing;
+    uint8_t *buffers;
+    uint16_t bufferTail;
+    struct uringDescriptor *descriptors;
+    int descriptorCapacity;
+    struct uringCompletion ready[MAX_EVENTS];
+};
+
+int probeUring();
+
+int initUring(struct eventLoop *loop);
+
+void closeUring(struct eventLoop *loop);
+
+int uringWatchListener(struct eventLoop *loop, int fileDescriptor);
+
+int uringWatchDescriptor(struct eventLoop *loop, int fileDescriptor);
+
+int uringWatchConnection(struct eventLoop *loop, int fileDescriptor);
+
+void uringUnwatch(struct eventLoop *loop, int fileDescriptor);
+
+int uringWait(struct eventLoop *loop, int timeoutMs);
+
+int uringNextReady(struct eventLoop *loop);
+
+void uringMarkDrained(struct eventLoop *loop);
+
+int uringAccept(struct eventLoop *loop);
+
+int uringReceive(struct eventLoop *loop, struct receiveBuffer *buffer);
+
+int uringSend(struct eventLoop *loop, int fileDescriptor, struct sendBuffer *buffer);
+
+int uringTakeSent(struct eventLoop *loop);
+
+int uringWaitWritable(struct eventLoop *loop, int fileDescriptor);
+
+#endif